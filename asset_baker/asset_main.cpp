@@ -4,20 +4,40 @@
 #include <filesystem>
 
 #include <lz4.h>
+#include <lz4hc.h>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#include "tiny_obj_loader.h"
 
 #include <asset_loader.h>
+#include <asset_archive.h>
+#include <asset_dictionary.h>
 #include <texture_asset.h>
 #include <mesh_asset.h>
+#include <mesh_processing.h>
+#include <obj_loader.h>
 #include <material_asset.h>
+// before the implementation define, so including tiny_gltf.h again below only adds the implementation
+#include "bake_gltf.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #include <tiny_gltf.h>
 #include "prefab_asset.h"
+#include "bake_benchmark.h"
+#include "bake_content.h"
+#include "bake_jobs.h"
+#include "bake_manifest.h"
+#include "bake_mips.h"
+#include "bake_profile.h"
 
 #include <nvtt.h>
 
@@ -32,438 +52,917 @@ namespace fs = std::filesystem;
 
 using namespace assets;
 
+// furthest a lod can move the surface, relative to the bounding radius of the mesh
+constexpr float MESH_LOD_MAX_ERROR = 0.05f;
+
 struct ConverterState
 {
     fs::path asset_path;
     fs::path export_path;
 
+    // baking is done once and loading many times, so textures default to the slowest and smallest lz4hc level
+    CompressionPolicy texturePolicy{CompressionMode::LZ4HC, LZ4HC_CLEVEL_MAX};
+    // mips are filtered in linear space with this filter
+    MipFilter mipFilter{MipFilter::Kaiser};
+    // Unknown picks a block compressed format from how the materials use the texture, anything else is used for every texture
+    TextureFormat textureFormat{TextureFormat::Unknown};
+    // TextureUsage flags of every image the gltf materials in the asset folder point at, by lexically normal path
+    std::unordered_map<std::string, uint32_t> textureUsage;
+    // meshes are extracted at full precision and converted to this format when packed
+    VertexFormat meshFormat{VertexFormat::P16N16C8V16};
+    // meshes are baked once and loaded many times too, same as textures
+    CompressionPolicy meshPolicy{CompressionMode::LZ4HC, LZ4HC_CLEVEL_MAX};
+    // most lods generated per mesh, including the full detail one. 1 disables them
+    uint32_t meshLods{6};
+
+    // independent files, and the meshes and materials inside a gltf, are baked as jobs on this pool
+    JobPool *jobs;
+    // every stage of every file is timed into this
+    BakeProfiler *profiler{nullptr};
+    // textures and meshes are stored once in here, by the hash of what they were baked from
+    ContentStore *content{nullptr};
+    // the images every gltf in the asset folder points at, both by lexically normal path
+    std::unordered_map<std::string, std::vector<std::string>> gltfImages;
+
     fs::path convert_to_export_relative(fs::path path) const;
 };
 
-bool convert_image(const fs::path &input, const fs::path &output)
+// what a material samples a texture as. An image shared by materials can have more than one
+enum TextureUsage : uint32_t
 {
-    int texWidth, texHeight, texChannels;
+    TEXTURE_USAGE_COLOR = 1 << 0,
+    TEXTURE_USAGE_NORMAL = 1 << 1,
+    // metallic in blue and roughness in green, the way gltf packs them
+    TEXTURE_USAGE_MASK = 1 << 2,
+    TEXTURE_USAGE_OCCLUSION = 1 << 3
+};
 
-    auto pngstart = std::chrono::high_resolution_clock::now();
+uint32_t find_texture_usage(const fs::path &input, const ConverterState &convState)
+{
+    auto usage = convState.textureUsage.find(input.lexically_normal().generic_string());
+    return usage != convState.textureUsage.end() ? usage->second : 0;
+}
 
-    stbi_uc *pixels = stbi_load(input.u8string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+bool is_gltf_source(const fs::path &path)
+{
+    return path.extension() == ".gltf" || path.extension() == ".glb";
+}
 
-    auto pngend = std::chrono::high_resolution_clock::now();
+// name the timings of a source file are grouped under in the bake report
+const char *bake_file_type(const fs::path &path)
+{
+    if (path.extension() == ".obj")
+        return "obj";
+    if (is_gltf_source(path))
+        return "gltf";
+    return "texture";
+}
 
-    auto diff = pngend - pngstart;
+// 0 when the size can not be read
+uint64_t source_file_size(const fs::path &path)
+{
+    std::error_code error;
+    uintmax_t size = fs::file_size(path, error);
+    return error ? 0 : size;
+}
 
-    std::cout << "png took " << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / 1000000.0 << "ms" << std::endl;
+// writes the asset, timed as the write stage of the file it was baked from
+bool save_asset(const fs::path &path, const assets::AssetFile &file, const char *fileType, const ConverterState &convState)
+{
+    StageTimer timer{convState.profiler, fileType, BakeStage::Write, file.json.size() + file.binaryMetadata.size() + file.binaryBlob.size()};
+    return save_binaryfile(path.string().c_str(), file);
+}
 
-    if (!pixels)
+bool is_texture_source(const fs::path &path)
+{
+    return path.extension() == ".png" || path.extension() == ".jpg" || path.extension() == ".TGA";
+}
+
+std::string mesh_options(const ConverterState &convState)
+{
+    return std::string{"mesh "} + vertex_format_name(convState.meshFormat) + " " + std::to_string(convState.meshLods) + " " +
+           compression_name(convState.meshPolicy.mode) + " " + std::to_string(convState.meshPolicy.level) + " " + std::to_string(convState.meshPolicy.maxRatio);
+}
+
+// hash of the options that change the output of this kind of file, so changing the mesh options does not rebake textures
+uint64_t bake_options_hash(const fs::path &input, const ConverterState &convState)
+{
+    std::string options;
+    if (is_texture_source(input))
     {
-        std::cout << "Failed to load texture file " << input << std::endl;
-        return false;
+        // the usage comes from the gltf materials, a material that starts using the texture as a normal map changes its format
+        options = std::string{"texture "} + compression_name(convState.texturePolicy.mode) + " " + std::to_string(convState.texturePolicy.level) +
+                  " " + std::to_string(convState.texturePolicy.maxRatio) + " " + texture_format_name(convState.textureFormat) + " " + mip_filter_name(convState.mipFilter) +
+                  " " + std::to_string(find_texture_usage(input, convState));
+    }
+    else
+    {
+        options = mesh_options(convState);
     }
 
-    int texture_size = texWidth * texHeight * 4;
+    // the materials of a gltf point at the payloads of its images, which change when the images bake differently
+    auto images = convState.gltfImages.find(input.lexically_normal().generic_string());
+    if (is_gltf_source(input) && images != convState.gltfImages.end())
+    {
+        for (auto &image : images->second)
+        {
+            options += " " + convState.content->source_payload(image).filename().string();
+        }
+    }
+    return hash_content(options.data(), options.size());
+}
 
-    TextureInfo texinfo;
-    texinfo.textureSize = texture_size;
+// what a file was baked into and from, for the manifest
+struct BakeResult
+{
+    std::vector<fs::path> outputs;
+    std::vector<fs::path> dependencies;
+};
 
-    texinfo.textureFormat = TextureFormat::RGBA8;
-    texinfo.originalFile = input.string();
-    auto start = std::chrono::high_resolution_clock::now();
+// what a payload is stored under: the decoded data it was baked from, with the options and baker version,
+// so a payload is never reused for a bake that would have written something else
+uint64_t payload_hash(const char *kind, uint64_t optionsHash, std::initializer_list<std::pair<const void *, size_t>> data)
+{
+    ContentHasher hasher;
+    hasher.update(kind, strlen(kind));
+    uint32_t version = BAKER_VERSION;
+    hasher.update(&version, sizeof(version));
+    hasher.update(&optionsHash, sizeof(optionsHash));
+    for (auto &[bytes, size] : data)
+    {
+        // the size keeps the pieces apart, the hasher itself does not see where one ends
+        uint64_t size64 = size;
+        hasher.update(&size64, sizeof(size64));
+        hasher.update(bytes, size);
+    }
+    return hasher.finish();
+}
 
-    std::vector<char> all_buffer;
+// writes to a temporary file that is renamed over the payload, so a bake that stops halfway never leaves a broken payload under its hash
+bool save_payload(const fs::path &payload, const assets::AssetFile &file, const char *fileType, const ConverterState &convState)
+{
+    fs::path temporary = payload;
+    temporary += ".tmp";
+    if (!save_asset(temporary, file, fileType, convState))
+    {
+        return false;
+    }
+    std::error_code error;
+    fs::rename(temporary, payload, error);
+    return !error;
+}
 
-    struct DumbHandler : nvtt::OutputHandler
+// reads the materials of every gltf and glb in the directory, and marks the images they use. Only the json is parsed
+void collect_texture_usage(const fs::path &directory, ConverterState &convState)
+{
+    convState.textureUsage.clear();
+    convState.gltfImages.clear();
+    for (auto &p : fs::recursive_directory_iterator(directory))
     {
-        // Output data. Compressed data is output as soon as it's generated to minimize memory allocations.
-        virtual bool writeData(const void *data, int size)
+        if (!p.is_regular_file() || !is_gltf_source(p.path()))
+            continue;
+
+        nlohmann::json gltf;
+        if (p.path().extension() == ".glb")
         {
-            for (int i = 0; i < size; i++)
+            // only the json chunk at the start of the mapping gets paged in
+            assets::FileMapping mapping;
+            if (!assets::map_file(p.path().string().c_str(), mapping))
+                continue;
+            GlbChunks chunks;
+            std::string error;
+            if (parse_glb(mapping.data, mapping.size, chunks, error))
+                gltf = nlohmann::json::parse(chunks.json.begin(), chunks.json.end(), nullptr, false);
+            assets::unmap_file(mapping);
+        }
+        else
+        {
+            std::ifstream file{p.path()};
+            gltf = nlohmann::json::parse(file, nullptr, false);
+        }
+        if (gltf.is_discarded() || !gltf.contains("materials"))
+            continue;
+
+        auto &textures = gltf["textures"];
+        auto &images = gltf["images"];
+        auto mark = [&](const nlohmann::json &material, const char *slot, uint32_t usage)
+        {
+            auto textureInfo = material.find(slot);
+            if (textureInfo == material.end() || !textureInfo->contains("index"))
+                return;
+
+            size_t texture = (*textureInfo)["index"];
+            if (texture >= textures.size() || !textures[texture].contains("source"))
+                return;
+            size_t image = textures[texture]["source"];
+            if (image >= images.size() || !images[image].contains("uri"))
+                return;
+
+            std::string uri = images[image]["uri"];
+            std::string imageKey = (p.path().parent_path() / uri).lexically_normal().generic_string();
+            convState.textureUsage[imageKey] |= usage;
+            convState.gltfImages[p.path().lexically_normal().generic_string()].push_back(imageKey);
+        };
+
+        for (auto &material : gltf["materials"])
+        {
+            if (material.contains("pbrMetallicRoughness"))
             {
-                buffer.push_back(((char *)data)[i]);
+                mark(material["pbrMetallicRoughness"], "baseColorTexture", TEXTURE_USAGE_COLOR);
+                mark(material["pbrMetallicRoughness"], "metallicRoughnessTexture", TEXTURE_USAGE_MASK);
             }
-            return true;
+            mark(material, "normalTexture", TEXTURE_USAGE_NORMAL);
+            mark(material, "occlusionTexture", TEXTURE_USAGE_OCCLUSION);
+            mark(material, "emissiveTexture", TEXTURE_USAGE_COLOR);
         }
-        virtual void beginImage(int size, int width, int height, int depth, int face, int miplevel){};
+    }
+}
 
-        // Indicate the end of the compressed image. (New in NVTT 2.1)
-        virtual void endImage(){};
-        std::vector<char> buffer;
-    };
+// color is sRGB, BC1 when it is opaque and BC7 when it has alpha. Normals keep x and y in BC5,
+// lone occlusion maps take a single BC4 channel and packed masks go to BC7 to keep the channels independent.
+// textures no material points at are treated as color
+void choose_texture_format(uint32_t usage, bool hasAlpha, const ConverterState &convState, TextureInfo &info)
+{
+    bool color = usage == 0 || (usage & TEXTURE_USAGE_COLOR);
+    info.colorSpace = color ? ColorSpace::SRGB : ColorSpace::Linear;
 
-    nvtt::Compressor compressor;
+    if (convState.textureFormat != TextureFormat::Unknown)
+    {
+        info.textureFormat = convState.textureFormat;
+    }
+    else if (color)
+    {
+        info.textureFormat = hasAlpha ? TextureFormat::BC7 : TextureFormat::BC1;
+    }
+    else if (usage & TEXTURE_USAGE_NORMAL)
+    {
+        info.textureFormat = TextureFormat::BC5;
+    }
+    else if (usage & TEXTURE_USAGE_MASK)
+    {
+        info.textureFormat = TextureFormat::BC7;
+    }
+    else
+    {
+        info.textureFormat = TextureFormat::BC4;
+    }
+}
 
-    nvtt::CompressionOptions optiuns;
-    nvtt::OutputOptions outputOptions;
+nvtt::Format nvtt_format(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1:
+        return nvtt::Format_BC1;
+    case TextureFormat::BC3:
+        return nvtt::Format_BC3;
+    case TextureFormat::BC4:
+        return nvtt::Format_BC4;
+    case TextureFormat::BC5:
+        return nvtt::Format_BC5;
+    case TextureFormat::BC7:
+        return nvtt::Format_BC7;
+    default:
+        return nvtt::Format_RGBA;
+    }
+}
+
+struct DumbHandler : nvtt::OutputHandler
+{
+    // Output data. Compressed data is output as soon as it's generated to minimize memory allocations.
+    virtual bool writeData(const void *data, int size)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            buffer.push_back(((char *)data)[i]);
+        }
+        return true;
+    }
+    virtual void beginImage(int size, int width, int height, int depth, int face, int miplevel){};
+
+    // Indicate the end of the compressed image. (New in NVTT 2.1)
+    virtual void endImage(){};
+    std::vector<char> buffer;
+};
+
+// encodes one level of the mip chain. Runs as a job with its own compressor, while the next level is being filtered
+std::vector<char> compress_mip(const MipImage &image, const TextureInfo &info, const MipSettings &mipSettings, bool hasAlpha, const nvtt::CompressionOptions &options)
+{
     nvtt::Surface surface;
+    surface.setImage(nvtt::InputFormat_RGBA_32F, image.width, image.height, 1, image.pixels.data());
+    if (hasAlpha)
+    {
+        surface.setAlphaMode(nvtt::AlphaMode_Transparency);
+    }
+
+    if (mipSettings.premultiplied)
+    {
+        float *channels[4] = {surface.channel(0), surface.channel(1), surface.channel(2), surface.channel(3)};
+        size_t count = size_t(image.width) * image.height;
+        for (size_t i = 0; i < count; i++)
+        {
+            float alpha = channels[3][i];
+            for (int c = 0; c < 3 && alpha > 0; c++)
+            {
+                channels[c][i] /= alpha;
+            }
+        }
+    }
+    // filtered in linear space, stored as sRGB
+    if (info.colorSpace == ColorSpace::SRGB)
+    {
+        surface.toSrgb();
+    }
 
+    nvtt::Compressor compressor;
+    nvtt::OutputOptions outputOptions;
     DumbHandler handler;
     outputOptions.setOutputHandler(&handler);
+    compressor.compress(surface, 0, 0, options, outputOptions);
+    return std::move(handler.buffer);
+}
 
-    surface.setImage(nvtt::InputFormat::InputFormat_BGRA_8UB, texWidth, texHeight, 1, pixels);
+// bakes the image into the content store, and links output to it for code that loads the texture by its own path.
+// images that decode to the same pixels and bake with the same options share the payload, and only the first one gets baked
+bool convert_image(const fs::path &input, const fs::path &output, const ConverterState &convState, BakeResult &result)
+{
+    int texWidth, texHeight, texChannels;
 
-    while (surface.canMakeNextMipmap(1))
-    {
-        surface.buildNextMipmap(nvtt::MipmapFilter_Box);
+    StageTimer decodeTimer{convState.profiler, "texture", BakeStage::Decode, source_file_size(input)};
 
-        optiuns.setFormat(nvtt::Format::Format_RGBA);
-        optiuns.setPixelType(nvtt::PixelType_UnsignedNorm);
+    stbi_uc *pixels = stbi_load(input.u8string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
-        compressor.compress(surface, 0, 0, optiuns, outputOptions);
+    decodeTimer.stop();
 
-        texinfo.pages.push_back({});
-        texinfo.pages.back().width = surface.width();
-        texinfo.pages.back().height = surface.height();
-        texinfo.pages.back().originalSize = handler.buffer.size();
+    if (!pixels)
+    {
+        std::cout << "Failed to load texture file " << input << std::endl;
+        return false;
+    }
 
-        all_buffer.insert(all_buffer.end(), handler.buffer.begin(), handler.buffer.end());
-        handler.buffer.clear();
+    bool hasAlpha = false;
+    size_t pixelCount = size_t(texWidth) * texHeight;
+    for (size_t i = 0; i < pixelCount && !hasAlpha; i++)
+    {
+        hasAlpha = pixels[i * 4 + 3] != 255;
     }
 
-    texinfo.textureSize = all_buffer.size();
-    assets::AssetFile newImage = assets::pack_texture(&texinfo, all_buffer.data());
+    uint32_t usage = find_texture_usage(input, convState);
+    TextureInfo texinfo;
+    choose_texture_format(usage, hasAlpha, convState, texinfo);
+    texinfo.originalFile = input.string();
+    std::cout << "texture " << input.filename() << " as " << texture_format_name(texinfo.textureFormat)
+              << (texinfo.colorSpace == ColorSpace::SRGB ? " sRGB" : "") << std::endl;
+
+    uint32_t dimensions[2] = {uint32_t(texWidth), uint32_t(texHeight)};
+    fs::path payload = convState.content->payload_path(
+        payload_hash("texture", bake_options_hash(input, convState), {{dimensions, sizeof(dimensions)}, {pixels, pixelCount * 4}}), ".tx");
+    result.outputs.push_back(payload);
+    if (!convState.content->claim(payload))
+    {
+        std::cout << "texture " << input.filename() << " is already baked as " << payload.filename() << std::endl;
+        stbi_image_free(pixels);
+        convState.content->set_source_payload(input, payload);
+        convState.content->link_output(output, payload);
+        return true;
+    }
 
-    auto end = std::chrono::high_resolution_clock::now();
+    StageTimer mipTimer{convState.profiler, "texture", BakeStage::Mip, pixelCount * 4};
 
-    std::cout << "compression took " << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / 1000000.0 << "ms" << std::endl;
+    // color with alpha is filtered premultiplied, so transparent texels dont bleed into the mips
+    MipSettings mipSettings;
+    mipSettings.filter = convState.mipFilter;
+    mipSettings.normalMap = (usage & TEXTURE_USAGE_NORMAL) && texinfo.colorSpace == ColorSpace::Linear;
+    mipSettings.premultiplied = hasAlpha && texinfo.colorSpace == ColorSpace::SRGB;
 
+    MipImage base = load_mip_image(pixels, texWidth, texHeight, texinfo.colorSpace == ColorSpace::SRGB, mipSettings.premultiplied);
     stbi_image_free(pixels);
 
-    save_binaryfile(output.string().c_str(), newImage);
+    nvtt::CompressionOptions optiuns;
+    optiuns.setFormat(nvtt_format(texinfo.textureFormat));
+    optiuns.setPixelType(nvtt::PixelType_UnsignedNorm);
+    // uncompressed pixels are written in rgba order, the order the engine uploads them in
+    optiuns.setPixelFormat(32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000);
+
+    // the full size image is the first page, then every mip down to 1x1
+    uint32_t levelCount = mip_level_count(texWidth, texHeight);
+    std::vector<std::vector<char>> levels(levelCount);
+    texinfo.pages.resize(levelCount);
+
+    JobPool::Group compression;
+    generate_mips(std::move(base), mipSettings, *convState.jobs, [&](uint32_t level, std::shared_ptr<const MipImage> image)
+                  {
+        texinfo.pages[level].width = image->width;
+        texinfo.pages[level].height = image->height;
+        convState.jobs->run(compression, [&, level, image]()
+                            {
+            StageTimer timer{convState.profiler, "texture", BakeStage::Compress, size_t(image->width) * image->height * 4};
+            levels[level] = compress_mip(*image, texinfo, mipSettings, hasAlpha, optiuns); }); });
+    // the compression jobs this thread ran while the mips were filtered are timed on their own
+    mipTimer.stop();
+    convState.jobs->wait(compression);
+
+    std::vector<char> all_buffer;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        texinfo.pages[i].originalSize = static_cast<uint32_t>(levels[i].size());
+        all_buffer.insert(all_buffer.end(), levels[i].begin(), levels[i].end());
+    }
 
+    texinfo.textureSize = all_buffer.size();
+    StageTimer lz4Timer{convState.profiler, "texture", BakeStage::LZ4, all_buffer.size()};
+    assets::AssetFile newImage = assets::pack_texture(&texinfo, all_buffer.data(), convState.texturePolicy);
+    lz4Timer.stop();
+
+    if (!save_payload(payload, newImage, "texture", convState))
+    {
+        convState.content->release(payload);
+        return false;
+    }
+    convState.content->set_source_payload(input, payload);
+    convState.content->link_output(output, payload);
     return true;
 }
 
-void pack_vertex(assets::Vertex_f32_PNCV &new_vert, tinyobj::real_t vx, tinyobj::real_t vy, tinyobj::real_t vz, tinyobj::real_t nx, tinyobj::real_t ny, tinyobj::real_t nz, tinyobj::real_t ux, tinyobj::real_t uy)
-{
-    new_vert.position[0] = vx;
-    new_vert.position[1] = vy;
-    new_vert.position[2] = vz;
-
-    new_vert.normal[0] = nx;
-    new_vert.normal[1] = ny;
-    new_vert.normal[2] = nz;
+// pages up to this size get sampled for the texture dictionary, bigger ones compress fine on their own
+constexpr uint32_t DICTIONARY_SAMPLE_PAGE_SIZE = 64 * 1024;
+// keeps the dictionary builder memory bounded on big projects
+constexpr size_t DICTIONARY_MAX_SAMPLE_BYTES = 32 * 1024 * 1024;
 
-    new_vert.uv[0] = ux;
-    new_vert.uv[1] = 1 - uy;
-}
-void pack_vertex(assets::Vertex_P32N8C8V16 &new_vert, tinyobj::real_t vx, tinyobj::real_t vy, tinyobj::real_t vz, tinyobj::real_t nx, tinyobj::real_t ny, tinyobj::real_t nz, tinyobj::real_t ux, tinyobj::real_t uy)
+// every baked file with that extension that a dictionary gets trained on and repacked against, in the same order every run
+std::vector<fs::path> dictionary_inputs(const fs::path &exportFolder, const char *extension, const ConverterState &convState)
 {
-    new_vert.position[0] = vx;
-    new_vert.position[1] = vy;
-    new_vert.position[2] = vz;
+    std::vector<fs::path> files;
+    for (auto &p : fs::recursive_directory_iterator(exportFolder))
+    {
+        if (p.path().extension() != extension)
+            continue;
 
-    new_vert.normal[0] = uint8_t(((nx + 1.0) / 2.0) * 255);
-    new_vert.normal[1] = uint8_t(((ny + 1.0) / 2.0) * 255);
-    new_vert.normal[2] = uint8_t(((nz + 1.0) / 2.0) * 255);
+        // an output linked to its payload is the same file, sampling and rewriting the payload covers it.
+        // rewrites truncate the file in place, so every link sees the new data
+        std::error_code error;
+        if (p.path().parent_path() != convState.content->folder() && fs::hard_link_count(p.path(), error) > 1)
+            continue;
 
-    new_vert.uv[0] = ux;
-    new_vert.uv[1] = 1 - uy;
+        files.push_back(p.path());
+    }
+    // same sample order every run, so the dictionary comes out the same
+    std::sort(files.begin(), files.end());
+    return files;
 }
 
-template <typename V>
-void extract_mesh_from_obj(std::vector<tinyobj::shape_t> &shapes, tinyobj::attrib_t &attrib, std::vector<uint32_t> &_indices, std::vector<V> &_vertices)
+// builds a shared dictionary from the small mips of every baked texture, then repacks all of them against it
+bool build_texture_dictionary(const fs::path &exportFolder, const ConverterState &convState)
 {
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++)
+    std::vector<fs::path> textures = dictionary_inputs(exportFolder, ".tx", convState);
+
+    fs::path dictionaryPath = exportFolder / "textures.dict";
+    // textures from an earlier run could already be compressed against the old dictionary
+    if (fs::exists(dictionaryPath))
     {
-        // Loop over faces(polygon)
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
-        {
+        assets::load_dictionary(dictionaryPath.string().c_str());
+    }
 
-            // hardcode loading to triangles
-            int fv = 3;
+    auto load_pixels = [](const fs::path &path, TextureInfo &info, std::vector<char> &pixels)
+    {
+        AssetFile file;
+        if (!load_binaryfile(path.string().c_str(), file))
+            return false;
 
-            // Loop over vertices in the face.
-            for (size_t v = 0; v < fv; v++)
+        info = read_texture_info(&file);
+        pixels.resize(info.textureSize);
+        return unpack_texture(&info, file.binaryBlob.data(), file.binaryBlob.size(), pixels.data());
+    };
+
+    std::vector<std::vector<char>> sampleData;
+    size_t sampleBytes = 0;
+    for (auto &path : textures)
+    {
+        TextureInfo info;
+        std::vector<char> pixels;
+        if (!load_pixels(path, info, pixels))
+            continue;
+
+        size_t offset = 0;
+        for (auto &page : info.pages)
+        {
+            if (page.originalSize <= DICTIONARY_SAMPLE_PAGE_SIZE && sampleBytes + page.originalSize <= DICTIONARY_MAX_SAMPLE_BYTES)
             {
-                // access to assets::Vertex_f32_PNCV
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-                // vertex position
-                tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-                // vertex normal
-                tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-                tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-                tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-
-                // vertex uv
-                tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
-                tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
-
-                // copy it into our vertex
-                V new_vert;
-                pack_vertex(new_vert, vx, vy, vz, nx, ny, nz, ux, uy);
-
-                _indices.push_back(_vertices.size());
-                _vertices.push_back(new_vert);
+                sampleData.emplace_back(pixels.begin() + offset, pixels.begin() + offset + page.originalSize);
+                sampleBytes += page.originalSize;
             }
-            index_offset += fv;
+            offset += page.originalSize;
         }
     }
+
+    std::vector<std::string_view> samples;
+    for (auto &sample : sampleData)
+    {
+        samples.push_back(std::string_view(sample.data(), sample.size()));
+    }
+
+    CompressionDictionary dictionary = assets::build_dictionary(samples);
+    if (dictionary.data.empty())
+    {
+        std::cout << "not enough shared texture data for a dictionary" << std::endl;
+        return false;
+    }
+    std::cout << "texture dictionary " << dictionary.id << " is " << dictionary.data.size() << " bytes, from " << samples.size() << " pages" << std::endl;
+
+    save_binaryfile(dictionaryPath.string().c_str(), assets::pack_dictionary(dictionary));
+
+    CompressionPolicy policy = convState.texturePolicy;
+    policy.dictionary = &dictionary;
+    for (auto &path : textures)
+    {
+        TextureInfo info;
+        std::vector<char> pixels;
+        if (!load_pixels(path, info, pixels))
+            continue;
+
+        assets::AssetFile newImage = assets::pack_texture(&info, pixels.data(), policy);
+        save_binaryfile(path.string().c_str(), newImage);
+    }
+
+    assets::register_dictionary(std::move(dictionary));
+    return true;
 }
 
-bool convert_mesh(const fs::path &input, const fs::path &output)
+// builds a shared dictionary from the start of the vertex, index and meshlet streams of every baked mesh, then repacks all of them
+// against it. Small meshes gain the most, lz4 only looks at the 64kb before each block anyway
+bool build_mesh_dictionary(const fs::path &exportFolder, const ConverterState &convState)
 {
-    // attrib will contain the assets::Vertex_f32_PNCV arrays of the file
-    tinyobj::attrib_t attrib;
-    // shapes contains the info for each separate object in the file
-    std::vector<tinyobj::shape_t> shapes;
-    // materials contains the information about the material of each shape, but we wont use it.
-    std::vector<tinyobj::material_t> materials;
-
-    // error and warning output from the load function
-    std::string warn;
-    std::string err;
-    auto pngstart = std::chrono::high_resolution_clock::now();
+    std::vector<fs::path> meshes = dictionary_inputs(exportFolder, ".mesh", convState);
 
-    // load the OBJ file
-    tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, input.string().c_str(),
-                     nullptr);
+    fs::path dictionaryPath = exportFolder / "meshes.dict";
+    // meshes from an earlier run could already be compressed against the old dictionary
+    if (fs::exists(dictionaryPath))
+    {
+        assets::load_dictionary(dictionaryPath.string().c_str());
+    }
 
-    auto pngend = std::chrono::high_resolution_clock::now();
+    struct UnpackedMesh
+    {
+        MeshInfo info;
+        std::vector<char> vertices;
+        std::vector<char> indices;
+        std::vector<char> meshlets;
+    };
+    auto load_mesh = [](const fs::path &path, UnpackedMesh &mesh)
+    {
+        AssetFile file;
+        if (!load_binaryfile(path.string().c_str(), file))
+            return false;
+
+        mesh.info = read_mesh_info(&file);
+        mesh.vertices.resize(mesh.info.vertexBuferSize);
+        mesh.indices.resize(mesh.info.indexBuferSize);
+        mesh.meshlets.resize(meshlet_buffer_size(mesh.info));
+        return unpack_mesh(&mesh.info, file.binaryBlob.data(), file.binaryBlob.size(), mesh.vertices.data(), mesh.indices.data(),
+                           mesh.meshlets.empty() ? nullptr : mesh.meshlets.data());
+    };
 
-    auto diff = pngend - pngstart;
+    std::vector<std::vector<char>> sampleData;
+    size_t sampleBytes = 0;
+    for (auto &path : meshes)
+    {
+        UnpackedMesh mesh;
+        if (!load_mesh(path, mesh))
+            continue;
 
-    std::cout << "obj took " << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / 1000000.0 << "ms" << std::endl;
+        for (auto *stream : {&mesh.vertices, &mesh.indices, &mesh.meshlets})
+        {
+            size_t size = std::min<size_t>(stream->size(), DICTIONARY_SAMPLE_PAGE_SIZE);
+            if (size > 0 && sampleBytes + size <= DICTIONARY_MAX_SAMPLE_BYTES)
+            {
+                sampleData.emplace_back(stream->begin(), stream->begin() + size);
+                sampleBytes += size;
+            }
+        }
+    }
 
-    // make sure to output the warnings to the console, in case there are issues with the file
-    if (!warn.empty())
+    std::vector<std::string_view> samples;
+    for (auto &sample : sampleData)
     {
-        std::cout << "WARN: " << warn << std::endl;
+        samples.push_back(std::string_view(sample.data(), sample.size()));
     }
-    // if we have any error, print it to the console, and break the mesh loading.
-    // This happens if the file cant be found or is malformed
-    if (!err.empty())
+
+    CompressionDictionary dictionary = assets::build_dictionary(samples);
+    if (dictionary.data.empty())
     {
-        std::cerr << err << std::endl;
+        std::cout << "not enough shared mesh data for a dictionary" << std::endl;
         return false;
     }
+    std::cout << "mesh dictionary " << dictionary.id << " is " << dictionary.data.size() << " bytes, from " << samples.size() << " streams" << std::endl;
 
-    using VertexFormat = assets::Vertex_f32_PNCV;
-    auto VertexFormatEnum = assets::VertexFormat::PNCV_F32;
+    save_binaryfile(dictionaryPath.string().c_str(), assets::pack_dictionary(dictionary));
 
-    std::vector<VertexFormat> _vertices;
-    std::vector<uint32_t> _indices;
+    CompressionPolicy policy = convState.meshPolicy;
+    policy.dictionary = &dictionary;
+    for (auto &path : meshes)
+    {
+        UnpackedMesh mesh;
+        if (!load_mesh(path, mesh))
+            continue;
 
-    extract_mesh_from_obj(shapes, attrib, _indices, _vertices);
+        assets::AssetFile newMesh = assets::pack_mesh(&mesh.info, mesh.vertices.data(), mesh.indices.data(),
+                                                      mesh.meshlets.empty() ? nullptr : mesh.meshlets.data(), policy);
+        save_binaryfile(path.string().c_str(), newMesh);
+    }
 
-    MeshInfo meshinfo;
-    meshinfo.vertexFormat = VertexFormatEnum;
-    meshinfo.vertexBuferSize = _vertices.size() * sizeof(VertexFormat);
-    meshinfo.indexBuferSize = _indices.size() * sizeof(uint32_t);
-    meshinfo.indexSize = sizeof(uint32_t);
-    meshinfo.originalFile = input.string();
+    assets::register_dictionary(std::move(dictionary));
+    return true;
+}
 
-    meshinfo.bounds = assets::calculateBounds(_vertices.data(), _vertices.size());
-    // pack mesh file
-    auto start = std::chrono::high_resolution_clock::now();
+void pack_vertex(assets::Vertex_f32_PNCV &new_vert, float vx, float vy, float vz, float nx, float ny, float nz, float ux, float uy)
+{
+    new_vert.position[0] = vx;
+    new_vert.position[1] = vy;
+    new_vert.position[2] = vz;
 
-    assets::AssetFile newFile = assets::pack_mesh(&meshinfo, (char *)_vertices.data(), (char *)_indices.data());
+    new_vert.normal[0] = nx;
+    new_vert.normal[1] = ny;
+    new_vert.normal[2] = nz;
 
-    auto end = std::chrono::high_resolution_clock::now();
+    // obj has no vertex colors, same as the engine loader we are using the normal. This is just for display purposes
+    new_vert.color[0] = nx;
+    new_vert.color[1] = ny;
+    new_vert.color[2] = nz;
 
-    diff = end - start;
+    new_vert.uv[0] = ux;
+    new_vert.uv[1] = 1 - uy;
+}
+void pack_vertex(assets::Vertex_P32N8C8V16 &new_vert, float vx, float vy, float vz, float nx, float ny, float nz, float ux, float uy)
+{
+    new_vert.position[0] = vx;
+    new_vert.position[1] = vy;
+    new_vert.position[2] = vz;
 
-    std::cout << "compression took " << std::chrono::duration_cast<std::chrono::nanoseconds>(diff).count() / 1000000.0 << "ms" << std::endl;
+    new_vert.normal[0] = int8_t(std::lround(nx * 127.0));
+    new_vert.normal[1] = int8_t(std::lround(ny * 127.0));
+    new_vert.normal[2] = int8_t(std::lround(nz * 127.0));
+    new_vert.normal[3] = 0;
 
-    // save to disk
-    save_binaryfile(output.string().c_str(), newFile);
+    new_vert.color[0] = new_vert.color[1] = new_vert.color[2] = 255;
+    new_vert.color[3] = 255;
 
-    return true;
+    new_vert.uv[0] = assets::float_to_half(ux);
+    new_vert.uv[1] = assets::float_to_half(1 - uy);
 }
 
-void unpack_gltf_buffer(tinygltf::Model &model, tinygltf::Accessor &accesor, std::vector<uint8_t> &outputBuffer)
+template <typename V>
+void extract_mesh_from_obj(const assets::ObjMesh &obj, std::vector<uint32_t> &_indices, std::vector<V> &_vertices)
 {
-    int bufferID = accesor.bufferView;
-    size_t elementSize = tinygltf::GetComponentSizeInBytes(accesor.componentType);
+    _indices.reserve(_indices.size() + obj.indices.size());
+    _vertices.reserve(_vertices.size() + obj.indices.size());
 
-    tinygltf::BufferView &bufferView = model.bufferViews[bufferID];
+    for (size_t i = 0; i < obj.indices.size(); i++)
+    {
+        assets::ObjVertex corner = assets::obj_corner(obj, i);
 
-    tinygltf::Buffer &bufferData = (model.buffers[bufferView.buffer]);
+        // copy it into our vertex
+        // zeroed, identical corners have to be identical bytes to get welded
+        V new_vert{};
+        pack_vertex(new_vert, corner.position[0], corner.position[1], corner.position[2],
+                    corner.normal[0], corner.normal[1], corner.normal[2], corner.uv[0], corner.uv[1]);
 
-    uint8_t *dataptr = bufferData.data.data() + accesor.byteOffset + bufferView.byteOffset;
+        _indices.push_back(_vertices.size());
+        _vertices.push_back(new_vert);
+    }
+}
 
-    int components = tinygltf::GetNumComponentsInType(accesor.type);
+// welds the extracted vertices, builds the lods, optimizes them and splits them into meshlets, then converts the vertices into the mesh format of
+// the converter and packs them. The bounds are always calculated on the full precision positions, quantized formats are relative to them.
+// Meshes bake concurrently, so the stats of each are printed as a single line starting with meshName
+assets::AssetFile bake_mesh(std::vector<assets::Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &indices, const fs::path &input, const std::string &meshName, const ConverterState &convState)
+{
+    const char *fileType = bake_file_type(input);
+    StageTimer meshTimer{convState.profiler, fileType, BakeStage::Mesh, vertices.size() * sizeof(assets::Vertex_f32_PNCV) + indices.size() * sizeof(uint32_t)};
 
-    elementSize *= components;
+    std::ostringstream report;
+    report << "mesh " << meshName << ": welded " << vertices.size() << " vertices into ";
+    assets::weld_vertices(vertices, indices);
+    report << vertices.size();
 
-    size_t stride = bufferView.byteStride;
-    if (stride == 0)
-    {
-        stride = elementSize;
-    }
+    MeshInfo meshinfo;
+    meshinfo.vertexFormat = convState.meshFormat;
+    meshinfo.indexSize = static_cast<char>(assets::select_index_size(vertices.size()));
+    meshinfo.originalFile = input.string();
 
-    outputBuffer.resize(accesor.count * elementSize);
+    meshinfo.bounds = assets::calculateBounds(vertices.data(), vertices.size());
 
-    for (int i = 0; i < accesor.count; i++)
+    std::vector<assets::MeshLodLevel> lods = assets::build_lod_chain(vertices, indices, convState.meshLods, meshinfo.bounds.radius * MESH_LOD_MAX_ERROR);
+
+    // triangles of every lod in cache order, then clusters of them sorted against overdraw
+    assets::VertexCacheStats before = assets::analyze_vertex_cache(indices, vertices.size());
+    indices.clear();
+    for (auto &lod : lods)
     {
-        uint8_t *dataindex = dataptr + stride * i;
-        uint8_t *targetptr = outputBuffer.data() + elementSize * i;
+        std::vector<uint32_t> clusterStarts;
+        assets::optimize_vertex_cache(lod.indices, vertices.size(), clusterStarts);
+        assets::optimize_overdraw(lod.indices, vertices, clusterStarts);
 
-        memcpy(targetptr, dataindex, elementSize);
-    }
-}
-void extract_gltf_vertices(tinygltf::Primitive &primitive, tinygltf::Model &model, std::vector<assets::Vertex_f32_PNCV> &_vertices)
-{
+        meshinfo.lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.indices.size()), 0, 0, lod.error});
+        indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
 
-    tinygltf::Accessor &pos_accesor = model.accessors[primitive.attributes["POSITION"]];
+        report << ", lod " << meshinfo.lods.size() - 1 << " " << lod.indices.size() / 3 << " triangles error " << lod.error;
+    }
 
-    _vertices.resize(pos_accesor.count);
+    // then vertices in the order they are fetched, lod 0 comes first in the index buffer and uses all of them
+    assets::optimize_vertex_fetch(vertices, indices);
+    std::vector<uint32_t> lod0(indices.begin(), indices.begin() + meshinfo.lods[0].indexCount);
+    assets::VertexCacheStats after = assets::analyze_vertex_cache(lod0, vertices.size());
 
-    std::vector<uint8_t> pos_data;
-    unpack_gltf_buffer(model, pos_accesor, pos_data);
+    report << ", ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr;
 
-    for (int i = 0; i < _vertices.size(); i++)
+    // meshlets of every lod, from its final cache ordered triangles
+    assets::MeshletBuilder meshlets;
+    for (assets::MeshLod &lod : meshinfo.lods)
     {
-        if (pos_accesor.type == TINYGLTF_TYPE_VEC3)
-        {
-            if (pos_accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
-            {
-                float *dtf = (float *)pos_data.data();
-
-                // vec3f
-                _vertices[i].position[0] = *(dtf + (i * 3) + 0);
-                _vertices[i].position[1] = *(dtf + (i * 3) + 1);
-                _vertices[i].position[2] = *(dtf + (i * 3) + 2);
-            }
-            else
-            {
-                assert(false);
-            }
-        }
-        else
-        {
-            assert(false);
-        }
+        std::vector<uint32_t> lodIndices(indices.begin() + lod.indexOffset, indices.begin() + lod.indexOffset + lod.indexCount);
+        lod.meshletOffset = static_cast<uint32_t>(meshlets.meshlets.size());
+        assets::build_meshlets(vertices, lodIndices, meshlets);
+        lod.meshletCount = static_cast<uint32_t>(meshlets.meshlets.size()) - lod.meshletOffset;
     }
+    std::vector<char> packedMeshlets = meshlets.pack(meshinfo);
+    report << ", " << meshinfo.meshletCount << " meshlets, " << meshinfo.lods[0].meshletCount << " in lod 0\n";
+    std::cout << report.str() << std::flush;
 
-    tinygltf::Accessor &normal_accesor = model.accessors[primitive.attributes["NORMAL"]];
+    std::vector<char> packedVertices = assets::convert_vertices(vertices.data(), vertices.size(), meshinfo.vertexFormat, meshinfo.bounds);
+    meshinfo.vertexBuferSize = packedVertices.size();
 
-    std::vector<uint8_t> normal_data;
-    unpack_gltf_buffer(model, normal_accesor, normal_data);
+    std::vector<char> packedIndices = assets::pack_indices(indices, meshinfo.indexSize);
+    meshinfo.indexBuferSize = packedIndices.size();
+    meshTimer.stop();
 
-    for (int i = 0; i < _vertices.size(); i++)
-    {
-        if (normal_accesor.type == TINYGLTF_TYPE_VEC3)
-        {
-            if (normal_accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
-            {
-                float *dtf = (float *)normal_data.data();
+    StageTimer lz4Timer{convState.profiler, fileType, BakeStage::LZ4, packedVertices.size() + packedIndices.size() + packedMeshlets.size()};
+    return assets::pack_mesh(&meshinfo, packedVertices.data(), packedIndices.data(), packedMeshlets.data(), convState.meshPolicy);
+}
 
-                // vec3f
-                _vertices[i].normal[0] = *(dtf + (i * 3) + 0);
-                _vertices[i].normal[1] = *(dtf + (i * 3) + 1);
-                _vertices[i].normal[2] = *(dtf + (i * 3) + 2);
+// bakes the obj into the content store like convert_image, and links output to it
+bool convert_mesh(const fs::path &input, const fs::path &output, const ConverterState &convState, BakeResult &result)
+{
+    assets::ObjMesh obj;
+    std::string err;
+    StageTimer decodeTimer{convState.profiler, "obj", BakeStage::Decode, source_file_size(input)};
 
-                _vertices[i].color[0] = *(dtf + (i * 3) + 0);
-                _vertices[i].color[1] = *(dtf + (i * 3) + 1);
-                _vertices[i].color[2] = *(dtf + (i * 3) + 2);
-            }
-            else
-            {
-                assert(false);
-            }
-        }
-        else
-        {
-            assert(false);
-        }
+    // load the OBJ file, split over every core when it is big enough
+    bool loaded = assets::load_obj(input.string().c_str(), obj, err);
+
+    decodeTimer.stop();
+
+    // if we have any error, print it to the console, and break the mesh loading.
+    // This happens if the file cant be found or is malformed
+    if (!loaded)
+    {
+        std::cerr << err << std::endl;
+        return false;
     }
 
-    tinygltf::Accessor &uv_accesor = model.accessors[primitive.attributes["TEXCOORD_0"]];
+    using VertexFormat = assets::Vertex_f32_PNCV;
 
-    std::vector<uint8_t> uv_data;
-    unpack_gltf_buffer(model, uv_accesor, uv_data);
+    std::vector<VertexFormat> _vertices;
+    std::vector<uint32_t> _indices;
 
-    for (int i = 0; i < _vertices.size(); i++)
     {
-        if (uv_accesor.type == TINYGLTF_TYPE_VEC2)
-        {
-            if (uv_accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT)
-            {
-                float *dtf = (float *)uv_data.data();
+        StageTimer extractTimer{convState.profiler, "obj", BakeStage::Decode};
+        extract_mesh_from_obj(obj, _indices, _vertices);
+    }
 
-                // vec3f
-                _vertices[i].uv[0] = *(dtf + (i * 2) + 0);
-                _vertices[i].uv[1] = *(dtf + (i * 2) + 1);
-            }
-            else
-            {
-                assert(false);
-            }
-        }
-        else
-        {
-            assert(false);
-        }
+    std::string options = mesh_options(convState);
+    fs::path payload = convState.content->payload_path(
+        payload_hash("mesh", hash_content(options.data(), options.size()),
+                     {{_vertices.data(), _vertices.size() * sizeof(VertexFormat)}, {_indices.data(), _indices.size() * sizeof(uint32_t)}}),
+        ".mesh");
+    result.outputs.push_back(payload);
+    if (!convState.content->claim(payload))
+    {
+        std::cout << "mesh " << input.filename() << " is already baked as " << payload.filename() << std::endl;
+        convState.content->link_output(output, payload);
+        return true;
     }
 
-    // for (auto& v : _vertices)
-    //{
-    //	v.position[0] *= -1;
-    //
-    //	v.normal[0] *= -1;
-    //	v.normal[1] *= -1;
-    //	v.normal[2] *= -1;
-    //	//v.position = flip * glm::vec4(v.position, 1.f);
-    // }
-    return;
+    // pack mesh file, bake_mesh times its own stages
+    assets::AssetFile newFile = bake_mesh(_vertices, _indices, input, input.filename().string(), convState);
+
+    // save to disk
+    if (!save_payload(payload, newFile, "obj", convState))
+    {
+        convState.content->release(payload);
+        return false;
+    }
+    convState.content->link_output(output, payload);
+    return true;
 }
 
-void extract_gltf_indices(tinygltf::Primitive &primitive, tinygltf::Model &model, std::vector<uint32_t> &_primindices)
+// the attribute index of the primitive, -1 when it does not have it
+int find_gltf_attribute(const tinygltf::Primitive &primitive, const char *name)
 {
-    int indexaccesor = primitive.indices;
-
-    int indexbuffer = model.accessors[indexaccesor].bufferView;
-    int componentType = model.accessors[indexaccesor].componentType;
-    size_t indexsize = tinygltf::GetComponentSizeInBytes(componentType);
+    auto attribute = primitive.attributes.find(name);
+    return attribute != primitive.attributes.end() ? attribute->second : -1;
+}
 
-    tinygltf::BufferView &indexview = model.bufferViews[indexbuffer];
-    int bufferidx = indexview.buffer;
+// reads every attribute straight from its buffer into the vertices, without unpacking it first.
+// normals and uvs are optional and left at zero when missing
+bool extract_gltf_vertices(const tinygltf::Primitive &primitive, const GltfSource &source, std::vector<assets::Vertex_f32_PNCV> &_vertices)
+{
+    using VertexFormat = assets::Vertex_f32_PNCV;
 
-    tinygltf::Buffer &buffindex = (model.buffers[bufferidx]);
+    GltfAccessorView positions;
+    if (!gltf_accessor_view(source, find_gltf_attribute(primitive, "POSITION"), positions))
+    {
+        std::cerr << "primitive has no readable positions" << std::endl;
+        return false;
+    }
 
-    uint8_t *dataptr = buffindex.data.data() + indexview.byteOffset;
+    _vertices.assign(positions.count, VertexFormat{});
+    if (positions.count == 0)
+    {
+        return true;
+    }
 
-    std::vector<uint8_t> unpackedIndices;
-    unpack_gltf_buffer(model, model.accessors[indexaccesor], unpackedIndices);
+    if (!gather_floats(positions, 3, _vertices[0].position, sizeof(VertexFormat)))
+    {
+        std::cerr << "primitive positions are not 3 components" << std::endl;
+        return false;
+    }
 
-    for (int i = 0; i < model.accessors[indexaccesor].count; i++)
+    GltfAccessorView normals;
+    if (gltf_accessor_view(source, find_gltf_attribute(primitive, "NORMAL"), normals) && normals.count == positions.count)
     {
+        // color is the normal, this is just for display purposes
+        if (!gather_floats(normals, 3, _vertices[0].normal, sizeof(VertexFormat)) ||
+            !gather_floats(normals, 3, _vertices[0].color, sizeof(VertexFormat)))
+        {
+            std::cerr << "primitive normals are not 3 components" << std::endl;
+            return false;
+        }
+    }
 
-        uint32_t index;
-        switch (componentType)
+    GltfAccessorView uvs;
+    if (gltf_accessor_view(source, find_gltf_attribute(primitive, "TEXCOORD_0"), uvs) && uvs.count == positions.count)
+    {
+        if (!gather_floats(uvs, 2, _vertices[0].uv, sizeof(VertexFormat)))
         {
-        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            std::cerr << "primitive uvs are not 2 components" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool extract_gltf_indices(const tinygltf::Primitive &primitive, const GltfSource &source, size_t vertexCount, std::vector<uint32_t> &_primindices)
+{
+    if (primitive.indices < 0)
+    {
+        // not indexed, every 3 vertices are a triangle
+        _primindices.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
         {
-            uint16_t *bfr = (uint16_t *)unpackedIndices.data();
-            index = *(bfr + i);
+            _primindices[i] = uint32_t(i);
         }
-        break;
-        case TINYGLTF_COMPONENT_TYPE_SHORT:
+    }
+    else
+    {
+        GltfAccessorView indices;
+        if (!gltf_accessor_view(source, primitive.indices, indices))
         {
-            int16_t *bfr = (int16_t *)unpackedIndices.data();
-            index = *(bfr + i);
+            std::cerr << "primitive indices can not be read" << std::endl;
+            return false;
         }
-        break;
-        default:
-            assert(false);
+        _primindices.resize(indices.count);
+        if (!gather_indices(indices, _primindices.data()))
+        {
+            std::cerr << "primitive indices are not 8, 16 or 32 bit" << std::endl;
+            return false;
         }
+    }
 
-        _primindices.push_back(index);
+    // welding and the cache optimizer index their tables with these, like the accessors they have to stay in bounds
+    if (_primindices.size() % 3 != 0)
+    {
+        std::cerr << "primitive has " << _primindices.size() << " indices, not whole triangles" << std::endl;
+        return false;
+    }
+    for (uint32_t index : _primindices)
+    {
+        if (index >= vertexCount)
+        {
+            std::cerr << "primitive index " << index << " is past its " << vertexCount << " vertices" << std::endl;
+            return false;
+        }
     }
 
-    for (int i = 0; i < _primindices.size() / 3; i++)
+    for (size_t i = 0; i < _primindices.size() / 3; i++)
     {
         // flip the triangle
 
         std::swap(_primindices[i * 3 + 1], _primindices[i * 3 + 2]);
     }
+    return true;
 }
 
-std::string calculate_gltf_mesh_name(tinygltf::Model &model, int meshIndex, int primitiveIndex)
+std::string calculate_gltf_mesh_name(const tinygltf::Model &model, int meshIndex, int primitiveIndex)
 {
     char buffer0[50];
     char buffer1[50];
@@ -480,51 +979,74 @@ std::string calculate_gltf_mesh_name(tinygltf::Model &model, int meshIndex, int
 
     return meshname;
 }
-bool extract_gltf_meshes(tinygltf::Model &model, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState)
+// bakes every primitive into the content store, and fills meshPayloads with the payload of each primitive by mesh index,
+// for the prefab to point at
+bool extract_gltf_meshes(const GltfSource &source, const fs::path &input, const ConverterState &convState,
+                         std::vector<std::vector<fs::path>> &meshPayloads)
 {
-    tinygltf::Model *glmod = &model;
+    auto &model = source.model;
+
+    meshPayloads.resize(model.meshes.size());
     for (auto meshindex = 0; meshindex < model.meshes.size(); meshindex++)
     {
+        meshPayloads[meshindex].resize(model.meshes[meshindex].primitives.size());
+    }
+    std::string options = mesh_options(convState);
+    uint64_t optionsHash = hash_content(options.data(), options.size());
 
+    // every primitive is its own mesh file, baked in parallel
+    JobPool::Group primitives;
+    std::atomic<bool> failed{false};
+    for (auto meshindex = 0; meshindex < model.meshes.size(); meshindex++)
+    {
         auto &glmesh = model.meshes[meshindex];
 
-        using VertexFormat = assets::Vertex_f32_PNCV;
-        auto VertexFormatEnum = assets::VertexFormat::PNCV_F32;
-
-        std::vector<VertexFormat> _vertices;
-        std::vector<uint32_t> _indices;
-
         for (auto primindex = 0; primindex < glmesh.primitives.size(); primindex++)
         {
+            convState.jobs->run(primitives, [&, meshindex, primindex]()
+                                {
+                using VertexFormat = assets::Vertex_f32_PNCV;
 
-            _vertices.clear();
-            _indices.clear();
-
-            std::string meshname = calculate_gltf_mesh_name(model, meshindex, primindex);
-
-            auto &primitive = glmesh.primitives[primindex];
-
-            extract_gltf_indices(primitive, model, _indices);
-            extract_gltf_vertices(primitive, model, _vertices);
+                std::vector<VertexFormat> _vertices;
+                std::vector<uint32_t> _indices;
 
-            MeshInfo meshinfo;
-            meshinfo.vertexFormat = VertexFormatEnum;
-            meshinfo.vertexBuferSize = _vertices.size() * sizeof(VertexFormat);
-            meshinfo.indexBuferSize = _indices.size() * sizeof(uint32_t);
-            meshinfo.indexSize = sizeof(uint32_t);
-            meshinfo.originalFile = input.string();
+                std::string meshname = calculate_gltf_mesh_name(model, meshindex, primindex);
 
-            meshinfo.bounds = assets::calculateBounds(_vertices.data(), _vertices.size());
+                auto &primitive = model.meshes[meshindex].primitives[primindex];
 
-            assets::AssetFile newFile = assets::pack_mesh(&meshinfo, (char *)_vertices.data(), (char *)_indices.data());
+                StageTimer extractTimer{convState.profiler, "gltf", BakeStage::Decode};
+                if (!extract_gltf_vertices(primitive, source, _vertices) ||
+                    !extract_gltf_indices(primitive, source, _vertices.size(), _indices))
+                {
+                    std::cerr << "skipping " << meshname << std::endl;
+                    failed = true;
+                    return;
+                }
+                extractTimer.set_bytes(_vertices.size() * sizeof(VertexFormat) + _indices.size() * sizeof(uint32_t));
+                extractTimer.stop();
+
+                fs::path payload = convState.content->payload_path(
+                    payload_hash("mesh", optionsHash,
+                                 {{_vertices.data(), _vertices.size() * sizeof(VertexFormat)}, {_indices.data(), _indices.size() * sizeof(uint32_t)}}),
+                    ".mesh");
+                meshPayloads[meshindex][primindex] = payload;
+                if (!convState.content->claim(payload))
+                {
+                    return;
+                }
 
-            fs::path meshpath = outputFolder / (meshname + ".mesh");
+                assets::AssetFile newFile = bake_mesh(_vertices, _indices, input, input.filename().string() + "/" + meshname, convState);
 
-            // save to disk
-            save_binaryfile(meshpath.string().c_str(), newFile);
+                // save to disk
+                if (!save_payload(payload, newFile, "gltf", convState))
+                {
+                    convState.content->release(payload);
+                    failed = true;
+                } });
         }
     }
-    return true;
+    convState.jobs->wait(primitives);
+    return !failed;
 }
 
 std::string calculate_gltf_material_name(tinygltf::Model &model, int materialIndex)
@@ -536,111 +1058,108 @@ std::string calculate_gltf_material_name(tinygltf::Model &model, int materialInd
     return matname;
 }
 
-void extract_gltf_materials(tinygltf::Model &model, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState)
+// export relative path of the baked texture of a gltf image, the payload it was baked to if the bake knows it
+fs::path gltf_texture_path(const tinygltf::Image &image, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState)
 {
-
-    int nm = 0;
-    for (auto &glmat : model.materials)
+    fs::path payload = convState.content->source_payload(input.parent_path() / image.uri);
+    if (!payload.empty())
     {
-        std::string matname = calculate_gltf_material_name(model, nm);
-
-        nm++;
-        auto &pbr = glmat.pbrMetallicRoughness;
-
-        assets::MaterialInfo newMaterial;
-        newMaterial.baseEffect = "defaultPBR";
-
-        {
-            if (pbr.baseColorTexture.index < 0)
-            {
-                pbr.baseColorTexture.index = 0;
-            }
-            auto baseColor = model.textures[pbr.baseColorTexture.index];
-            auto baseImage = model.images[baseColor.source];
-
-            fs::path baseColorPath = outputFolder.parent_path() / baseImage.uri;
-
-            baseColorPath.replace_extension(".tx");
-
-            baseColorPath = convState.convert_to_export_relative(baseColorPath);
-
-            newMaterial.textures["baseColor"] = baseColorPath.string();
-        }
-        if (pbr.metallicRoughnessTexture.index >= 0)
-        {
-            auto image = model.textures[pbr.metallicRoughnessTexture.index];
-            auto baseImage = model.images[image.source];
-
-            fs::path baseColorPath = outputFolder.parent_path() / baseImage.uri;
-
-            baseColorPath.replace_extension(".tx");
+        return convState.convert_to_export_relative(payload);
+    }
 
-            baseColorPath = convState.convert_to_export_relative(baseColorPath);
+    fs::path texturePath = outputFolder.parent_path() / image.uri;
+    texturePath.replace_extension(".tx");
+    return convState.convert_to_export_relative(texturePath);
+}
 
-            newMaterial.textures["metallicRoughness"] = baseColorPath.string();
-        }
+void extract_gltf_materials(tinygltf::Model &model, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState)
+{
+    // every material only touches its own gltf material and file, they are baked in parallel
+    JobPool::Group materials;
+    for (int nm = 0; nm < model.materials.size(); nm++)
+    {
+        convState.jobs->run(materials, [&, nm]()
+                            {
+            auto &glmat = model.materials[nm];
+            std::string matname = calculate_gltf_material_name(model, nm);
+            auto &pbr = glmat.pbrMetallicRoughness;
 
-        if (glmat.normalTexture.index >= 0)
-        {
-            auto image = model.textures[glmat.normalTexture.index];
-            auto baseImage = model.images[image.source];
+            assets::MaterialInfo newMaterial;
+            newMaterial.baseEffect = "defaultPBR";
 
-            fs::path baseColorPath = outputFolder.parent_path() / baseImage.uri;
+            {
+                if (pbr.baseColorTexture.index < 0)
+                {
+                    pbr.baseColorTexture.index = 0;
+                }
+                auto baseColor = model.textures[pbr.baseColorTexture.index];
+                auto baseImage = model.images[baseColor.source];
 
-            baseColorPath.replace_extension(".tx");
+                fs::path baseColorPath = gltf_texture_path(baseImage, input, outputFolder, convState);
 
-            baseColorPath = convState.convert_to_export_relative(baseColorPath);
+                newMaterial.textures["baseColor"] = baseColorPath.string();
+            }
+            if (pbr.metallicRoughnessTexture.index >= 0)
+            {
+                auto image = model.textures[pbr.metallicRoughnessTexture.index];
+                auto baseImage = model.images[image.source];
 
-            newMaterial.textures["normals"] = baseColorPath.string();
-        }
+                fs::path baseColorPath = gltf_texture_path(baseImage, input, outputFolder, convState);
 
-        if (glmat.occlusionTexture.index >= 0)
-        {
-            auto image = model.textures[glmat.occlusionTexture.index];
-            auto baseImage = model.images[image.source];
+                newMaterial.textures["metallicRoughness"] = baseColorPath.string();
+            }
 
-            fs::path baseColorPath = outputFolder.parent_path() / baseImage.uri;
+            if (glmat.normalTexture.index >= 0)
+            {
+                auto image = model.textures[glmat.normalTexture.index];
+                auto baseImage = model.images[image.source];
 
-            baseColorPath.replace_extension(".tx");
+                fs::path baseColorPath = gltf_texture_path(baseImage, input, outputFolder, convState);
 
-            baseColorPath = convState.convert_to_export_relative(baseColorPath);
+                newMaterial.textures["normals"] = baseColorPath.string();
+            }
 
-            newMaterial.textures["occlusion"] = baseColorPath.string();
-        }
+            if (glmat.occlusionTexture.index >= 0)
+            {
+                auto image = model.textures[glmat.occlusionTexture.index];
+                auto baseImage = model.images[image.source];
 
-        if (glmat.emissiveTexture.index >= 0)
-        {
-            auto image = model.textures[glmat.emissiveTexture.index];
-            auto baseImage = model.images[image.source];
+                fs::path baseColorPath = gltf_texture_path(baseImage, input, outputFolder, convState);
 
-            fs::path baseColorPath = outputFolder.parent_path() / baseImage.uri;
+                newMaterial.textures["occlusion"] = baseColorPath.string();
+            }
 
-            baseColorPath.replace_extension(".tx");
+            if (glmat.emissiveTexture.index >= 0)
+            {
+                auto image = model.textures[glmat.emissiveTexture.index];
+                auto baseImage = model.images[image.source];
 
-            baseColorPath = convState.convert_to_export_relative(baseColorPath);
+                fs::path baseColorPath = gltf_texture_path(baseImage, input, outputFolder, convState);
 
-            newMaterial.textures["emissive"] = baseColorPath.string();
-        }
+                newMaterial.textures["emissive"] = baseColorPath.string();
+            }
 
-        fs::path materialPath = outputFolder / (matname + ".mat");
+            fs::path materialPath = outputFolder / (matname + ".mat");
 
-        if (glmat.alphaMode.compare("BLEND") == 0)
-        {
-            newMaterial.transparency = TransparencyMode::Transparent;
-        }
-        else
-        {
-            newMaterial.transparency = TransparencyMode::Opaque;
-        }
+            if (glmat.alphaMode.compare("BLEND") == 0)
+            {
+                newMaterial.transparency = TransparencyMode::Transparent;
+            }
+            else
+            {
+                newMaterial.transparency = TransparencyMode::Opaque;
+            }
 
-        assets::AssetFile newFile = assets::pack_material(&newMaterial);
+            assets::AssetFile newFile = assets::pack_material(&newMaterial);
 
-        // save to disk
-        save_binaryfile(materialPath.string().c_str(), newFile);
+            // save to disk
+            save_binaryfile(materialPath.string().c_str(), newFile); });
     }
+    convState.jobs->wait(materials);
 }
 
-void extract_gltf_nodes(tinygltf::Model &model, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState)
+void extract_gltf_nodes(tinygltf::Model &model, const fs::path &input, const fs::path &outputFolder, const ConverterState &convState,
+                        const std::vector<std::vector<fs::path>> &meshPayloads)
 {
     assets::PrefabInfo prefab;
 
@@ -719,9 +1238,8 @@ void extract_gltf_nodes(tinygltf::Model &model, const fs::path &input, const fs:
             else
             {
                 auto primitive = mesh.primitives[0];
-                std::string meshname = calculate_gltf_mesh_name(model, node.mesh, 0);
 
-                fs::path meshpath = outputFolder / (meshname + ".mesh");
+                const fs::path &meshpath = meshPayloads[node.mesh][0];
 
                 int material = primitive.material;
 
@@ -803,10 +1321,9 @@ void extract_gltf_nodes(tinygltf::Model &model, const fs::path &input, const fs:
             int material = primitive.material;
             auto mat = model.materials[material];
             std::string matname = calculate_gltf_material_name(model, material);
-            std::string meshname = calculate_gltf_mesh_name(model, node.mesh, primindex);
 
             fs::path materialpath = outputFolder / (matname + ".mat");
-            fs::path meshpath = outputFolder / (meshname + ".mesh");
+            const fs::path &meshpath = meshPayloads[node.mesh][primindex];
 
             assets::PrefabInfo::NodeMesh nmesh;
             nmesh.mesh_path = convState.convert_to_export_relative(meshpath).string();
@@ -934,7 +1451,6 @@ void extract_assimp_meshes(const aiScene *scene, const fs::path &input, const fs
         auto mesh = scene->mMeshes[meshindex];
 
         using VertexFormat = assets::Vertex_f32_PNCV;
-        auto VertexFormatEnum = assets::VertexFormat::PNCV_F32;
 
         std::vector<VertexFormat> _vertices;
         std::vector<uint32_t> _indices;
@@ -1009,16 +1525,7 @@ void extract_assimp_meshes(const aiScene *scene, const fs::path &input, const fs
             }
         }
 
-        MeshInfo meshinfo;
-        meshinfo.vertexFormat = VertexFormatEnum;
-        meshinfo.vertexBuferSize = _vertices.size() * sizeof(VertexFormat);
-        meshinfo.indexBuferSize = _indices.size() * sizeof(uint32_t);
-        meshinfo.indexSize = sizeof(uint32_t);
-        meshinfo.originalFile = input.string();
-
-        meshinfo.bounds = assets::calculateBounds(_vertices.data(), _vertices.size());
-
-        assets::AssetFile newFile = assets::pack_mesh(&meshinfo, (char *)_vertices.data(), (char *)_indices.data());
+        assets::AssetFile newFile = bake_mesh(_vertices, _indices, input, input.filename().string() + "/" + meshname, convState);
 
         fs::path meshpath = outputFolder / (meshname + ".mesh");
 
@@ -1127,6 +1634,309 @@ void extract_assimp_nodes(const aiScene *scene, const fs::path &input, const fs:
     save_binaryfile(scenefilepath.string().c_str(), newFile);
 }
 
+bool is_bakeable(const fs::path &path)
+{
+    return is_texture_source(path) || path.extension() == ".obj" || is_gltf_source(path);
+}
+
+// bakes one source file, runs as a job. Every file writes its own outputs, so the results do not depend on the order jobs run in
+bool bake_file(const fs::path &input, fs::path export_path, const ConverterState &convState, BakeResult &result)
+{
+    if (is_texture_source(input))
+    {
+        std::cout << "found a texture" << std::endl;
+        export_path.replace_extension(".tx");
+        result.outputs.push_back(export_path);
+        return convert_image(input, export_path, convState, result);
+    }
+    if (input.extension() == ".obj")
+    {
+        std::cout << "found a mesh" << std::endl;
+        export_path.replace_extension(".mesh");
+        result.outputs.push_back(export_path);
+        return convert_mesh(input, export_path, convState, result);
+    }
+    if (is_gltf_source(input))
+    {
+        GltfSource source;
+        std::string err;
+        std::string warn;
+
+        StageTimer decodeTimer{convState.profiler, "gltf", BakeStage::Decode, source_file_size(input)};
+        bool ret = load_gltf(input, source, err, warn);
+        decodeTimer.stop();
+        auto &model = source.model;
+
+        if (!warn.empty())
+        {
+            printf("Warn: %s\n", warn.c_str());
+        }
+        if (!err.empty())
+        {
+            printf("Err: %s\n", err.c_str());
+        }
+        if (!ret)
+        {
+            printf("Failed to parse glTF\n");
+            return false;
+        }
+        else
+        {
+            auto folder = export_path.parent_path() / (input.stem().string() + "_GLTF");
+            fs::create_directory(folder);
+            result.outputs.push_back(folder);
+
+            // the buffers hold the mesh data, and the images are what the materials point at
+            for (auto &buffer : model.buffers)
+            {
+                if (!buffer.uri.empty() && buffer.uri.rfind("data:", 0) != 0)
+                {
+                    result.dependencies.push_back(input.parent_path() / buffer.uri);
+                }
+            }
+            for (auto &image : model.images)
+            {
+                if (!image.uri.empty() && image.uri.rfind("data:", 0) != 0)
+                {
+                    result.dependencies.push_back(input.parent_path() / image.uri);
+                }
+            }
+
+            std::vector<std::vector<fs::path>> meshPayloads;
+            bool meshesBaked = extract_gltf_meshes(source, input, convState, meshPayloads);
+            for (auto &primitives : meshPayloads)
+            {
+                result.outputs.insert(result.outputs.end(), primitives.begin(), primitives.end());
+            }
+
+            extract_gltf_materials(model, input, folder, convState);
+
+            extract_gltf_nodes(model, input, folder, convState, meshPayloads);
+
+            return meshesBaked;
+        }
+    }
+    if (false)
+    { // input.extension() == ".fbx") {
+        const aiScene *scene;
+        {
+            Assimp::Importer importer;
+            // ZoneScopedNC("Assimp load", tracy::Color::Magenta);
+            // const char* path = input.string().c_str();
+            auto start1 = std::chrono::system_clock::now();
+            scene = importer.ReadFile(input.string(), aiProcess_OptimizeMeshes | aiProcess_GenNormals | aiProcess_FlipUVs); // aiProcess_Triangulate | aiProcess_OptimizeMeshes | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_GenBoundingBoxes);
+            auto end = std::chrono::system_clock::now();
+            auto elapsed = end - start1;
+            std::cout << "Assimp load time " << elapsed.count() << '\n';
+            auto folder = export_path.parent_path() / (input.stem().string() + "_GLTF");
+            fs::create_directory(folder);
+            extract_assimp_materials(scene, input, folder, convState);
+            extract_assimp_meshes(scene, input, folder, convState);
+            extract_assimp_nodes(scene, input, folder, convState);
+
+            std::vector<aiMaterial *> materials;
+            std::vector<std::string> materialNames;
+            materials.reserve(scene->mNumMaterials);
+            for (int m = 0; m < scene->mNumMaterials; m++)
+            {
+                materials.push_back(scene->mMaterials[m]);
+                materialNames.push_back(scene->mMaterials[m]->GetName().C_Str());
+            }
+
+            std::cout << importer.GetErrorString();
+
+            // std::cout << "Assimp Meshes: " << scene->mMeshes;
+        }
+    }
+    return true;
+}
+
+// bakes every file in the directory that changed since the manifest was written, as jobs on the pool of the converter.
+// textures bake first, so the materials of the scenes can point at the payloads they were stored as.
+// returns how many files failed
+uint32_t bake_directory(const fs::path &directory, const fs::path &exported_dir, const ConverterState &convState, BakeManifest &manifest)
+{
+    convState.content->begin_bake();
+
+    std::vector<std::pair<fs::path, fs::path>> textures;
+    std::vector<std::pair<fs::path, fs::path>> others;
+    for (auto &p : fs::recursive_directory_iterator(directory))
+    {
+        auto relative = p.path().lexically_proximate(directory);
+        auto export_path = exported_dir / relative;
+        if (!fs::is_directory(export_path.parent_path()))
+        {
+            fs::create_directory(export_path.parent_path());
+        }
+        if (!p.is_regular_file() || !is_bakeable(p.path()))
+            continue;
+
+        (is_texture_source(p.path()) ? textures : others).push_back({p.path(), export_path});
+    }
+
+    std::atomic<uint32_t> failedFiles{0};
+    std::atomic<uint32_t> skippedFiles{0};
+    auto bake = [&](const fs::path &input, const fs::path &export_path)
+    {
+        ManifestEntry current;
+        if (manifest.is_up_to_date(input, bake_options_hash(input, convState), current))
+        {
+            skippedFiles++;
+            // the payload of a texture that is not baked again is still what its materials point at
+            for (auto &output : manifest.recorded_outputs(input))
+            {
+                if (is_texture_source(input) && output.parent_path() == convState.content->folder())
+                {
+                    convState.content->set_source_payload(input, output);
+                }
+            }
+            return;
+        }
+
+        std::cout << "File: " << input << std::endl;
+        BakeResult result;
+        auto start = std::chrono::steady_clock::now();
+        bool baked = bake_file(input, export_path, convState, result);
+        if (convState.profiler)
+        {
+            convState.profiler->add_file(bake_file_type(input), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                                         source_file_size(input));
+        }
+        if (!baked)
+        {
+            failedFiles++;
+            manifest.forget(input);
+            return;
+        }
+        manifest.record(input, current, result.outputs, result.dependencies);
+    };
+
+    for (auto *phase : {&textures, &others})
+    {
+        JobPool::Group files;
+        for (auto &[input, export_path] : *phase)
+        {
+            convState.jobs->run(files, [&, input = input, export_path = export_path]()
+                                { bake(input, export_path); });
+        }
+        convState.jobs->wait(files);
+    }
+
+    // sources that pointed at a payload another job failed to bake, or whose output could not be linked, failed too
+    std::vector<fs::path> missing = convState.content->missing_payloads();
+    for (auto &output : convState.content->finish_links())
+    {
+        missing.push_back(output);
+    }
+    for (auto &output : missing)
+    {
+        failedFiles += manifest.forget_output(output);
+    }
+    manifest.remove_missing_sources();
+    manifest.remove_unreferenced(convState.content->folder());
+    manifest.save();
+
+    std::cout << skippedFiles << " files were up to date, " << convState.content->reused_count() << " payloads were reused" << std::endl;
+    if (failedFiles > 0)
+    {
+        std::cout << failedFiles << " files failed to bake" << std::endl;
+    }
+    return failedFiles;
+}
+
+// size and write time of every file in the directory
+std::map<std::string, std::pair<uintmax_t, int64_t>> snapshot_directory(const fs::path &directory)
+{
+    std::map<std::string, std::pair<uintmax_t, int64_t>> snapshot;
+    std::error_code error;
+    for (auto &p : fs::recursive_directory_iterator(directory, error))
+    {
+        if (p.is_regular_file(error))
+        {
+            snapshot[p.path().generic_string()] = {p.file_size(error), p.last_write_time(error).time_since_epoch().count()};
+        }
+    }
+    return snapshot;
+}
+
+// polls the directory and calls bake whenever something in it changed, once the changes settle. Never returns
+void watch_directory(const fs::path &directory, const std::function<bool()> &bake)
+{
+    constexpr auto WATCH_INTERVAL = std::chrono::milliseconds(500);
+    std::cout << "watching " << directory << " for changes" << std::endl;
+
+    auto snapshot = snapshot_directory(directory);
+    while (true)
+    {
+        std::this_thread::sleep_for(WATCH_INTERVAL);
+        auto current = snapshot_directory(directory);
+        if (current == snapshot)
+            continue;
+
+        // editors and exporters write in steps, wait until a poll sees no more changes
+        do
+        {
+            snapshot = std::move(current);
+            std::this_thread::sleep_for(WATCH_INTERVAL);
+            current = snapshot_directory(directory);
+        } while (current != snapshot);
+
+        std::cout << "changes detected, rebaking" << std::endl;
+        bake();
+    }
+}
+
+// bakes a generated corpus from scratch the given number of times, and writes the percentiles of the runs to reportPath
+bool run_benchmark(uint32_t runs, const fs::path &reportPath, const ConverterState &baseState)
+{
+    fs::path root = fs::temp_directory_path() / "baker_benchmark";
+    fs::path corpus = root / "assets";
+    fs::path exported = root / "assets_export";
+    fs::remove_all(root);
+    if (!write_benchmark_corpus(corpus))
+    {
+        std::cout << "could not write the benchmark corpus to " << corpus << std::endl;
+        return false;
+    }
+
+    ConverterState convState = baseState;
+    convState.asset_path = corpus;
+    convState.export_path = exported;
+    BakeProfiler profiler;
+    convState.profiler = &profiler;
+
+    BenchmarkReport report;
+    bool success = true;
+    for (uint32_t run = 0; run < runs && success; run++)
+    {
+        std::cout << "benchmark run " << run + 1 << " of " << runs << std::endl;
+
+        // every run starts from an empty export folder and manifest, so nothing gets skipped
+        fs::remove_all(exported);
+        fs::create_directories(exported);
+        BakeManifest manifest;
+        manifest.init(corpus, exported);
+        ContentStore content;
+        content.init(exported);
+        convState.content = &content;
+        profiler.reset();
+
+        auto start = std::chrono::steady_clock::now();
+        collect_texture_usage(corpus, convState);
+        success = bake_directory(corpus, exported, convState, manifest) == 0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        report.add_run(seconds, profiler.stats());
+    }
+    fs::remove_all(root);
+
+    report.print();
+    std::ofstream outfile{reportPath, std::ios::trunc};
+    outfile << report.json(convState.jobs->thread_count());
+    std::cout << "benchmark report written to " << reportPath << std::endl;
+    return success && outfile.good();
+}
+
 int main(int argc, char *argv[])
 {
     if (argc < 2)
@@ -1145,97 +1955,191 @@ int main(int argc, char *argv[])
         convstate.asset_path = path;
         convstate.export_path = exported_dir;
 
-        for (auto &p : fs::recursive_directory_iterator(directory))
+        // --archive also packs everything in assets_export into a single archive file
+        // --texture-compression=None|LZ4|LZ4HC and --texture-level=N pick how hard textures get compressed
+        // --texture-format=RGBA8|BC1|BC3|BC4|BC5|BC7 stores every texture in that format, instead of picking one per texture
+        // --mip-filter=kaiser|box picks the filter mips are generated with, kaiser by default
+        // --dictionaries trains a shared dictionary for textures and one for meshes, and recompresses them against it
+        // --mesh-compression=None|LZ4|LZ4HC and --mesh-level=N pick how hard meshes get compressed
+        // --mesh-format=PNCV_F32|P32N8C8V16|P16N16C8V16|P16N8V16 picks the vertex format meshes are stored in
+        // --mesh-lods=N limits how many lods get generated per mesh, 1 for none
+        // --jobs=N bakes on N threads, 0 (the default) uses every core
+        // files that did not change since the last bake are skipped, --force rebakes everything anyway
+        // --watch keeps running after the bake, and rebakes whatever changes in the asset directory
+        // --profile=report.json writes the time and throughput of every stage of every kind of file after each bake
+        // --benchmark=N bakes a generated corpus N times from scratch instead of the asset directory, and writes the percentiles
+        // of every stage to the --profile path, or bake_benchmark.json next to the asset directory
+        bool buildArchive = false;
+        bool forceRebake = false;
+        bool watch = false;
+        uint32_t jobCount = 0;
+        bool buildDictionaries = false;
+        fs::path profilePath;
+        uint32_t benchmarkRuns = 0;
+        for (int i = 2; i < argc; i++)
         {
-            std::cout << "File: " << p << std::endl;
-
-            auto relative = p.path().lexically_proximate(directory);
-            auto export_path = exported_dir / relative;
-            if (!fs::is_directory(export_path.parent_path()))
+            if (strcmp(argv[i], "--archive") == 0)
             {
-                fs::create_directory(export_path.parent_path());
+                buildArchive = true;
             }
-
-            if (p.path().extension() == ".png" || p.path().extension() == ".jpg" || p.path().extension() == ".TGA")
+            else if (strcmp(argv[i], "--dictionaries") == 0)
             {
-                std::cout << "found a texture" << std::endl;
-                auto newpath = p.path();
-                export_path.replace_extension(".tx");
-                convert_image(p.path(), export_path);
+                buildDictionaries = true;
             }
-            if (p.path().extension() == ".obj")
+            else if (strncmp(argv[i], "--texture-compression=", 22) == 0)
             {
-                std::cout << "found a mesh" << std::endl;
-                export_path.replace_extension(".mesh");
-                convert_mesh(p.path(), export_path);
+                convstate.texturePolicy.mode = parse_compression(argv[i] + 22);
             }
-            if (p.path().extension() == ".gltf")
+            else if (strncmp(argv[i], "--texture-level=", 16) == 0)
             {
-                using namespace tinygltf;
-                Model model;
-                TinyGLTF loader;
-                std::string err;
-                std::string warn;
-
-                bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, p.path().string().c_str());
-
-                if (!warn.empty())
+                convstate.texturePolicy.level = atoi(argv[i] + 16);
+            }
+            else if (strncmp(argv[i], "--texture-format=", 17) == 0)
+            {
+                convstate.textureFormat = parse_texture_format(argv[i] + 17);
+                if (convstate.textureFormat == TextureFormat::Unknown)
                 {
-                    printf("Warn: %s\n", warn.c_str());
+                    std::cout << "Unknown texture format " << argv[i] + 17 << std::endl;
+                    return -1;
                 }
-                if (!err.empty())
+            }
+            else if (strncmp(argv[i], "--mip-filter=", 13) == 0)
+            {
+                convstate.mipFilter = parse_mip_filter(argv[i] + 13);
+                if (convstate.mipFilter == MipFilter::Unknown)
                 {
-                    printf("Err: %s\n", err.c_str());
+                    std::cout << "Unknown mip filter " << argv[i] + 13 << std::endl;
+                    return -1;
                 }
-                if (!ret)
+            }
+            else if (strcmp(argv[i], "--force") == 0)
+            {
+                forceRebake = true;
+            }
+            else if (strcmp(argv[i], "--watch") == 0)
+            {
+                watch = true;
+            }
+            else if (strncmp(argv[i], "--profile=", 10) == 0)
+            {
+                profilePath = argv[i] + 10;
+            }
+            else if (strncmp(argv[i], "--benchmark=", 12) == 0)
+            {
+                benchmarkRuns = static_cast<uint32_t>(std::max(atoi(argv[i] + 12), 1));
+            }
+            else if (strncmp(argv[i], "--jobs=", 7) == 0)
+            {
+                jobCount = static_cast<uint32_t>(std::max(atoi(argv[i] + 7), 0));
+            }
+            else if (strncmp(argv[i], "--mesh-compression=", 19) == 0)
+            {
+                convstate.meshPolicy.mode = parse_compression(argv[i] + 19);
+            }
+            else if (strncmp(argv[i], "--mesh-level=", 13) == 0)
+            {
+                convstate.meshPolicy.level = atoi(argv[i] + 13);
+            }
+            else if (strncmp(argv[i], "--mesh-lods=", 12) == 0)
+            {
+                convstate.meshLods = std::max(atoi(argv[i] + 12), 1);
+            }
+            else if (strncmp(argv[i], "--mesh-format=", 14) == 0)
+            {
+                convstate.meshFormat = parse_vertex_format(argv[i] + 14);
+                if (convstate.meshFormat == VertexFormat::Unknown)
                 {
-                    printf("Failed to parse glTF\n");
+                    std::cout << "Unknown mesh format " << argv[i] + 14 << std::endl;
                     return -1;
                 }
-                else
-                {
-                    auto folder = export_path.parent_path() / (p.path().stem().string() + "_GLTF");
-                    fs::create_directory(folder);
+            }
+        }
 
-                    extract_gltf_meshes(model, p.path(), folder, convstate);
+        fs::create_directories(exported_dir);
 
-                    extract_gltf_materials(model, p.path(), folder, convstate);
+        BakeManifest manifest;
+        manifest.init(directory, exported_dir);
+        if (!forceRebake)
+        {
+            manifest.load();
+        }
 
-                    extract_gltf_nodes(model, p.path(), folder, convstate);
-                }
+        JobPool jobs;
+        jobs.init(jobCount);
+        convstate.jobs = &jobs;
+        ContentStore content;
+        content.init(exported_dir);
+        convstate.content = &content;
+        std::cout << "baking with " << jobs.thread_count() << " threads" << std::endl;
+
+        if (benchmarkRuns > 0)
+        {
+            fs::path reportPath = profilePath.empty() ? path.parent_path() / "bake_benchmark.json" : profilePath;
+            bool benchmarked = run_benchmark(benchmarkRuns, reportPath, convstate);
+            jobs.shutdown();
+            return benchmarked ? 0 : -1;
+        }
+
+        BakeProfiler profiler;
+        convstate.profiler = &profiler;
+
+        auto bake_everything = [&]()
+        {
+            profiler.reset();
+            auto start = std::chrono::steady_clock::now();
+            collect_texture_usage(directory, convstate);
+            uint32_t failedFiles = bake_directory(directory, exported_dir, convstate, manifest);
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            print_bake_report(profiler.stats(), seconds);
+            if (!profilePath.empty())
+            {
+                write_bake_report(profilePath, profiler.stats(), seconds, jobs.thread_count());
+            }
+            if (failedFiles > 0)
+                return false;
+
+            if (buildDictionaries)
+            {
+                build_texture_dictionary(exported_dir, convstate);
+                build_mesh_dictionary(exported_dir, convstate);
             }
-            if (false)
-            { // p.path().extension() == ".fbx") {
-                const aiScene *scene;
+
+            if (buildArchive)
+            {
+                // entries are named the same way materials and prefabs reference them, relative to the export folder
+                // outputs linked to a payload are the same bytes under another name, they all point at the first file with those bytes
+                std::vector<assets::ArchiveSource> sources;
+                std::map<std::pair<uintmax_t, uint64_t>, std::string> firstFiles;
+                for (auto &p : fs::recursive_directory_iterator(exported_dir))
                 {
-                    Assimp::Importer importer;
-                    // ZoneScopedNC("Assimp load", tracy::Color::Magenta);
-                    // const char* path = p.path().string().c_str();
-                    auto start1 = std::chrono::system_clock::now();
-                    scene = importer.ReadFile(p.path().string(), aiProcess_OptimizeMeshes | aiProcess_GenNormals | aiProcess_FlipUVs); // aiProcess_Triangulate | aiProcess_OptimizeMeshes | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_GenBoundingBoxes);
-                    auto end = std::chrono::system_clock::now();
-                    auto elapsed = end - start1;
-                    std::cout << "Assimp load time " << elapsed.count() << '\n';
-                    auto folder = export_path.parent_path() / (p.path().stem().string() + "_GLTF");
-                    fs::create_directory(folder);
-                    extract_assimp_materials(scene, p.path(), folder, convstate);
-                    extract_assimp_meshes(scene, p.path(), folder, convstate);
-                    extract_assimp_nodes(scene, p.path(), folder, convstate);
-
-                    std::vector<aiMaterial *> materials;
-                    std::vector<std::string> materialNames;
-                    materials.reserve(scene->mNumMaterials);
-                    for (int m = 0; m < scene->mNumMaterials; m++)
+                    if (p.is_regular_file() && p.path().filename() != manifest.manifest_path().filename())
                     {
-                        materials.push_back(scene->mMaterials[m]);
-                        materialNames.push_back(scene->mMaterials[m]->GetName().C_Str());
+                        auto first = firstFiles.emplace(std::make_pair(p.file_size(), hash_file(p.path())), p.path().string()).first;
+                        sources.push_back({p.path().lexically_proximate(exported_dir).generic_string(), first->second});
                     }
+                }
 
-                    std::cout << importer.GetErrorString();
-
-                    // std::cout << "Assimp Meshes: " << scene->mMeshes;
+                fs::path archivePath = path.parent_path() / "assets_export.pak";
+                std::cout << "writing archive with " << sources.size() << " files to " << archivePath << std::endl;
+                if (!assets::write_archive(archivePath.string().c_str(), sources))
+                {
+                    return false;
                 }
             }
+            return true;
+        };
+
+        bool success = bake_everything();
+        if (watch)
+        {
+            watch_directory(directory, bake_everything);
+        }
+        jobs.shutdown();
+
+        if (!success)
+        {
+            return -1;
         }
     }
     return 0;
@@ -0,0 +1,338 @@
+#include "bake_benchmark.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr float PI = 3.14159265358979f;
+
+    uint32_t hash_texel(uint32_t x, uint32_t y)
+    {
+        uint32_t h = x * 0x8DA6B343u ^ y * 0xD8163841u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    // height of the bumps the normal map and the glb grid share, 0 to 1 over the surface
+    float bump_height(float u, float v)
+    {
+        return 0.5f + 0.25f * std::sin(u * 2 * PI * 8) * std::cos(v * 2 * PI * 6) + 0.25f * std::sin((u + v) * 2 * PI * 3);
+    }
+
+    // uncompressed 32 bit tga, top row first
+    bool write_tga(const fs::path &path, uint32_t size, const std::function<void(uint32_t x, uint32_t y, uint8_t rgba[4])> &texel)
+    {
+        uint8_t header[18] = {};
+        header[2] = 2;
+        header[12] = size & 0xFF;
+        header[13] = (size >> 8) & 0xFF;
+        header[14] = size & 0xFF;
+        header[15] = (size >> 8) & 0xFF;
+        header[16] = 32;
+        // 8 alpha bits, origin at the top left
+        header[17] = 0x28;
+
+        std::vector<uint8_t> pixels(size_t(size) * size * 4);
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                uint8_t rgba[4];
+                texel(x, y, rgba);
+                uint8_t *bgra = &pixels[(size_t(y) * size + x) * 4];
+                bgra[0] = rgba[2];
+                bgra[1] = rgba[1];
+                bgra[2] = rgba[0];
+                bgra[3] = rgba[3];
+            }
+        }
+
+        std::ofstream outfile{path, std::ios::binary | std::ios::trunc};
+        outfile.write(reinterpret_cast<const char *>(header), sizeof(header));
+        outfile.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+        return outfile.good();
+    }
+
+    uint8_t to_unorm8(float v)
+    {
+        return static_cast<uint8_t>(std::lround(std::min(std::max(v, 0.f), 1.f) * 255.f));
+    }
+
+    bool write_textures(const fs::path &directory)
+    {
+        const uint32_t size = BENCHMARK_TEXTURE_SIZE;
+        const float scale = 1.f / size;
+
+        auto color = [&](uint32_t x, uint32_t y, uint8_t rgba[4])
+        {
+            float u = x * scale, v = y * scale;
+            uint32_t noise = hash_texel(x, y);
+            rgba[0] = to_unorm8(0.5f + 0.4f * std::sin(u * 2 * PI * 3) + (noise & 0xF) / 255.f);
+            rgba[1] = to_unorm8(0.3f + 0.5f * v + ((noise >> 4) & 0xF) / 255.f);
+            rgba[2] = to_unorm8(0.6f * bump_height(u, v) + ((noise >> 8) & 0xF) / 255.f);
+            rgba[3] = 255;
+        };
+        auto transparent = [&](uint32_t x, uint32_t y, uint8_t rgba[4])
+        {
+            color(x, y, rgba);
+            // a soft edged cutout, and a fully transparent corner
+            float u = x * scale - 0.5f, v = y * scale - 0.5f;
+            rgba[3] = to_unorm8(1.5f - 4.f * std::sqrt(u * u + v * v));
+        };
+        auto normal = [&](uint32_t x, uint32_t y, uint8_t rgba[4])
+        {
+            float u = x * scale, v = y * scale;
+            float dx = (bump_height(u + scale, v) - bump_height(u - scale, v)) * size * 0.05f;
+            float dy = (bump_height(u, v + scale) - bump_height(u, v - scale)) * size * 0.05f;
+            float length = std::sqrt(dx * dx + dy * dy + 1.f);
+            rgba[0] = to_unorm8(-dx / length * 0.5f + 0.5f);
+            rgba[1] = to_unorm8(-dy / length * 0.5f + 0.5f);
+            rgba[2] = to_unorm8(1.f / length * 0.5f + 0.5f);
+            rgba[3] = 255;
+        };
+        auto mask = [&](uint32_t x, uint32_t y, uint8_t rgba[4])
+        {
+            float u = x * scale, v = y * scale;
+            uint32_t noise = hash_texel(x, y);
+            // occlusion in red, roughness in green, metallic in blue
+            rgba[0] = to_unorm8(bump_height(u, v));
+            rgba[1] = to_unorm8(0.2f + 0.6f * u + (noise & 0x1F) / 255.f);
+            rgba[2] = ((x / 64 + y / 64) & 1) ? 255 : 0;
+            rgba[3] = 255;
+        };
+
+        return write_tga(directory / "color_opaque.TGA", size, color) &&
+               write_tga(directory / "color_transparent.TGA", size, transparent) &&
+               write_tga(directory / "normal.TGA", size, normal) &&
+               write_tga(directory / "mask.TGA", size, mask);
+    }
+
+    bool write_obj_sphere(const fs::path &path)
+    {
+        const uint32_t segments = BENCHMARK_MESH_SEGMENTS;
+        const uint32_t rings = BENCHMARK_MESH_SEGMENTS / 2;
+
+        std::ofstream outfile{path, std::ios::trunc};
+        char line[128];
+        for (uint32_t r = 0; r <= rings; r++)
+        {
+            float theta = PI * r / rings;
+            for (uint32_t s = 0; s <= segments; s++)
+            {
+                float phi = 2 * PI * s / segments;
+                float nx = std::sin(theta) * std::cos(phi), ny = std::cos(theta), nz = std::sin(theta) * std::sin(phi);
+                float radius = 1.f + 0.05f * bump_height(float(s) / segments, float(r) / rings);
+                snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n",
+                         nx * radius, ny * radius, nz * radius, nx, ny, nz, float(s) / segments, 1.f - float(r) / rings);
+                outfile << line;
+            }
+        }
+        for (uint32_t r = 0; r < rings; r++)
+        {
+            for (uint32_t s = 0; s < segments; s++)
+            {
+                uint32_t a = r * (segments + 1) + s + 1;
+                uint32_t b = a + segments + 1;
+                snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, b + 1, b + 1, b + 1, a + 1, a + 1, a + 1);
+                outfile << line;
+            }
+        }
+        return outfile.good();
+    }
+
+    void append_bytes(std::vector<uint8_t> &buffer, const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    bool write_glb_grid(const fs::path &path)
+    {
+        const uint32_t quads = BENCHMARK_MESH_SEGMENTS;
+        const uint32_t side = quads + 1;
+        const size_t vertexCount = size_t(side) * side;
+
+        // interleaved position and normal, then uvs on their own, then 32 bit indices
+        std::vector<uint8_t> bin;
+        float minPosition[3] = {1e9f, 1e9f, 1e9f};
+        float maxPosition[3] = {-1e9f, -1e9f, -1e9f};
+        for (uint32_t y = 0; y < side; y++)
+        {
+            for (uint32_t x = 0; x < side; x++)
+            {
+                float u = float(x) / quads, v = float(y) / quads;
+                float h = bump_height(u, v);
+                float dx = (bump_height(u + 1e-3f, v) - bump_height(u - 1e-3f, v)) / 2e-3f * 0.1f;
+                float dz = (bump_height(u, v + 1e-3f) - bump_height(u, v - 1e-3f)) / 2e-3f * 0.1f;
+                float length = std::sqrt(dx * dx + dz * dz + 1.f);
+                float vertex[6] = {u * 10.f - 5.f, h, v * 10.f - 5.f, -dx / length, 1.f / length, -dz / length};
+                for (int c = 0; c < 3; c++)
+                {
+                    minPosition[c] = std::min(minPosition[c], vertex[c]);
+                    maxPosition[c] = std::max(maxPosition[c], vertex[c]);
+                }
+                append_bytes(bin, vertex, sizeof(vertex));
+            }
+        }
+        size_t uvOffset = bin.size();
+        for (uint32_t y = 0; y < side; y++)
+        {
+            for (uint32_t x = 0; x < side; x++)
+            {
+                float uv[2] = {float(x) / quads, float(y) / quads};
+                append_bytes(bin, uv, sizeof(uv));
+            }
+        }
+        size_t indexOffset = bin.size();
+        for (uint32_t y = 0; y < quads; y++)
+        {
+            for (uint32_t x = 0; x < quads; x++)
+            {
+                uint32_t a = y * side + x;
+                uint32_t quad[6] = {a, a + side, a + 1, a + 1, a + side, a + side + 1};
+                append_bytes(bin, quad, sizeof(quad));
+            }
+        }
+        size_t indexCount = size_t(quads) * quads * 6;
+
+        nlohmann::json gltf;
+        gltf["asset"] = {{"version", "2.0"}};
+        gltf["buffers"] = {{{"byteLength", bin.size()}}};
+        gltf["bufferViews"] = {
+            {{"buffer", 0}, {"byteOffset", 0}, {"byteLength", uvOffset}, {"byteStride", 24}},
+            {{"buffer", 0}, {"byteOffset", uvOffset}, {"byteLength", indexOffset - uvOffset}},
+            {{"buffer", 0}, {"byteOffset", indexOffset}, {"byteLength", bin.size() - indexOffset}}};
+        gltf["accessors"] = {
+            {{"bufferView", 0}, {"componentType", 5126}, {"count", vertexCount}, {"type", "VEC3"},
+             {"min", {minPosition[0], minPosition[1], minPosition[2]}}, {"max", {maxPosition[0], maxPosition[1], maxPosition[2]}}},
+            {{"bufferView", 0}, {"byteOffset", 12}, {"componentType", 5126}, {"count", vertexCount}, {"type", "VEC3"}},
+            {{"bufferView", 1}, {"componentType", 5126}, {"count", vertexCount}, {"type", "VEC2"}},
+            {{"bufferView", 2}, {"componentType", 5125}, {"count", indexCount}, {"type", "SCALAR"}}};
+        gltf["images"] = {{{"uri", "color_opaque.TGA"}}, {{"uri", "normal.TGA"}}, {{"uri", "mask.TGA"}}};
+        gltf["textures"] = {{{"source", 0}}, {{"source", 1}}, {{"source", 2}}};
+        gltf["materials"] = {
+            {{"name", "ground"},
+             {"pbrMetallicRoughness", {{"baseColorTexture", {{"index", 0}}}, {"metallicRoughnessTexture", {{"index", 2}}}}},
+             {"normalTexture", {{"index", 1}}}}};
+        gltf["meshes"] = {
+            {{"name", "grid"},
+             {"primitives", {{{"attributes", {{"POSITION", 0}, {"NORMAL", 1}, {"TEXCOORD_0", 2}}}, {"indices", 3}, {"material", 0}}}}}};
+        gltf["nodes"] = {{{"name", "grid"}, {"mesh", 0}}};
+        gltf["scenes"] = {{{"nodes", {0}}}};
+        gltf["scene"] = 0;
+
+        // both chunks are padded to 4 bytes, the json with spaces
+        std::string json = gltf.dump();
+        json.resize((json.size() + 3) & ~size_t(3), ' ');
+        bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+        uint32_t header[5] = {0x46546C67, 2, uint32_t(12 + 8 + json.size() + 8 + bin.size()), uint32_t(json.size()), 0x4E4F534A};
+        uint32_t binHeader[2] = {uint32_t(bin.size()), 0x004E4942};
+
+        std::ofstream outfile{path, std::ios::binary | std::ios::trunc};
+        outfile.write(reinterpret_cast<const char *>(header), sizeof(header));
+        outfile.write(json.data(), json.size());
+        outfile.write(reinterpret_cast<const char *>(binHeader), sizeof(binHeader));
+        outfile.write(reinterpret_cast<const char *>(bin.data()), bin.size());
+        return outfile.good();
+    }
+
+    nlohmann::json percentiles_json(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return {
+            {"min", values.empty() ? 0 : values.front()},
+            {"p50", percentile(values, 0.5)},
+            {"p90", percentile(values, 0.9)},
+            {"p99", percentile(values, 0.99)},
+            {"max", values.empty() ? 0 : values.back()}};
+    }
+}
+
+bool write_benchmark_corpus(const fs::path &directory)
+{
+    fs::create_directories(directory);
+    return write_textures(directory) && write_obj_sphere(directory / "sphere.obj") && write_glb_grid(directory / "grid.glb");
+}
+
+void BenchmarkReport::add_run(double wallSeconds, const std::map<std::string, BakeTypeStats> &stats)
+{
+    _runSeconds.push_back(wallSeconds);
+    for (auto &[name, type] : stats)
+    {
+        for (uint32_t s = 0; s < uint32_t(BakeStage::Count); s++)
+        {
+            if (type.stages[s].calls == 0)
+                continue;
+            _stageSeconds[s][name].push_back(type.stages[s].seconds);
+            _stageBytes[s][name] = type.stages[s].bytes;
+        }
+        auto &files = _fileSeconds[name];
+        files.insert(files.end(), type.fileSeconds.begin(), type.fileSeconds.end());
+    }
+}
+
+std::string BenchmarkReport::json(uint32_t threads) const
+{
+    nlohmann::json report;
+    report["threads"] = threads;
+    report["runs"] = _runSeconds.size();
+    report["wall_seconds"] = percentiles_json(_runSeconds);
+
+    nlohmann::json types = nlohmann::json::object();
+    for (auto &[name, files] : _fileSeconds)
+    {
+        nlohmann::json typeJson;
+        typeJson["file_seconds"] = percentiles_json(files);
+
+        nlohmann::json stages = nlohmann::json::object();
+        for (uint32_t s = 0; s < uint32_t(BakeStage::Count); s++)
+        {
+            auto seconds = _stageSeconds[s].find(name);
+            if (seconds == _stageSeconds[s].end())
+                continue;
+
+            nlohmann::json stage = percentiles_json(seconds->second);
+            uint64_t bytes = _stageBytes[s].at(name);
+            stage["bytes"] = bytes;
+            // throughput of the median run
+            double median = stage["p50"];
+            stage["mb_per_second"] = median > 0 ? double(bytes) / (1024.0 * 1024.0) / median : 0;
+            stages[bake_stage_name(BakeStage(s))] = std::move(stage);
+        }
+        typeJson["stages"] = std::move(stages);
+        types[name] = std::move(typeJson);
+    }
+    report["file_types"] = std::move(types);
+    return report.dump(4);
+}
+
+void BenchmarkReport::print() const
+{
+    std::vector<double> sorted = _runSeconds;
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << _runSeconds.size() << " runs, p50 " << percentile(sorted, 0.5) * 1000.0 << "ms, p90 " << percentile(sorted, 0.9) * 1000.0
+              << "ms, p99 " << percentile(sorted, 0.99) * 1000.0 << "ms" << std::endl;
+
+    for (uint32_t s = 0; s < uint32_t(BakeStage::Count); s++)
+    {
+        for (auto &[name, seconds] : _stageSeconds[s])
+        {
+            std::vector<double> stageSorted = seconds;
+            std::sort(stageSorted.begin(), stageSorted.end());
+            std::cout << "    " << name << " " << bake_stage_name(BakeStage(s)) << " p50 " << percentile(stageSorted, 0.5) * 1000.0
+                      << "ms, p90 " << percentile(stageSorted, 0.9) * 1000.0 << "ms" << std::endl;
+        }
+    }
+}
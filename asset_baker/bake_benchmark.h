@@ -0,0 +1,37 @@
+#pragma once
+#include "bake_profile.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// side of the square textures in the benchmark corpus
+constexpr uint32_t BENCHMARK_TEXTURE_SIZE = 1024;
+// the obj sphere has this many segments around and half as many rings, the glb grid this many quads per side
+constexpr uint32_t BENCHMARK_MESH_SEGMENTS = 256;
+
+// writes a synthetic asset folder that covers every path of the baker: opaque and transparent color, a normal map and a mask
+// as tga, an obj sphere, and a glb grid with a material using the textures. The contents are always the same, so
+// runs on different machines and commits bake the same work
+bool write_benchmark_corpus(const std::filesystem::path &directory);
+
+// collects the stats of every benchmark run, and reports percentiles over the runs
+class BenchmarkReport
+{
+public:
+    void add_run(double wallSeconds, const std::map<std::string, BakeTypeStats> &stats);
+
+    std::string json(uint32_t threads) const;
+    void print() const;
+
+private:
+    std::vector<double> _runSeconds;
+    // per file type, the seconds of each stage in every run
+    std::map<std::string, std::vector<double>> _stageSeconds[size_t(BakeStage::Count)];
+    // per file type, the bytes of each stage in one run, they are the same every run
+    std::map<std::string, uint64_t> _stageBytes[size_t(BakeStage::Count)];
+    // per file type, the wall time of every file of every run
+    std::map<std::string, std::vector<double>> _fileSeconds;
+};
@@ -0,0 +1,122 @@
+#include "bake_content.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+std::string content_name(uint64_t hash)
+{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+void ContentStore::init(const fs::path &exportFolder)
+{
+    _folder = exportFolder / CONTENT_FOLDER;
+    fs::create_directories(_folder);
+}
+
+void ContentStore::begin_bake()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _claimed.clear();
+    _released.clear();
+    _links.clear();
+    _sourcePayloads.clear();
+    _reused = 0;
+}
+
+fs::path ContentStore::payload_path(uint64_t hash, const char *extension) const
+{
+    return _folder / (content_name(hash) + extension);
+}
+
+bool ContentStore::claim(const fs::path &payload)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::error_code error;
+    if (!_claimed.insert(payload.generic_string()).second || fs::exists(payload, error))
+    {
+        _reused++;
+        return false;
+    }
+    return true;
+}
+
+void ContentStore::release(const fs::path &payload)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _claimed.erase(payload.generic_string());
+    _released.push_back(payload);
+}
+
+std::vector<fs::path> ContentStore::missing_payloads() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::vector<fs::path> missing;
+    for (const fs::path &payload : _released)
+    {
+        std::error_code error;
+        if (!fs::exists(payload, error) && std::find(missing.begin(), missing.end(), payload) == missing.end())
+        {
+            missing.push_back(payload);
+        }
+    }
+    return missing;
+}
+
+void ContentStore::link_output(const fs::path &output, const fs::path &payload)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _links.push_back({output, payload});
+}
+
+std::vector<fs::path> ContentStore::finish_links()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::vector<fs::path> failed;
+    for (auto &[output, payload] : _links)
+    {
+        std::error_code error;
+        if (fs::exists(output, error) && fs::equivalent(output, payload, error))
+            continue;
+
+        fs::remove(output, error);
+        fs::create_hard_link(payload, output, error);
+        if (error)
+        {
+            // other volume, or a file system without links
+            error.clear();
+            fs::copy_file(payload, output, fs::copy_options::overwrite_existing, error);
+        }
+        if (error)
+        {
+            std::cout << "could not link " << output << " to " << payload << ": " << error.message() << std::endl;
+            failed.push_back(output);
+        }
+    }
+    _links.clear();
+    return failed;
+}
+
+void ContentStore::set_source_payload(const fs::path &source, const fs::path &payload)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _sourcePayloads[source.lexically_normal().generic_string()] = payload;
+}
+
+fs::path ContentStore::source_payload(const fs::path &source) const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    auto payload = _sourcePayloads.find(source.lexically_normal().generic_string());
+    return payload != _sourcePayloads.end() ? payload->second : fs::path{};
+}
+
+uint32_t ContentStore::reused_count() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _reused;
+}
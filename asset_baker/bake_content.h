@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// folder in the export folder that unique payloads are stored in
+constexpr const char *CONTENT_FOLDER = "content";
+
+// the hash as 16 hex digits, the file name of a payload
+std::string content_name(uint64_t hash);
+
+// baked textures and meshes stored once, named by the hash of the decoded data and options they were baked from.
+// Sources and scenes that bake to the same thing share one payload, and materials and prefabs point at it.
+// Jobs use it concurrently
+class ContentStore
+{
+public:
+    void init(const std::filesystem::path &exportFolder);
+    // forgets the claims, releases, links and source payloads of the last bake
+    void begin_bake();
+
+    std::filesystem::path payload_path(uint64_t hash, const char *extension) const;
+    const std::filesystem::path &folder() const { return _folder; }
+
+    // true when the caller has to bake the payload, because it is not on disk from an earlier bake and no other job claimed it.
+    // Everyone else can point at the path right away, it exists once the jobs of the bake are done unless the claimant
+    // failed, which missing_payloads reports. Waiting for the claimant instead could deadlock, as a job waiting on its
+    // own jobs runs queued ones
+    bool claim(const std::filesystem::path &payload);
+    // a claimed payload that could not be baked, so the next claim tries again
+    void release(const std::filesystem::path &payload);
+    // released payloads that no later claim baked, sources that pointed at them did not bake either
+    std::vector<std::filesystem::path> missing_payloads() const;
+
+    // for assets that are also loaded by the path of their source, the output gets linked to the payload once the jobs are done
+    void link_output(const std::filesystem::path &output, const std::filesystem::path &payload);
+    // hard links every queued output to its payload, copying it where links are not supported. Returns the outputs that failed
+    std::vector<std::filesystem::path> finish_links();
+
+    // the payload a source image was baked to, so materials can point at it
+    void set_source_payload(const std::filesystem::path &source, const std::filesystem::path &payload);
+    // empty when the source was not baked
+    std::filesystem::path source_payload(const std::filesystem::path &source) const;
+
+    // payloads that were asked for this bake but already existed, so were not baked again
+    uint32_t reused_count() const;
+
+private:
+    std::filesystem::path _folder;
+    std::unordered_set<std::string> _claimed;
+    std::vector<std::filesystem::path> _released;
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> _links;
+    // by lexically normal generic source path
+    std::unordered_map<std::string, std::filesystem::path> _sourcePayloads;
+    uint32_t _reused{0};
+    mutable std::mutex _mutex;
+};
@@ -0,0 +1,378 @@
+#include "bake_gltf.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+    constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+    constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+    constexpr size_t GLB_HEADER_SIZE = 12;
+    constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+    // stands in for the binary chunk while tinygltf parses the json, it refuses an empty data uri
+    const char *PLACEHOLDER_BUFFER_URI = "data:application/octet-stream;base64,AA==";
+
+    uint32_t read_u32(const char *data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    bool load_glb(const fs::path &path, GltfSource &source, std::string &error, std::string &warning)
+    {
+        if (!assets::map_file(path.string().c_str(), source.mapping))
+        {
+            error = "could not map " + path.string();
+            return false;
+        }
+
+        GlbChunks chunks;
+        if (!parse_glb(source.mapping.data, source.mapping.size, chunks, error))
+        {
+            return false;
+        }
+
+        nlohmann::json gltf = nlohmann::json::parse(chunks.json.begin(), chunks.json.end(), nullptr, false);
+        if (gltf.is_discarded() || !gltf.is_object())
+        {
+            error = "the json chunk of " + path.string() + " is not valid json";
+            return false;
+        }
+
+        // tinygltf would copy the whole binary chunk into buffer 0 and decode every image. The buffer is swapped for a
+        // one byte placeholder and the images are taken out, then put back once the rest of the model is parsed
+        nlohmann::json images = gltf.value("images", nlohmann::json::array());
+        gltf.erase("images");
+
+        size_t binaryLength = 0;
+        bool usesBinaryChunk = false;
+        auto buffers = gltf.find("buffers");
+        if (buffers != gltf.end() && buffers->is_array() && !buffers->empty() && !(*buffers)[0].contains("uri"))
+        {
+            binaryLength = (*buffers)[0].value("byteLength", size_t(0));
+            if (chunks.bin == nullptr || binaryLength > chunks.binSize)
+            {
+                error = "buffer 0 of " + path.string() + " is bigger than its binary chunk";
+                return false;
+            }
+            (*buffers)[0]["uri"] = PLACEHOLDER_BUFFER_URI;
+            (*buffers)[0]["byteLength"] = 1;
+            usesBinaryChunk = true;
+        }
+
+        std::string json = gltf.dump();
+
+        tinygltf::TinyGLTF loader;
+        if (!loader.LoadASCIIFromString(&source.model, &error, &warning, json.c_str(), static_cast<unsigned int>(json.size()),
+                                        path.parent_path().string()))
+        {
+            return false;
+        }
+
+        for (auto &image : images)
+        {
+            tinygltf::Image newImage;
+            newImage.name = image.value("name", "");
+            newImage.uri = image.value("uri", "");
+            newImage.mimeType = image.value("mimeType", "");
+            newImage.bufferView = image.value("bufferView", -1);
+            source.model.images.push_back(std::move(newImage));
+        }
+
+        for (size_t i = 0; i < source.model.buffers.size(); i++)
+        {
+            auto &buffer = source.model.buffers[i];
+            if (i == 0 && usesBinaryChunk)
+            {
+                buffer.uri.clear();
+                buffer.data.clear();
+                source.buffers.push_back({chunks.bin, binaryLength});
+            }
+            else
+            {
+                source.buffers.push_back({buffer.data.data(), buffer.data.size()});
+            }
+        }
+        return true;
+    }
+
+    bool skip_image(tinygltf::Image *, const int, std::string *, std::string *, int, int, const unsigned char *, int, void *)
+    {
+        return true;
+    }
+
+    template <typename T>
+    float normalize_component(T value)
+    {
+        // the glTF rules, signed values clamp so both -128 and -127 map to -1
+        float v = float(value) / float(std::numeric_limits<T>::max());
+        return std::max(v, -1.f);
+    }
+
+    template <typename T>
+    void gather_converted(const GltfAccessorView &view, int components, float *dst, size_t dstStride)
+    {
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+        for (size_t i = 0; i < view.count; i++)
+        {
+            T element[4];
+            memcpy(element, view.data + i * view.stride, components * sizeof(T));
+
+            float converted[4];
+            for (int c = 0; c < components; c++)
+            {
+                converted[c] = view.normalized ? normalize_component(element[c]) : float(element[c]);
+            }
+            memcpy(out + i * dstStride, converted, components * sizeof(float));
+        }
+    }
+
+    // a fixed size copy per element, the compiler turns it into one or two vector loads and stores
+    template <int N>
+    void gather_float_elements(const GltfAccessorView &view, float *dst, size_t dstStride)
+    {
+        constexpr size_t elementSize = N * sizeof(float);
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+        if (view.stride == elementSize && dstStride == elementSize)
+        {
+            memcpy(out, view.data, view.count * elementSize);
+            return;
+        }
+        for (size_t i = 0; i < view.count; i++)
+        {
+            memcpy(out + i * dstStride, view.data + i * view.stride, elementSize);
+        }
+    }
+
+    template <typename T>
+    void widen_indices(const GltfAccessorView &view, uint32_t *dst)
+    {
+        if (sizeof(T) == sizeof(uint32_t) && view.stride == sizeof(T))
+        {
+            memcpy(dst, view.data, view.count * sizeof(T));
+            return;
+        }
+        for (size_t i = 0; i < view.count; i++)
+        {
+            T index;
+            memcpy(&index, view.data + i * view.stride, sizeof(T));
+            dst[i] = index;
+        }
+    }
+}
+
+GltfSource::~GltfSource()
+{
+    assets::unmap_file(mapping);
+}
+
+bool parse_glb(const char *data, size_t size, GlbChunks &chunks, std::string &error)
+{
+    if (size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE || read_u32(data) != GLB_MAGIC)
+    {
+        error = "not a binary gltf";
+        return false;
+    }
+    if (read_u32(data + 4) != 2)
+    {
+        error = "only version 2 binary gltf is supported";
+        return false;
+    }
+    size_t length = read_u32(data + 8);
+    if (length > size)
+    {
+        error = "binary gltf is truncated";
+        return false;
+    }
+
+    chunks = {};
+    size_t offset = GLB_HEADER_SIZE;
+    bool first = true;
+    while (offset + GLB_CHUNK_HEADER_SIZE <= length)
+    {
+        size_t chunkLength = read_u32(data + offset);
+        uint32_t chunkType = read_u32(data + offset + 4);
+        offset += GLB_CHUNK_HEADER_SIZE;
+        if (chunkLength > length - offset)
+        {
+            error = "binary gltf chunk goes past the end of the file";
+            return false;
+        }
+
+        // the json always comes first, the binary chunk second, and unknown chunks are skipped
+        if (first && chunkType != GLB_CHUNK_JSON)
+        {
+            error = "binary gltf does not start with a json chunk";
+            return false;
+        }
+        if (chunkType == GLB_CHUNK_JSON && first)
+        {
+            chunks.json = std::string_view{data + offset, chunkLength};
+        }
+        else if (chunkType == GLB_CHUNK_BIN && chunks.bin == nullptr)
+        {
+            chunks.bin = reinterpret_cast<const uint8_t *>(data + offset);
+            chunks.binSize = chunkLength;
+        }
+        first = false;
+
+        // chunks are padded to 4 bytes
+        offset += (chunkLength + 3) & ~size_t(3);
+    }
+
+    if (first)
+    {
+        error = "binary gltf has no json chunk";
+        return false;
+    }
+    return true;
+}
+
+bool load_gltf(const fs::path &path, GltfSource &source, std::string &error, std::string &warning)
+{
+    if (path.extension() == ".glb")
+    {
+        return load_glb(path, source, error, warning);
+    }
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(skip_image, nullptr);
+    if (!loader.LoadASCIIFromFile(&source.model, &error, &warning, path.string()))
+    {
+        return false;
+    }
+    for (auto &buffer : source.model.buffers)
+    {
+        source.buffers.push_back({buffer.data.data(), buffer.data.size()});
+    }
+    return true;
+}
+
+bool gltf_accessor_view(const GltfSource &source, int accessor, GltfAccessorView &view)
+{
+    auto &model = source.model;
+    if (accessor < 0 || accessor >= int(model.accessors.size()))
+    {
+        return false;
+    }
+    auto &acc = model.accessors[accessor];
+    if (acc.bufferView < 0 || acc.bufferView >= int(model.bufferViews.size()))
+    {
+        return false;
+    }
+    auto &bufferView = model.bufferViews[acc.bufferView];
+    if (bufferView.buffer < 0 || bufferView.buffer >= int(source.buffers.size()))
+    {
+        return false;
+    }
+    const GltfBuffer &buffer = source.buffers[bufferView.buffer];
+
+    view.count = acc.count;
+    view.componentType = acc.componentType;
+    view.components = tinygltf::GetNumComponentsInType(acc.type);
+    view.normalized = acc.normalized;
+    int componentSize = tinygltf::GetComponentSizeInBytes(acc.componentType);
+    if (view.components <= 0 || componentSize <= 0)
+    {
+        return false;
+    }
+    size_t elementSize = size_t(view.components) * componentSize;
+    view.stride = bufferView.byteStride != 0 ? bufferView.byteStride : elementSize;
+
+    // the view has to fit in its buffer, and every element in the view. Offsets, counts and strides all come from the file,
+    // so nothing is added or multiplied before it is known not to wrap
+    if (bufferView.byteOffset > buffer.size || bufferView.byteLength > buffer.size - bufferView.byteOffset)
+    {
+        return false;
+    }
+    if (view.count > 0)
+    {
+        if (acc.byteOffset > bufferView.byteLength || elementSize > bufferView.byteLength - acc.byteOffset)
+        {
+            return false;
+        }
+        if (view.count - 1 > (bufferView.byteLength - acc.byteOffset - elementSize) / view.stride)
+        {
+            return false;
+        }
+    }
+
+    view.data = buffer.data + bufferView.byteOffset + acc.byteOffset;
+    return true;
+}
+
+bool gather_floats(const GltfAccessorView &view, int components, float *dst, size_t dstStride)
+{
+    if (view.components != components || components > 4)
+    {
+        return false;
+    }
+
+    switch (view.componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        switch (components)
+        {
+        case 1:
+            gather_float_elements<1>(view, dst, dstStride);
+            break;
+        case 2:
+            gather_float_elements<2>(view, dst, dstStride);
+            break;
+        case 3:
+            gather_float_elements<3>(view, dst, dstStride);
+            break;
+        default:
+            gather_float_elements<4>(view, dst, dstStride);
+            break;
+        }
+        return true;
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        gather_converted<int8_t>(view, components, dst, dstStride);
+        return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        gather_converted<uint8_t>(view, components, dst, dstStride);
+        return true;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        gather_converted<int16_t>(view, components, dst, dstStride);
+        return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        gather_converted<uint16_t>(view, components, dst, dstStride);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool gather_indices(const GltfAccessorView &view, uint32_t *dst)
+{
+    if (view.components != 1)
+    {
+        return false;
+    }
+
+    switch (view.componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        widen_indices<uint8_t>(view, dst);
+        return true;
+    // signed shorts are not valid indices, but older exporters write them
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        widen_indices<uint16_t>(view, dst);
+        return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        widen_indices<uint32_t>(view, dst);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <asset_loader.h>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// the chunks of a binary gltf, pointing into its bytes
+struct GlbChunks
+{
+    std::string_view json;
+    // the BIN chunk, nullptr when the file has none
+    const uint8_t *bin{nullptr};
+    size_t binSize{0};
+};
+
+// checks the glb header and finds the json and binary chunks, nothing is copied
+bool parse_glb(const char *data, size_t size, GlbChunks &chunks, std::string &error);
+
+// bytes of one gltf buffer
+struct GltfBuffer
+{
+    const uint8_t *data{nullptr};
+    size_t size{0};
+};
+
+// a .gltf or .glb loaded for baking. The buffers of a .gltf are the ones tinygltf loaded, but the binary chunk
+// of a .glb is never copied, it is read straight from the mapped file for as long as the source lives
+struct GltfSource
+{
+    GltfSource() = default;
+    ~GltfSource();
+    GltfSource(const GltfSource &) = delete;
+    GltfSource &operator=(const GltfSource &) = delete;
+
+    tinygltf::Model model;
+    // one per model buffer, use these instead of the data of the model buffers
+    std::vector<GltfBuffer> buffers;
+    // only mapped for a .glb
+    assets::FileMapping mapping;
+};
+
+// picks ascii or binary loading from the extension. Images are never decoded, the baker converts them as their own files.
+// images embedded in a glb buffer view are kept in the model, but they have no uri to bake from
+bool load_gltf(const std::filesystem::path &path, GltfSource &source, std::string &error, std::string &warning);
+
+// the elements of an accessor where they sit in their buffer
+struct GltfAccessorView
+{
+    const uint8_t *data{nullptr};
+    size_t count{0};
+    // bytes from one element to the next, the element size when the buffer view is tightly packed
+    size_t stride{0};
+    int componentType{0};
+    int components{0};
+    bool normalized{false};
+};
+
+// false when the accessor has no buffer view, like sparse only ones, or its elements go past the end of the view or buffer
+bool gltf_accessor_view(const GltfSource &source, int accessor, GltfAccessorView &view);
+
+// writes every element as floats to dst, dstStride bytes apart, in a single pass over the buffer. Float elements are
+// copied as they are, integer ones are converted and normalized when the accessor says so.
+// returns false when the element does not have that many components
+bool gather_floats(const GltfAccessorView &view, int components, float *dst, size_t dstStride);
+
+// widens 8, 16 and 32 bit indices to dst, which holds view.count indices
+bool gather_indices(const GltfAccessorView &view, uint32_t *dst);
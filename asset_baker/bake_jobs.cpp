@@ -0,0 +1,103 @@
+#include "bake_jobs.h"
+
+#include <algorithm>
+
+JobPool::~JobPool()
+{
+    shutdown();
+}
+
+void JobPool::init(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    _stopping = false;
+    // the thread that waits is the last one
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        _workers.emplace_back([this]()
+                              { worker_loop(); });
+    }
+}
+
+void JobPool::shutdown()
+{
+    if (_workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stopping = true;
+    }
+    _changed.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+    _workers.clear();
+}
+
+void JobPool::run(Group &group, std::function<void()> job)
+{
+    group.pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _queue.push_back({&group, std::move(job)});
+    }
+    _changed.notify_all();
+}
+
+void JobPool::wait(Group &group)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (group.pending.load() != 0)
+    {
+        if (_queue.empty())
+        {
+            _changed.wait(lock, [&]()
+                          { return group.pending.load() == 0 || !_queue.empty(); });
+            continue;
+        }
+
+        // newest first, the jobs this thread just queued are the likeliest to be the ones it waits for
+        Job job = std::move(_queue.back());
+        _queue.pop_back();
+        lock.unlock();
+        execute(job);
+        lock.lock();
+    }
+}
+
+void JobPool::worker_loop()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (true)
+    {
+        _changed.wait(lock, [this]()
+                      { return _stopping || !_queue.empty(); });
+        if (_stopping)
+            return;
+
+        // oldest first, so the files are started in the order they were found
+        Job job = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+        execute(job);
+        lock.lock();
+    }
+}
+
+void JobPool::execute(Job &job)
+{
+    job.function();
+    {
+        // under the lock, so a waiter cannot miss the notification between checking and sleeping
+        std::lock_guard<std::mutex> lock{_mutex};
+        job.group->pending.fetch_sub(1);
+    }
+    _changed.notify_all();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// thread pool for the baker. Jobs can queue more jobs and wait for them, like a gltf file baking its meshes.
+// a thread that waits runs queued jobs in the meantime, so nested waits never run out of threads
+class JobPool
+{
+public:
+    // jobs that get waited on together
+    struct Group
+    {
+        std::atomic<uint32_t> pending{0};
+    };
+
+    JobPool() = default;
+    ~JobPool();
+    JobPool(const JobPool &) = delete;
+    JobPool &operator=(const JobPool &) = delete;
+
+    // 0 threads uses every core. With 1 there are no workers, every job runs on the thread that waits for it
+    void init(uint32_t threadCount = 0);
+    // joins the workers, safe to call more than once
+    void shutdown();
+
+    void run(Group &group, std::function<void()> job);
+    void wait(Group &group);
+
+    uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()) + 1; }
+
+private:
+    struct Job
+    {
+        Group *group;
+        std::function<void()> function;
+    };
+
+    void worker_loop();
+    void execute(Job &job);
+
+    std::vector<std::thread> _workers;
+    std::deque<Job> _queue;
+    std::mutex _mutex;
+    // signaled when a job is queued, or one finishes
+    std::condition_variable _changed;
+    bool _stopping{false};
+};
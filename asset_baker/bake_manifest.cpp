@@ -0,0 +1,416 @@
+#include "bake_manifest.h"
+
+#include <json.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+
+namespace fs = std::filesystem;
+
+static uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+void ContentHasher::mix_word(uint64_t word)
+{
+    _hash = (_hash ^ mix64(word)) * 0x9E3779B97F4A7C15ull;
+    _hash = (_hash << 27) | (_hash >> 37);
+}
+
+void ContentHasher::update(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    _size += size;
+
+    // finish the word started by the last update
+    while (_tailSize > 0 && _tailSize < 8 && size > 0)
+    {
+        _tail[_tailSize++] = *bytes++;
+        size--;
+    }
+    if (_tailSize == 8)
+    {
+        uint64_t word;
+        memcpy(&word, _tail, 8);
+        mix_word(word);
+        _tailSize = 0;
+    }
+
+    while (size >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        mix_word(word);
+        bytes += 8;
+        size -= 8;
+    }
+
+    memcpy(_tail + _tailSize, bytes, size);
+    _tailSize += static_cast<uint32_t>(size);
+}
+
+uint64_t ContentHasher::finish()
+{
+    uint64_t word = 0;
+    memcpy(&word, _tail, _tailSize);
+    mix_word(word ^ _size);
+    return mix64(_hash);
+}
+
+uint64_t hash_content(const void *data, size_t size)
+{
+    ContentHasher hasher;
+    hasher.update(data, size);
+    return hasher.finish();
+}
+
+uint64_t hash_file(const fs::path &path)
+{
+    std::ifstream file;
+    file.open(path, std::ios::binary);
+    if (!file.is_open())
+        return 0;
+
+    ContentHasher hasher;
+    std::vector<char> buffer(1024 * 1024);
+    while (file)
+    {
+        file.read(buffer.data(), buffer.size());
+        hasher.update(buffer.data(), static_cast<size_t>(file.gcount()));
+    }
+    return hasher.finish();
+}
+
+void BakeManifest::init(const fs::path &assetFolder, const fs::path &exportFolder)
+{
+    _assetFolder = assetFolder;
+    _exportFolder = exportFolder;
+}
+
+fs::path BakeManifest::manifest_path() const
+{
+    return _exportFolder / "bake_manifest.json";
+}
+
+std::string BakeManifest::source_key(const fs::path &source) const
+{
+    return source.lexically_proximate(_assetFolder).generic_string();
+}
+
+// size and write time of a file, both 0 when it cant be read
+static void stat_file(const fs::path &path, uint64_t &size, int64_t &time)
+{
+    std::error_code error;
+    size = fs::file_size(path, error);
+    if (error)
+        size = 0;
+    auto writeTime = fs::last_write_time(path, error);
+    time = error ? 0 : writeTime.time_since_epoch().count();
+}
+
+template <typename T>
+static bool read_integer(const nlohmann::json &object, const char *key, T &value)
+{
+    auto it = object.find(key);
+    if (it == object.end() || !it->is_number_integer())
+        return false;
+    value = it->get<T>();
+    return true;
+}
+
+// returns false when a field is missing or has the wrong type, the manifest is only a cache and such entries are skipped
+static bool read_entry(const nlohmann::json &value, ManifestEntry &entry)
+{
+    if (!value.is_object())
+        return false;
+    if (!read_integer(value, "hash", entry.sourceHash) || !read_integer(value, "size", entry.sourceSize) ||
+        !read_integer(value, "time", entry.sourceTime) || !read_integer(value, "options", entry.optionsHash) ||
+        !read_integer(value, "baker_version", entry.bakerVersion))
+        return false;
+
+    auto outputs = value.find("outputs");
+    if (outputs == value.end() || !outputs->is_array())
+        return false;
+    for (auto &output : *outputs)
+    {
+        if (!output.is_string())
+            return false;
+        entry.outputs.push_back(output.get<std::string>());
+    }
+
+    auto dependencies = value.find("dependencies");
+    if (dependencies == value.end() || !dependencies->is_object())
+        return false;
+    for (auto &[path, recorded] : dependencies->items())
+    {
+        ManifestDependency dependency;
+        dependency.path = path;
+        // older manifests only stored the hash, those dependencies get hashed once more
+        if (recorded.is_number_integer())
+        {
+            dependency.hash = recorded.get<uint64_t>();
+        }
+        else if (!recorded.is_object() || !read_integer(recorded, "hash", dependency.hash) ||
+                 !read_integer(recorded, "size", dependency.size) || !read_integer(recorded, "time", dependency.time))
+        {
+            return false;
+        }
+        entry.dependencies.push_back(std::move(dependency));
+    }
+    return true;
+}
+
+bool BakeManifest::load()
+{
+    std::ifstream file;
+    file.open(manifest_path());
+    if (!file.is_open())
+        return false;
+
+    nlohmann::json manifest = nlohmann::json::parse(file, nullptr, false);
+    auto sources = manifest.is_object() ? manifest.find("sources") : manifest.end();
+    if (manifest.is_discarded() || sources == manifest.end() || !sources->is_object())
+    {
+        std::cout << "Ignoring unreadable bake manifest " << manifest_path() << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{_mutex};
+    _entries.clear();
+    for (auto &[key, value] : sources->items())
+    {
+        ManifestEntry entry;
+        if (!read_entry(value, entry))
+        {
+            std::cout << "Ignoring malformed bake manifest entry " << key << std::endl;
+            continue;
+        }
+        _entries[key] = std::move(entry);
+    }
+    return true;
+}
+
+bool BakeManifest::save()
+{
+    nlohmann::json sources = nlohmann::json::object();
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        for (auto &[key, entry] : _entries)
+        {
+            nlohmann::json dependencies = nlohmann::json::object();
+            for (const ManifestDependency &dependency : entry.dependencies)
+            {
+                dependencies[dependency.path] = {
+                    {"hash", dependency.hash},
+                    {"size", dependency.size},
+                    {"time", dependency.time}};
+            }
+
+            sources[key] = {
+                {"hash", entry.sourceHash},
+                {"size", entry.sourceSize},
+                {"time", entry.sourceTime},
+                {"options", entry.optionsHash},
+                {"baker_version", entry.bakerVersion},
+                {"outputs", entry.outputs},
+                {"dependencies", dependencies}};
+        }
+    }
+
+    nlohmann::json manifest;
+    manifest["sources"] = sources;
+
+    // written to the side and renamed, so an interrupted save leaves the old manifest
+    fs::path temporary = manifest_path();
+    temporary += ".tmp";
+    {
+        std::ofstream file;
+        file.open(temporary);
+        if (!file.is_open())
+        {
+            std::cout << "Failed to write bake manifest " << temporary << std::endl;
+            return false;
+        }
+        file << manifest.dump(1);
+    }
+    std::error_code error;
+    fs::rename(temporary, manifest_path(), error);
+    return !error;
+}
+
+bool BakeManifest::is_up_to_date(const fs::path &source, uint64_t optionsHash, ManifestEntry &current)
+{
+    std::error_code error;
+    current = {};
+    stat_file(source, current.sourceSize, current.sourceTime);
+    current.optionsHash = optionsHash;
+    current.bakerVersion = BAKER_VERSION;
+
+    ManifestEntry recorded;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        auto it = _entries.find(source_key(source));
+        if (it != _entries.end())
+        {
+            recorded = it->second;
+            found = true;
+        }
+    }
+
+    // touching a file without changing it only costs a hash
+    if (found && recorded.sourceSize == current.sourceSize && recorded.sourceTime == current.sourceTime)
+    {
+        current.sourceHash = recorded.sourceHash;
+    }
+    else
+    {
+        current.sourceHash = hash_file(source);
+    }
+
+    if (!found || recorded.sourceHash != current.sourceHash || recorded.optionsHash != optionsHash || recorded.bakerVersion != BAKER_VERSION)
+        return false;
+
+    for (const std::string &output : recorded.outputs)
+    {
+        if (!fs::exists(_exportFolder / output, error))
+            return false;
+    }
+    for (const ManifestDependency &dependency : recorded.dependencies)
+    {
+        uint64_t size;
+        int64_t time;
+        stat_file(_assetFolder / dependency.path, size, time);
+        if (dependency.time != 0 && size == dependency.size && time == dependency.time)
+            continue;
+        if (hash_file(_assetFolder / dependency.path) != dependency.hash)
+            return false;
+    }
+    return true;
+}
+
+void BakeManifest::record(const fs::path &source, ManifestEntry current, const std::vector<fs::path> &outputs,
+                          const std::vector<fs::path> &dependencies)
+{
+    for (const fs::path &output : outputs)
+    {
+        current.outputs.push_back(output.lexically_proximate(_exportFolder).generic_string());
+    }
+    for (const fs::path &dependency : dependencies)
+    {
+        ManifestDependency recorded;
+        recorded.path = dependency.lexically_proximate(_assetFolder).generic_string();
+        recorded.hash = hash_file(dependency);
+        stat_file(dependency, recorded.size, recorded.time);
+        current.dependencies.push_back(std::move(recorded));
+    }
+
+    std::lock_guard<std::mutex> lock{_mutex};
+    _entries[source_key(source)] = std::move(current);
+}
+
+void BakeManifest::forget(const fs::path &source)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _entries.erase(source_key(source));
+}
+
+uint32_t BakeManifest::forget_output(const fs::path &output)
+{
+    std::string key = output.lexically_proximate(_exportFolder).generic_string();
+    std::lock_guard<std::mutex> lock{_mutex};
+    uint32_t forgotten = 0;
+    for (auto it = _entries.begin(); it != _entries.end();)
+    {
+        if (std::find(it->second.outputs.begin(), it->second.outputs.end(), key) == it->second.outputs.end())
+        {
+            ++it;
+            continue;
+        }
+
+        std::cout << "Source " << it->first << " did not bake, " << key << " is missing" << std::endl;
+        it = _entries.erase(it);
+        forgotten++;
+    }
+    return forgotten;
+}
+
+std::vector<fs::path> BakeManifest::recorded_outputs(const fs::path &source)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::vector<fs::path> outputs;
+    auto entry = _entries.find(source_key(source));
+    if (entry != _entries.end())
+    {
+        for (const std::string &output : entry->second.outputs)
+        {
+            outputs.push_back(_exportFolder / output);
+        }
+    }
+    return outputs;
+}
+
+void BakeManifest::remove_missing_sources()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::error_code error;
+    std::vector<std::string> removedOutputs;
+    for (auto it = _entries.begin(); it != _entries.end();)
+    {
+        if (fs::exists(_assetFolder / it->first, error))
+        {
+            ++it;
+            continue;
+        }
+
+        std::cout << "Source " << it->first << " is gone, removing what was baked from it" << std::endl;
+        removedOutputs.insert(removedOutputs.end(), it->second.outputs.begin(), it->second.outputs.end());
+        it = _entries.erase(it);
+    }
+
+    // payloads are shared between sources, they stay as long as anything still uses them
+    std::set<std::string> usedOutputs;
+    for (auto &[source, entry] : _entries)
+    {
+        usedOutputs.insert(entry.outputs.begin(), entry.outputs.end());
+    }
+    for (const std::string &output : removedOutputs)
+    {
+        if (usedOutputs.count(output) == 0)
+        {
+            fs::remove_all(_exportFolder / output, error);
+        }
+    }
+}
+
+void BakeManifest::remove_unreferenced(const fs::path &folder)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::set<std::string> usedOutputs;
+    for (auto &[source, entry] : _entries)
+    {
+        usedOutputs.insert(entry.outputs.begin(), entry.outputs.end());
+    }
+
+    std::error_code error;
+    std::vector<fs::path> unreferenced;
+    for (auto &p : fs::directory_iterator(folder, error))
+    {
+        if (usedOutputs.count(p.path().lexically_proximate(_exportFolder).generic_string()) == 0)
+        {
+            unreferenced.push_back(p.path());
+        }
+    }
+    for (auto &path : unreferenced)
+    {
+        fs::remove_all(path, error);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// bump whenever a change to the baker changes what it writes, so everything gets rebaked
+constexpr uint32_t BAKER_VERSION = 6;
+
+// 64 bit hash of a stream of bytes, the same whatever size the pieces are fed in
+class ContentHasher
+{
+public:
+    void update(const void *data, size_t size);
+    uint64_t finish();
+
+private:
+    void mix_word(uint64_t word);
+
+    uint64_t _hash{0x9E3779B97F4A7C15ull};
+    uint64_t _size{0};
+    // bytes that did not make a full word yet
+    unsigned char _tail[8];
+    uint32_t _tailSize{0};
+};
+
+uint64_t hash_content(const void *data, size_t size);
+// 0 when the file can not be read
+uint64_t hash_file(const std::filesystem::path &path);
+
+// a file the outputs were built from besides the source, like the buffers and images of a gltf
+struct ManifestDependency
+{
+    std::string path;
+    uint64_t hash{0};
+    // like for the source, the hash is only checked again when these changed
+    uint64_t size{0};
+    int64_t time{0};
+};
+
+// what a source file was baked from and into. Paths are generic and relative, sources and dependencies
+// to the asset folder, outputs to the export folder
+struct ManifestEntry
+{
+    uint64_t sourceHash{0};
+    // when the size and write time still match, the hash is trusted without reading the file again
+    uint64_t sourceSize{0};
+    int64_t sourceTime{0};
+    // hash of the options that change the output for this kind of file
+    uint64_t optionsHash{0};
+    uint32_t bakerVersion{0};
+    std::vector<std::string> outputs;
+    std::vector<ManifestDependency> dependencies;
+};
+
+// record of the last bake, stored next to the outputs. Jobs check and record their files concurrently
+class BakeManifest
+{
+public:
+    void init(const std::filesystem::path &assetFolder, const std::filesystem::path &exportFolder);
+    // a missing or unreadable manifest just means everything gets baked, malformed entries are skipped. Never throws
+    bool load();
+    bool save();
+
+    // fills current with the state of the source right now, and returns true if the recorded bake of it is still valid:
+    // same content, options and baker version, every output still there and every dependency unchanged
+    bool is_up_to_date(const std::filesystem::path &source, uint64_t optionsHash, ManifestEntry &current);
+    // stores a finished bake. current comes from is_up_to_date, outputs and dependencies are absolute paths
+    void record(const std::filesystem::path &source, ManifestEntry current, const std::vector<std::filesystem::path> &outputs,
+                const std::vector<std::filesystem::path> &dependencies);
+    // a failed bake must not be skipped next time
+    void forget(const std::filesystem::path &source);
+    // forgets every source whose recorded bake wrote the output, for outputs that turned out missing once the jobs were done.
+    // Returns how many were forgotten
+    uint32_t forget_output(const std::filesystem::path &output);
+    // absolute paths of what the last bake of the source wrote, empty if it has no entry
+    std::vector<std::filesystem::path> recorded_outputs(const std::filesystem::path &source);
+
+    // drops the entries of sources that are gone, and deletes their outputs unless another entry shares them
+    void remove_missing_sources();
+    // deletes every file in the folder that no entry lists as an output, like payloads nothing points at anymore
+    void remove_unreferenced(const std::filesystem::path &folder);
+
+    std::filesystem::path manifest_path() const;
+
+private:
+    std::string source_key(const std::filesystem::path &source) const;
+
+    std::filesystem::path _assetFolder;
+    std::filesystem::path _exportFolder;
+    std::map<std::string, ManifestEntry> _entries;
+    std::mutex _mutex;
+};
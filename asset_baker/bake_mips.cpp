@@ -0,0 +1,333 @@
+#include "bake_mips.h"
+#include "bake_jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// a pixel is 4 floats, one sse register. The vertical pass works on whole rows, a register at a time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPS_SSE 1
+#include <emmintrin.h>
+#else
+#define MIPS_SSE 0
+#endif
+
+// half width of the kaiser window in destination pixels, and its shape. Same defaults as nvtt
+constexpr float KAISER_WIDTH = 1.5f;
+constexpr float KAISER_ALPHA = 4.0f;
+// most source pixels a destination pixel is filtered from along one axis. A level is at most 3 times smaller than
+// the one above it, for 3 pixels going to 1, which makes the kaiser window 10 pixels wide
+constexpr uint32_t MAX_FILTER_TAPS = 12;
+
+MipFilter parse_mip_filter(const char *f)
+{
+    if (strcmp(f, "box") == 0)
+    {
+        return MipFilter::Box;
+    }
+    else if (strcmp(f, "kaiser") == 0)
+    {
+        return MipFilter::Kaiser;
+    }
+    else
+    {
+        return MipFilter::Unknown;
+    }
+}
+
+const char *mip_filter_name(MipFilter filter)
+{
+    switch (filter)
+    {
+    case MipFilter::Box:
+        return "box";
+    case MipFilter::Kaiser:
+        return "kaiser";
+    default:
+        return "unknown";
+    }
+}
+
+static float srgb_to_linear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+MipImage load_mip_image(const uint8_t *rgba, uint32_t width, uint32_t height, bool srgb, bool premultiply)
+{
+    float toFloat[256];
+    float colorToFloat[256];
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        toFloat[i] = i / 255.f;
+        colorToFloat[i] = srgb ? srgb_to_linear(toFloat[i]) : toFloat[i];
+    }
+
+    MipImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+    for (size_t i = 0; i < size_t(width) * height; i++)
+    {
+        float alpha = premultiply ? toFloat[rgba[i * 4 + 3]] : 1.f;
+        image.pixels[i * 4 + 0] = colorToFloat[rgba[i * 4 + 0]] * alpha;
+        image.pixels[i * 4 + 1] = colorToFloat[rgba[i * 4 + 1]] * alpha;
+        image.pixels[i * 4 + 2] = colorToFloat[rgba[i * 4 + 2]] * alpha;
+        image.pixels[i * 4 + 3] = toFloat[rgba[i * 4 + 3]];
+    }
+    return image;
+}
+
+uint32_t mip_level_count(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        levels++;
+    }
+    return levels;
+}
+
+static float bessel_i0(float x)
+{
+    float sum = 1.f;
+    float term = 1.f;
+    for (int k = 1; k < 20; k++)
+    {
+        float factor = x / (2.f * k);
+        term *= factor * factor;
+        sum += term;
+    }
+    return sum;
+}
+
+static float kaiser_weight(float t)
+{
+    const float pi = 3.14159265358979f;
+    if (std::abs(t) >= KAISER_WIDTH)
+        return 0.f;
+
+    float sinc = t == 0.f ? 1.f : std::sin(pi * t) / (pi * t);
+    float ratio = t / KAISER_WIDTH;
+    float window = bessel_i0(KAISER_ALPHA * std::sqrt(1.f - ratio * ratio)) / bessel_i0(KAISER_ALPHA);
+    return sinc * window;
+}
+
+static inline uint32_t clamp_index(int64_t i, uint32_t size)
+{
+    return static_cast<uint32_t>(std::clamp<int64_t>(i, 0, int64_t(size) - 1));
+}
+
+// the source pixels every destination pixel is filtered from, along one axis
+struct AxisFilter
+{
+    uint32_t taps;
+    // first source pixel of every destination pixel. Can be out of range, reads are clamped to the edge
+    std::vector<int64_t> first;
+    // taps weights per destination pixel, they add up to 1
+    std::vector<float> weights;
+};
+
+// destination pixel x covers the source from x * scale to (x + 1) * scale. An even size halves with a scale of 2,
+// an odd one gets a scale a bit above 2, so the footprints slide over the source instead of dropping its last pixel
+static AxisFilter build_axis_filter(MipFilter filter, uint32_t sourceSize, uint32_t destinationSize)
+{
+    float scale = float(sourceSize) / destinationSize;
+    // in source pixels, the box reaches the edges of its footprint and the kaiser window KAISER_WIDTH destination pixels
+    float radius = filter == MipFilter::Box ? scale * 0.5f : scale * KAISER_WIDTH;
+
+    AxisFilter axis;
+    axis.taps = std::min(static_cast<uint32_t>(std::ceil(radius * 2.f)) + 1, MAX_FILTER_TAPS);
+    axis.first.resize(destinationSize);
+    axis.weights.resize(size_t(destinationSize) * axis.taps);
+    for (uint32_t x = 0; x < destinationSize; x++)
+    {
+        float center = (x + 0.5f) * scale;
+        // the first pixel the footprint touches, or the first one whose center is inside the window
+        float start = filter == MipFilter::Box ? std::floor(center - radius) : std::ceil(center - radius - 0.5f);
+        int64_t first = static_cast<int64_t>(start);
+        axis.first[x] = first;
+
+        float *weights = axis.weights.data() + size_t(x) * axis.taps;
+        float total = 0;
+        for (uint32_t k = 0; k < axis.taps; k++)
+        {
+            float pixelCenter = float(first + k) + 0.5f;
+            if (filter == MipFilter::Box)
+            {
+                // how much of the source pixel is inside the footprint
+                float overlap = std::min(pixelCenter + 0.5f, center + radius) - std::max(pixelCenter - 0.5f, center - radius);
+                weights[k] = std::max(overlap, 0.f);
+            }
+            else
+            {
+                weights[k] = kaiser_weight((pixelCenter - center) / scale);
+            }
+            total += weights[k];
+        }
+        for (uint32_t k = 0; k < axis.taps; k++)
+        {
+            weights[k] /= total;
+        }
+    }
+    return axis;
+}
+
+// filters every row of the source horizontally, into a buffer as wide as the destination and as tall as the source
+static void filter_rows(const MipImage &source, uint32_t firstRow, uint32_t lastRow, const AxisFilter &axis, uint32_t width, float *destination)
+{
+    for (uint32_t y = firstRow; y < lastRow; y++)
+    {
+        const float *row = source.pixels.data() + size_t(y) * source.width * 4;
+        float *out = destination + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            int64_t first = axis.first[x];
+            const float *weights = axis.weights.data() + size_t(x) * axis.taps;
+#if MIPS_SSE
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t k = 0; k < axis.taps; k++)
+            {
+                __m128 pixel = _mm_loadu_ps(row + clamp_index(first + k, source.width) * 4);
+                sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(weights[k])));
+            }
+            _mm_storeu_ps(out + x * 4, sum);
+#else
+            float sum[4] = {0, 0, 0, 0};
+            for (uint32_t k = 0; k < axis.taps; k++)
+            {
+                const float *pixel = row + clamp_index(first + k, source.width) * 4;
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    sum[c] += pixel[c] * weights[k];
+                }
+            }
+            memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+        }
+    }
+}
+
+// filters the horizontally filtered rows vertically, a whole row of floats at a time
+static void filter_columns(const float *filtered, uint32_t sourceHeight, uint32_t firstRow, uint32_t lastRow, const AxisFilter &axis, MipImage &destination)
+{
+    size_t rowFloats = size_t(destination.width) * 4;
+    for (uint32_t y = firstRow; y < lastRow; y++)
+    {
+        const float *weights = axis.weights.data() + size_t(y) * axis.taps;
+        const float *rows[MAX_FILTER_TAPS];
+        for (uint32_t k = 0; k < axis.taps; k++)
+        {
+            rows[k] = filtered + clamp_index(axis.first[y] + k, sourceHeight) * rowFloats;
+        }
+
+        float *out = destination.pixels.data() + y * rowFloats;
+        size_t i = 0;
+#if MIPS_SSE
+        for (; i + 4 <= rowFloats; i += 4)
+        {
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t k = 0; k < axis.taps; k++)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+            }
+            _mm_storeu_ps(out + i, sum);
+        }
+#endif
+        for (; i < rowFloats; i++)
+        {
+            float sum = 0;
+            for (uint32_t k = 0; k < axis.taps; k++)
+            {
+                sum += rows[k][i] * weights[k];
+            }
+            out[i] = sum;
+        }
+    }
+}
+
+// the negative lobes of the kaiser filter can push values out of range, and filtering shortens normals
+static void finish_rows(MipImage &image, uint32_t firstRow, uint32_t lastRow, const MipSettings &settings)
+{
+    float *pixel = image.pixels.data() + size_t(firstRow) * image.width * 4;
+    float *end = image.pixels.data() + size_t(lastRow) * image.width * 4;
+    for (; pixel != end; pixel += 4)
+    {
+        float alpha = std::clamp(pixel[3], 0.f, 1.f);
+        pixel[3] = alpha;
+        float colorMax = settings.premultiplied ? alpha : 1.f;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            pixel[c] = std::clamp(pixel[c], 0.f, colorMax);
+        }
+
+        if (settings.normalMap)
+        {
+            float x = pixel[0] * 2.f - 1.f;
+            float y = pixel[1] * 2.f - 1.f;
+            float z = pixel[2] * 2.f - 1.f;
+            float length = std::sqrt(x * x + y * y + z * z);
+            if (length > 0)
+            {
+                pixel[0] = x / length * 0.5f + 0.5f;
+                pixel[1] = y / length * 0.5f + 0.5f;
+                pixel[2] = z / length * 0.5f + 0.5f;
+            }
+            else
+            {
+                pixel[0] = 0.5f;
+                pixel[1] = 0.5f;
+                pixel[2] = 1.f;
+            }
+        }
+    }
+}
+
+// splits rows into tiles of tileRows, runs them on the pool and waits for all of them
+static void run_tiles(JobPool &jobs, uint32_t rows, uint32_t tileRows, const std::function<void(uint32_t first, uint32_t last)> &tile)
+{
+    JobPool::Group tiles;
+    for (uint32_t first = 0; first < rows; first += tileRows)
+    {
+        uint32_t last = std::min(first + tileRows, rows);
+        jobs.run(tiles, [&tile, first, last]()
+                 { tile(first, last); });
+    }
+    jobs.wait(tiles);
+}
+
+void generate_mips(MipImage base, const MipSettings &settings, JobPool &jobs,
+                   const std::function<void(uint32_t level, std::shared_ptr<const MipImage> image)> &onLevel)
+{
+    auto current = std::make_shared<MipImage>(std::move(base));
+    onLevel(0, current);
+
+    std::vector<float> filtered;
+    uint32_t level = 1;
+    while (current->width > 1 || current->height > 1)
+    {
+        const MipImage &source = *current;
+        auto next = std::make_shared<MipImage>();
+        next->width = std::max(source.width / 2, 1u);
+        next->height = std::max(source.height / 2, 1u);
+        next->pixels.resize(size_t(next->width) * next->height * 4);
+
+        AxisFilter horizontal = build_axis_filter(settings.filter, source.width, next->width);
+        AxisFilter vertical = build_axis_filter(settings.filter, source.height, next->height);
+
+        // separable, every source row is filtered horizontally before any column is
+        filtered.resize(size_t(next->width) * source.height * 4);
+        run_tiles(jobs, source.height, MIP_TILE_ROWS * 2, [&](uint32_t first, uint32_t last)
+                  { filter_rows(source, first, last, horizontal, next->width, filtered.data()); });
+        run_tiles(jobs, next->height, MIP_TILE_ROWS, [&](uint32_t first, uint32_t last)
+                  {
+            filter_columns(filtered.data(), source.height, first, last, vertical, *next);
+            finish_rows(*next, first, last, settings); });
+
+        current = next;
+        onLevel(level++, current);
+    }
+}
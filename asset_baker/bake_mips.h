@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class JobPool;
+
+enum class MipFilter : uint32_t
+{
+    Unknown = 0,
+    // average of the source pixels each one covers, every 2x2 block for even sizes. Fast and a bit blurry
+    Box,
+    // windowed sinc over 6 source pixels in each direction, keeps the small mips sharp without ringing
+    Kaiser
+};
+
+MipFilter parse_mip_filter(const char *f);
+const char *mip_filter_name(MipFilter filter);
+
+// rgba floats, 4 per pixel, row after row
+struct MipImage
+{
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> pixels;
+};
+
+struct MipSettings
+{
+    MipFilter filter{MipFilter::Kaiser};
+    // xyz stored as 0 to 1, every level is renormalized after filtering
+    bool normalMap{false};
+    // the pixels are premultiplied by alpha, so transparent texels dont bleed their color into the mips
+    bool premultiplied{false};
+};
+
+// output rows of a level one job filters, levels smaller than this are a single job
+constexpr uint32_t MIP_TILE_ROWS = 32;
+
+// 8 bit rgba pixels as linear floats. sRGB color channels are converted to linear, alpha never is.
+// premultiply multiplies the color by alpha, for MipSettings::premultiplied
+MipImage load_mip_image(const uint8_t *rgba, uint32_t width, uint32_t height, bool srgb, bool premultiply);
+
+// number of levels down to 1x1, including the full size one
+uint32_t mip_level_count(uint32_t width, uint32_t height);
+
+// filters the whole chain in linear space, every level from the one above it, with the rows of each level split into tiles
+// that run as jobs on the pool. onLevel is called on the calling thread with every level, the base one included, as soon
+// as it is done, so it can queue its compression while the next level gets filtered. The level is not modified afterwards
+void generate_mips(MipImage base, const MipSettings &settings, JobPool &jobs,
+                   const std::function<void(uint32_t level, std::shared_ptr<const MipImage> image)> &onLevel);
@@ -0,0 +1,169 @@
+#include "bake_profile.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+    const char *STAGE_NAMES[] = {"decode", "mip", "compress", "mesh", "lz4", "write"};
+    static_assert(std::size(STAGE_NAMES) == size_t(BakeStage::Count), "every stage needs a name");
+
+    // innermost running timer of this thread
+    thread_local StageTimer *currentTimer = nullptr;
+
+    double megabytes_per_second(uint64_t bytes, double seconds)
+    {
+        return seconds > 0 ? double(bytes) / (1024.0 * 1024.0) / seconds : 0;
+    }
+}
+
+const char *bake_stage_name(BakeStage stage)
+{
+    return size_t(stage) < std::size(STAGE_NAMES) ? STAGE_NAMES[size_t(stage)] : "unknown";
+}
+
+void BakeProfiler::add_stage(const std::string &fileType, BakeStage stage, double seconds, uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    BakeStageStats &stats = _types[fileType].stages[size_t(stage)];
+    stats.seconds += seconds;
+    stats.bytes += bytes;
+    stats.calls++;
+}
+
+void BakeProfiler::add_file(const std::string &fileType, double seconds, uint64_t sourceBytes)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    BakeTypeStats &stats = _types[fileType];
+    stats.files++;
+    stats.sourceBytes += sourceBytes;
+    stats.fileSeconds.push_back(seconds);
+}
+
+void BakeProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    _types.clear();
+}
+
+std::map<std::string, BakeTypeStats> BakeProfiler::stats() const
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    return _types;
+}
+
+StageTimer::StageTimer(BakeProfiler *profiler, const char *fileType, BakeStage stage, uint64_t bytes)
+    : _profiler{profiler}, _fileType{fileType}, _stage{stage}, _bytes{bytes}, _start{std::chrono::steady_clock::now()}, _outer{currentTimer}
+{
+    currentTimer = this;
+}
+
+StageTimer::~StageTimer()
+{
+    stop();
+}
+
+double StageTimer::stop()
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    if (!_running)
+    {
+        return seconds;
+    }
+    _running = false;
+
+    currentTimer = _outer;
+    if (_outer)
+    {
+        _outer->_innerSeconds += seconds;
+    }
+    if (_profiler)
+    {
+        _profiler->add_stage(_fileType, _stage, std::max(seconds - _innerSeconds, 0.0), _bytes);
+    }
+    return seconds;
+}
+
+std::string bake_report_json(const std::map<std::string, BakeTypeStats> &stats, double wallSeconds, uint32_t threads)
+{
+    nlohmann::json report;
+    report["threads"] = threads;
+    report["wall_seconds"] = wallSeconds;
+
+    nlohmann::json types = nlohmann::json::object();
+    for (auto &[name, type] : stats)
+    {
+        std::vector<double> sorted = type.fileSeconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        nlohmann::json typeJson;
+        typeJson["files"] = type.files;
+        typeJson["source_bytes"] = type.sourceBytes;
+        typeJson["file_seconds"] = {
+            {"p50", percentile(sorted, 0.5)},
+            {"p90", percentile(sorted, 0.9)},
+            {"p99", percentile(sorted, 0.99)},
+            {"max", sorted.empty() ? 0 : sorted.back()}};
+
+        nlohmann::json stages = nlohmann::json::object();
+        for (uint32_t s = 0; s < uint32_t(BakeStage::Count); s++)
+        {
+            const BakeStageStats &stage = type.stages[s];
+            if (stage.calls == 0)
+                continue;
+            stages[bake_stage_name(BakeStage(s))] = {
+                {"seconds", stage.seconds},
+                {"bytes", stage.bytes},
+                {"calls", stage.calls},
+                {"mb_per_second", megabytes_per_second(stage.bytes, stage.seconds)}};
+        }
+        typeJson["stages"] = std::move(stages);
+        types[name] = std::move(typeJson);
+    }
+    report["file_types"] = std::move(types);
+    return report.dump(4);
+}
+
+bool write_bake_report(const std::filesystem::path &path, const std::map<std::string, BakeTypeStats> &stats, double wallSeconds, uint32_t threads)
+{
+    std::ofstream outfile{path, std::ios::trunc};
+    if (!outfile.is_open())
+    {
+        std::cout << "could not write the bake report to " << path << std::endl;
+        return false;
+    }
+    outfile << bake_report_json(stats, wallSeconds, threads);
+    return outfile.good();
+}
+
+void print_bake_report(const std::map<std::string, BakeTypeStats> &stats, double wallSeconds)
+{
+    std::cout << "bake took " << wallSeconds * 1000.0 << "ms" << std::endl;
+    for (auto &[name, type] : stats)
+    {
+        std::cout << name << ": " << type.files << " files" << std::endl;
+        for (uint32_t s = 0; s < uint32_t(BakeStage::Count); s++)
+        {
+            const BakeStageStats &stage = type.stages[s];
+            if (stage.calls == 0)
+                continue;
+            std::cout << "    " << bake_stage_name(BakeStage(s)) << " " << stage.seconds * 1000.0 << "ms, "
+                      << megabytes_per_second(stage.bytes, stage.seconds) << " MB/s" << std::endl;
+        }
+    }
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
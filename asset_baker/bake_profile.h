@@ -0,0 +1,96 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class BakeStage : uint32_t
+{
+    // reading and parsing the source file, and extracting meshes from it
+    Decode,
+    // converting the image to linear floats and filtering the mip chain
+    Mip,
+    // block compressing the texture levels
+    Compress,
+    // welding, lods, cache and overdraw optimization and meshlets
+    Mesh,
+    // lz4 compressing the asset blob
+    LZ4,
+    // writing the asset file
+    Write,
+    Count
+};
+
+const char *bake_stage_name(BakeStage stage);
+
+struct BakeStageStats
+{
+    double seconds{0};
+    // what the stage read, so seconds and bytes give its throughput
+    uint64_t bytes{0};
+    uint64_t calls{0};
+};
+
+// everything baked from one kind of source file, like textures or gltf scenes
+struct BakeTypeStats
+{
+    uint64_t files{0};
+    uint64_t sourceBytes{0};
+    // wall time from starting a file to finishing it, one entry per file. Includes jobs of other files the thread ran while waiting
+    std::vector<double> fileSeconds;
+    BakeStageStats stages[size_t(BakeStage::Count)];
+};
+
+// timings of a bake, filled in by every job at once
+class BakeProfiler
+{
+public:
+    void add_stage(const std::string &fileType, BakeStage stage, double seconds, uint64_t bytes);
+    void add_file(const std::string &fileType, double seconds, uint64_t sourceBytes);
+    void reset();
+
+    std::map<std::string, BakeTypeStats> stats() const;
+
+private:
+    std::map<std::string, BakeTypeStats> _types;
+    mutable std::mutex _mutex;
+};
+
+// times a stage of a file until stop or the end of the scope. Times are exclusive: when a timer is started while another one
+// is running on the same thread, like a compression job that a thread waiting on its mips picks up, the inner time is taken out
+// of the outer one so nothing is counted twice. Timers on a thread have to stop in the opposite order they started.
+// A null profiler only measures
+class StageTimer
+{
+public:
+    StageTimer(BakeProfiler *profiler, const char *fileType, BakeStage stage, uint64_t bytes = 0);
+    ~StageTimer();
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    void set_bytes(uint64_t bytes) { _bytes = bytes; }
+    // records the stage and returns its wall time in seconds, inner timers included
+    double stop();
+
+private:
+    BakeProfiler *_profiler;
+    const char *_fileType;
+    BakeStage _stage;
+    uint64_t _bytes;
+    std::chrono::steady_clock::time_point _start;
+    double _innerSeconds{0};
+    StageTimer *_outer;
+    bool _running{true};
+};
+
+// the stats of every file type, with the throughput of every stage, as json. wallSeconds is the time the whole bake took
+std::string bake_report_json(const std::map<std::string, BakeTypeStats> &stats, double wallSeconds, uint32_t threads);
+bool write_bake_report(const std::filesystem::path &path, const std::map<std::string, BakeTypeStats> &stats, double wallSeconds, uint32_t threads);
+// a line per file type and stage, for the console
+void print_bake_report(const std::map<std::string, BakeTypeStats> &stats, double wallSeconds);
+
+// value below which the fraction p of the sorted values fall, nearest rank. 0 when empty
+double percentile(const std::vector<double> &sorted, double p);
@@ -0,0 +1,284 @@
+#include "asset_archive.h"
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+using namespace assets;
+
+uint64_t assets::hash_asset_path(std::string_view path)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : path)
+    {
+        if (c == '\\')
+        {
+            c = '/';
+        }
+        hash ^= uint8_t(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool assets::write_archive(const char *archivePath, const std::vector<ArchiveSource> &sources, uint32_t alignment)
+{
+    // entries are written in path order, so the same inputs always give the same archive
+    std::vector<const ArchiveSource *> ordered;
+    ordered.reserve(sources.size());
+    for (auto &source : sources)
+    {
+        ordered.push_back(&source);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const ArchiveSource *a, const ArchiveSource *b)
+              { return a->path < b->path; });
+
+    // the table of contents is known before anything is written, so a collision fails without touching the disk
+    std::vector<ArchiveEntry> entries;
+    entries.reserve(ordered.size());
+    std::string names;
+    for (const ArchiveSource *source : ordered)
+    {
+        ArchiveEntry entry = {};
+        entry.pathHash = hash_asset_path(source->path);
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(source->path.size());
+        names += source->path;
+        entries.push_back(entry);
+    }
+
+    std::vector<const ArchiveEntry *> byHash;
+    byHash.reserve(entries.size());
+    for (auto &entry : entries)
+    {
+        byHash.push_back(&entry);
+    }
+    std::sort(byHash.begin(), byHash.end(), [](const ArchiveEntry *a, const ArchiveEntry *b)
+              { return a->pathHash < b->pathHash; });
+    for (size_t i = 1; i < byHash.size(); i++)
+    {
+        if (byHash[i]->pathHash == byHash[i - 1]->pathHash)
+        {
+            std::cout << "Archive path hash collision: " << names.substr(byHash[i]->nameOffset, byHash[i]->nameLength)
+                      << " and " << names.substr(byHash[i - 1]->nameOffset, byHash[i - 1]->nameLength) << std::endl;
+            return false;
+        }
+    }
+
+    // written to the side and renamed, so a failed write never leaves a truncated archive behind
+    std::filesystem::path temporary = archivePath;
+    temporary += ".tmp";
+    std::ofstream outfile;
+    outfile.open(temporary, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!outfile.is_open())
+    {
+        std::cout << "Error when trying to write archive: " << archivePath << std::endl;
+        return false;
+    }
+    auto fail = [&]()
+    {
+        outfile.close();
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        return false;
+    };
+
+    ArchiveHeader header = {};
+    memcpy(header.magic, ARCHIVE_MAGIC, 4);
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(ordered.size());
+    header.alignment = alignment;
+    // written again at the end, once the offsets are known
+    outfile.write((const char *)&header, sizeof(ArchiveHeader));
+
+    std::vector<char> padding(alignment, 0);
+    std::vector<char> copyBuffer(1024 * 1024);
+    // offset and size of every source file written so far, entries with the same source point at the one copy
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> written;
+
+    uint64_t offset = sizeof(ArchiveHeader);
+    for (size_t i = 0; i < ordered.size(); i++)
+    {
+        const ArchiveSource *source = ordered[i];
+        ArchiveEntry &entry = entries[i];
+
+        auto copy = written.find(source->sourceFile);
+        if (copy != written.end())
+        {
+            entry.offset = copy->second.first;
+            entry.size = copy->second.second;
+            continue;
+        }
+
+        std::ifstream infile;
+        infile.open(source->sourceFile, std::ios::binary);
+        if (!infile.is_open())
+        {
+            std::cout << "Error when trying to read archive source: " << source->sourceFile << std::endl;
+            return fail();
+        }
+
+        uint64_t aligned = (offset + alignment - 1) / alignment * alignment;
+        outfile.write(padding.data(), aligned - offset);
+        offset = aligned;
+
+        entry.offset = offset;
+
+        uint64_t size = 0;
+        while (infile)
+        {
+            infile.read(copyBuffer.data(), copyBuffer.size());
+            std::streamsize count = infile.gcount();
+            outfile.write(copyBuffer.data(), count);
+            size += count;
+        }
+        if (infile.bad() || outfile.fail())
+        {
+            std::cout << "Error when copying archive source: " << source->sourceFile << std::endl;
+            return fail();
+        }
+        entry.size = size;
+        offset += size;
+        written[source->sourceFile] = {entry.offset, entry.size};
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const ArchiveEntry &a, const ArchiveEntry &b)
+              { return a.pathHash < b.pathHash; });
+
+    uint64_t tocOffset = (offset + 7) / 8 * 8;
+    outfile.write(padding.data(), tocOffset - offset);
+    outfile.write((const char *)entries.data(), entries.size() * sizeof(ArchiveEntry));
+    outfile.write(names.data(), names.size());
+
+    header.tocOffset = tocOffset;
+    header.namesOffset = tocOffset + entries.size() * sizeof(ArchiveEntry);
+    header.namesSize = names.size();
+    outfile.seekp(0);
+    outfile.write((const char *)&header, sizeof(ArchiveHeader));
+
+    outfile.close();
+    if (outfile.fail())
+    {
+        std::cout << "Error when trying to write archive: " << archivePath << std::endl;
+        return fail();
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, archivePath, error);
+    if (error)
+    {
+        std::cout << "Error when trying to write archive: " << archivePath << ": " << error.message() << std::endl;
+        return fail();
+    }
+    return true;
+}
+
+bool AssetArchive::open(const char *path)
+{
+    // entries are looked up in any order
+    if (!map_file(path, _mapping, MapAccess::Random))
+        return false;
+
+    if (_mapping.size < sizeof(ArchiveHeader))
+    {
+        close();
+        return false;
+    }
+    memcpy(&_header, _mapping.data, sizeof(ArchiveHeader));
+
+    bool valid = memcmp(_header.magic, ARCHIVE_MAGIC, 4) == 0 && _header.version == ARCHIVE_VERSION;
+    valid = valid && _header.tocOffset % alignof(ArchiveEntry) == 0;
+    // offsets and sizes are checked against the space left instead of added up, so a corrupt header cant wrap around
+    valid = valid && _header.tocOffset <= _header.namesOffset &&
+            uint64_t(_header.entryCount) * sizeof(ArchiveEntry) <= _header.namesOffset - _header.tocOffset;
+    valid = valid && _header.namesOffset <= _mapping.size && _header.namesSize <= _mapping.size - _header.namesOffset;
+    if (!valid)
+    {
+        std::cout << "Invalid archive file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    _entries = (const ArchiveEntry *)(_mapping.data + _header.tocOffset);
+    _names = _mapping.data + _header.namesOffset;
+    return true;
+}
+
+void AssetArchive::close()
+{
+    unmap_file(_mapping);
+    _header = {};
+    _entries = nullptr;
+    _names = nullptr;
+}
+
+const ArchiveEntry *AssetArchive::find(uint64_t pathHash) const
+{
+    const ArchiveEntry *end = _entries + _header.entryCount;
+    const ArchiveEntry *it = std::lower_bound(_entries, end, pathHash, [](const ArchiveEntry &entry, uint64_t hash)
+                                              { return entry.pathHash < hash; });
+    if (it == end || it->pathHash != pathHash)
+    {
+        return nullptr;
+    }
+    return it;
+}
+
+// same path once backslashes are read as forward slashes, like hash_asset_path does
+static bool same_asset_path(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        char ca = a[i] == '\\' ? '/' : a[i];
+        char cb = b[i] == '\\' ? '/' : b[i];
+        if (ca != cb)
+            return false;
+    }
+    return true;
+}
+
+const ArchiveEntry *AssetArchive::find(std::string_view path) const
+{
+    // a path that is not in the archive can still hash like one that is
+    const ArchiveEntry *entry = find(hash_asset_path(path));
+    if (!entry || !same_asset_path(entry_name(*entry), path))
+        return nullptr;
+    return entry;
+}
+
+std::string_view AssetArchive::entry_name(const ArchiveEntry &entry) const
+{
+    if (entry.nameOffset > _header.namesSize || entry.nameLength > _header.namesSize - entry.nameOffset)
+        return {};
+    return std::string_view(_names + entry.nameOffset, entry.nameLength);
+}
+
+bool AssetArchive::view_asset(std::string_view path, MappedAssetFile &outputFile) const
+{
+    const ArchiveEntry *entry = find(path);
+    if (!entry || entry->offset > _mapping.size || entry->size > _mapping.size - entry->offset)
+        return false;
+
+    outputFile.mapping = {};
+    return view_binaryfile(_mapping.data + entry->offset, entry->size, outputFile);
+}
+
+bool AssetArchive::load_asset(std::string_view path, AssetFile &outputFile) const
+{
+    MappedAssetFile view;
+    if (!view_asset(path, view))
+        return false;
+
+    memcpy(outputFile.type, view.type, 4);
+    outputFile.version = view.version;
+    outputFile.dictionaryId = view.dictionaryId;
+    outputFile.json = std::string(view.json);
+    outputFile.binaryMetadata.assign(view.binaryMetadata.begin(), view.binaryMetadata.end());
+    outputFile.binaryBlob.assign(view.binaryBlob, view.binaryBlob + view.binaryBlobSize);
+    return true;
+}
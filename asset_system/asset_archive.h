@@ -0,0 +1,74 @@
+#pragma once
+#include "asset_loader.h"
+
+namespace assets
+{
+    // an archive packs many asset files into one. Entries are stored whole, exactly as save_binaryfile writes them,
+    // each starting at an aligned offset. Entries with the same source file share one copy of it.
+    // The table of contents sits at the end of the file, sorted by path hash
+    struct ArchiveHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t alignment;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+    constexpr char ARCHIVE_MAGIC[4] = {'A', 'P', 'A', 'K'};
+    constexpr uint32_t ARCHIVE_VERSION = 1;
+    constexpr uint32_t ARCHIVE_ALIGNMENT = 4096;
+
+    struct ArchiveEntry
+    {
+        uint64_t pathHash;
+        uint64_t offset;
+        uint64_t size;
+        // path of the entry in the names block, to list the archive and to tell paths with the same hash apart
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+
+    // FNV-1a 64 bit hash of the path, with backslashes treated as forward slashes
+    uint64_t hash_asset_path(std::string_view path);
+
+    struct ArchiveSource
+    {
+        // the name the asset is looked up by
+        std::string path;
+        // the file on disk that gets copied into the archive, only once when several entries name it
+        std::string sourceFile;
+    };
+
+    // fails if a source cant be read or if two paths hash to the same value
+    bool write_archive(const char *archivePath, const std::vector<ArchiveSource> &sources, uint32_t alignment = ARCHIVE_ALIGNMENT);
+
+    // a read-only archive, mapped into memory as a whole
+    class AssetArchive
+    {
+    public:
+        bool open(const char *path);
+        void close();
+
+        // returns nullptr if the path is not in the archive
+        const ArchiveEntry *find(std::string_view path) const;
+        // only compares hashes, a path that is not in the archive can match an entry of another path
+        const ArchiveEntry *find(uint64_t pathHash) const;
+
+        // points the view straight into the archive, it stays valid until the archive is closed
+        bool view_asset(std::string_view path, MappedAssetFile &outputFile) const;
+        bool load_asset(std::string_view path, AssetFile &outputFile) const;
+
+        uint32_t entry_count() const { return _header.entryCount; }
+        const ArchiveEntry &entry(uint32_t index) const { return _entries[index]; }
+        // empty when the name of the entry lies outside the names block
+        std::string_view entry_name(const ArchiveEntry &entry) const;
+
+    private:
+        FileMapping _mapping;
+        ArchiveHeader _header{};
+        const ArchiveEntry *_entries{nullptr};
+        const char *_names{nullptr};
+    };
+}
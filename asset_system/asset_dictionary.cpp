@@ -0,0 +1,207 @@
+#include "asset_dictionary.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace assets;
+
+// length of the sequences that get counted across samples, and of the pieces the dictionary is built from
+constexpr size_t SEQUENCE_LENGTH = 8;
+constexpr size_t SEGMENT_LENGTH = 64;
+
+static uint32_t hash_dictionary(const std::vector<char> &data)
+{
+    uint32_t hash = 2166136261u;
+    for (char c : data)
+    {
+        hash ^= uint8_t(c);
+        hash *= 16777619u;
+    }
+    // 0 is reserved for no dictionary
+    return hash != 0 ? hash : 1;
+}
+
+static uint64_t read_sequence(const char *data)
+{
+    uint64_t sequence;
+    memcpy(&sequence, data, SEQUENCE_LENGTH);
+    return sequence;
+}
+
+static uint64_t score_segment(std::string_view sample, size_t offset, const std::unordered_map<uint64_t, uint32_t> &frequency)
+{
+    uint64_t score = 0;
+    size_t end = std::min(offset + SEGMENT_LENGTH, sample.size()) - SEQUENCE_LENGTH + 1;
+    for (size_t i = offset; i < end; i++)
+    {
+        auto it = frequency.find(read_sequence(sample.data() + i));
+        // content that only shows up in one sample is not worth sharing
+        if (it != frequency.end() && it->second > 1)
+        {
+            score += it->second;
+        }
+    }
+    return score;
+}
+
+CompressionDictionary assets::build_dictionary(const std::vector<std::string_view> &samples, size_t maxSize)
+{
+    maxSize = std::min(maxSize, MAX_DICTIONARY_SIZE);
+
+    // count how many samples every sequence appears in
+    std::unordered_map<uint64_t, uint32_t> frequency;
+    std::unordered_set<uint64_t> seen;
+    for (auto &sample : samples)
+    {
+        seen.clear();
+        for (size_t i = 0; i + SEQUENCE_LENGTH <= sample.size(); i++)
+        {
+            uint64_t sequence = read_sequence(sample.data() + i);
+            if (seen.insert(sequence).second)
+            {
+                frequency[sequence]++;
+            }
+        }
+    }
+
+    struct Candidate
+    {
+        uint64_t score;
+        uint32_t sample;
+        uint32_t offset;
+
+        bool operator<(const Candidate &other) const { return score < other.score; }
+    };
+
+    std::priority_queue<Candidate> candidates;
+    for (uint32_t s = 0; s < samples.size(); s++)
+    {
+        if (samples[s].size() < SEGMENT_LENGTH)
+            continue;
+
+        for (size_t offset = 0; offset + SEGMENT_LENGTH <= samples[s].size(); offset += SEGMENT_LENGTH / 2)
+        {
+            uint64_t score = score_segment(samples[s], offset, frequency);
+            if (score > 0)
+            {
+                candidates.push({score, s, static_cast<uint32_t>(offset)});
+            }
+        }
+    }
+
+    // greedy pick of the best segment. Once a segment is in, its sequences are worth nothing to the others,
+    // so scores are refreshed lazily when a candidate reaches the top
+    std::vector<std::string_view> picked;
+    size_t dictionarySize = 0;
+    while (!candidates.empty() && dictionarySize + SEGMENT_LENGTH <= maxSize)
+    {
+        Candidate best = candidates.top();
+        candidates.pop();
+
+        std::string_view sample = samples[best.sample];
+        uint64_t score = score_segment(sample, best.offset, frequency);
+        if (score == 0)
+            continue;
+
+        if (!candidates.empty() && score < candidates.top().score)
+        {
+            best.score = score;
+            candidates.push(best);
+            continue;
+        }
+
+        std::string_view segment = sample.substr(best.offset, SEGMENT_LENGTH);
+        picked.push_back(segment);
+        dictionarySize += segment.size();
+
+        for (size_t i = 0; i + SEQUENCE_LENGTH <= segment.size(); i++)
+        {
+            frequency[read_sequence(segment.data() + i)] = 0;
+        }
+    }
+
+    // most valuable segments were picked first, they go last
+    CompressionDictionary dictionary;
+    dictionary.data.reserve(dictionarySize);
+    for (auto it = picked.rbegin(); it != picked.rend(); it++)
+    {
+        dictionary.data.insert(dictionary.data.end(), it->begin(), it->end());
+    }
+
+    if (!dictionary.data.empty())
+    {
+        dictionary.id = hash_dictionary(dictionary.data);
+    }
+    return dictionary;
+}
+
+AssetFile assets::pack_dictionary(const CompressionDictionary &dictionary)
+{
+    AssetFile file;
+    file.type[0] = 'D';
+    file.type[1] = 'I';
+    file.type[2] = 'C';
+    file.type[3] = 'T';
+    file.version = 1;
+
+    // the id is the hash of the contents, so the blob is all there is to store
+    file.binaryBlob = dictionary.data;
+    return file;
+}
+
+bool assets::read_dictionary(const AssetFile &file, CompressionDictionary &dictionary)
+{
+    if (memcmp(file.type, "DICT", 4) != 0 || file.binaryBlob.empty())
+        return false;
+
+    dictionary.data = file.binaryBlob;
+    dictionary.id = hash_dictionary(dictionary.data);
+    return true;
+}
+
+static std::mutex dictionaryMutex;
+static std::unordered_map<uint32_t, std::unique_ptr<CompressionDictionary>> dictionaries;
+
+void assets::register_dictionary(CompressionDictionary dictionary)
+{
+    std::lock_guard<std::mutex> lock{dictionaryMutex};
+
+    uint32_t id = dictionary.id;
+    // registered dictionaries are never freed, so the pointers handed out stay valid
+    if (dictionaries.find(id) == dictionaries.end())
+    {
+        dictionaries[id] = std::make_unique<CompressionDictionary>(std::move(dictionary));
+    }
+}
+
+bool assets::load_dictionary(const char *path)
+{
+    AssetFile file;
+    CompressionDictionary dictionary;
+    if (!load_binaryfile(path, file) || !read_dictionary(file, dictionary))
+    {
+        std::cout << "Error when loading dictionary " << path << std::endl;
+        return false;
+    }
+
+    register_dictionary(std::move(dictionary));
+    return true;
+}
+
+const CompressionDictionary *assets::find_dictionary(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock{dictionaryMutex};
+
+    auto it = dictionaries.find(id);
+    if (it == dictionaries.end())
+    {
+        return nullptr;
+    }
+    return it->second.get();
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "asset_loader.h"
+
+namespace assets
+{
+    // lz4 can only reference the last 64kb before a block, so a bigger dictionary would never be used
+    constexpr size_t MAX_DICTIONARY_SIZE = 64 * 1024;
+
+    // builds a dictionary out of the byte sequences that show up in the most samples.
+    // the most common content goes at the end, closest to the data, where lz4 offsets are cheapest
+    CompressionDictionary build_dictionary(const std::vector<std::string_view> &samples, size_t maxSize = MAX_DICTIONARY_SIZE);
+
+    // dictionaries are stored as their own asset file, type DICT
+    AssetFile pack_dictionary(const CompressionDictionary &dictionary);
+    bool read_dictionary(const AssetFile &file, CompressionDictionary &dictionary);
+
+    // dictionaries the loader can decode with. Registered once at startup, looked up by the id stored in each file
+    void register_dictionary(CompressionDictionary dictionary);
+    // loads and registers a dictionary file
+    bool load_dictionary(const char *path);
+    // returns nullptr if no dictionary with that id was registered
+    const CompressionDictionary *find_dictionary(uint32_t id);
+}
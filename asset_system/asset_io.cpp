@@ -0,0 +1,699 @@
+#include "asset_io.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define ASSETS_IO_URING 1
+#endif
+#endif
+
+using namespace assets;
+
+// the length of an io_uring read is 32 bit. Splitting big blobs also lets them use more of the queue
+constexpr uint64_t MAX_READ_SIZE = 16 * 1024 * 1024;
+// keeps a batch below the default open file limit
+constexpr size_t MAX_BATCH_FILES = 256;
+
+#ifdef ASSETS_IO_URING
+struct assets::IoUring
+{
+    int fd{-1};
+    uint32_t entries{0};
+
+    void *sqRing{nullptr};
+    size_t sqRingSize{0};
+    void *cqRing{nullptr};
+    size_t cqRingSize{0};
+    io_uring_sqe *sqes{nullptr};
+    size_t sqesSize{0};
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    io_uring_cqe *cqes;
+};
+
+static void destroy_ring(IoUring *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing && ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqRing)
+        munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    delete ring;
+}
+
+// returns nullptr when the kernel is too old or io_uring is disabled, like in many containers
+static IoUring *create_ring(uint32_t queueDepth)
+{
+    io_uring_params params = {};
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+    if (fd < 0)
+        return nullptr;
+
+    IoUring *ring = new IoUring;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+    {
+        ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+    }
+
+    void *sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        destroy_ring(ring);
+        return nullptr;
+    }
+    ring->sqRing = sqRing;
+
+    void *cqRing = sqRing;
+    if (!singleMap)
+    {
+        cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            destroy_ring(ring);
+            return nullptr;
+        }
+    }
+    ring->cqRing = cqRing;
+
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        destroy_ring(ring);
+        return nullptr;
+    }
+    ring->sqes = (io_uring_sqe *)sqes;
+
+    char *sq = (char *)sqRing;
+    ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+
+    char *cq = (char *)cqRing;
+    ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return ring;
+}
+#else
+struct assets::IoUring
+{
+};
+#endif
+
+static char *allocate_aligned(uint64_t size)
+{
+#ifdef _WIN32
+    return (char *)_aligned_malloc(size, DIRECT_READ_ALIGNMENT);
+#else
+    void *memory = nullptr;
+    if (posix_memalign(&memory, DIRECT_READ_ALIGNMENT, size) != 0)
+        return nullptr;
+    return (char *)memory;
+#endif
+}
+
+static void free_aligned(char *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+// reads until size bytes are in or the file ends, returns the bytes read or -1
+static int64_t read_at(intptr_t handle, uint64_t offset, uint64_t size, char *destination)
+{
+    uint64_t done = 0;
+    while (done < size)
+    {
+        uint64_t chunk = std::min(size - done, MAX_READ_SIZE);
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset + done);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        DWORD count = 0;
+        if (!ReadFile((HANDLE)handle, destination + done, static_cast<DWORD>(chunk), &count, &overlapped))
+        {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            return -1;
+        }
+#else
+        ssize_t count = pread(static_cast<int>(handle), destination + done, chunk, static_cast<off_t>(offset + done));
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+#endif
+        if (count == 0)
+            break;
+        done += count;
+    }
+    return static_cast<int64_t>(done);
+}
+
+static void close_handle(intptr_t handle)
+{
+    if (handle == -1)
+        return;
+#ifdef _WIN32
+    CloseHandle((HANDLE)handle);
+#else
+    close(static_cast<int>(handle));
+#endif
+}
+
+BatchFileReader::~BatchFileReader()
+{
+    cleanup();
+}
+
+void BatchFileReader::init(uint32_t queueDepth)
+{
+    cleanup();
+    _queueDepth = std::max(queueDepth, 1u);
+#ifdef ASSETS_IO_URING
+    _ring = create_ring(_queueDepth);
+#endif
+}
+
+void BatchFileReader::cleanup()
+{
+    close_files();
+#ifdef ASSETS_IO_URING
+    if (_ring)
+    {
+        destroy_ring(_ring);
+    }
+#endif
+    _ring = nullptr;
+}
+
+int BatchFileReader::open_file(const char *path, uint64_t directMinSize)
+{
+    OpenFile file;
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return -1;
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(handle, &fileSize);
+    file.size = static_cast<uint64_t>(fileSize.QuadPart);
+    file.handle = (intptr_t)handle;
+
+    if (directMinSize != 0 && file.size >= directMinSize)
+    {
+        HANDLE directHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+        file.directHandle = directHandle == INVALID_HANDLE_VALUE ? -1 : (intptr_t)directHandle;
+    }
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    file.size = static_cast<uint64_t>(st.st_size);
+    file.handle = fd;
+
+#ifdef O_DIRECT
+    // some filesystems, like tmpfs, refuse O_DIRECT. Those reads just go through the page cache
+    if (directMinSize != 0 && file.size >= directMinSize)
+    {
+        file.directHandle = open(path, O_RDONLY | O_CLOEXEC | O_DIRECT);
+    }
+#endif
+#endif
+
+    _files.push_back(file);
+    return static_cast<int>(_files.size() - 1);
+}
+
+uint64_t BatchFileReader::file_size(int file) const
+{
+    return _files[file].size;
+}
+
+void BatchFileReader::close_files()
+{
+    for (auto &file : _files)
+    {
+        close_handle(file.handle);
+        close_handle(file.directHandle);
+    }
+    _files.clear();
+    _reads.clear();
+    _submitted = false;
+}
+
+void BatchFileReader::add_read(int file, uint64_t offset, uint64_t size, char *destination, bool direct)
+{
+    Read read = {};
+    read.file = file;
+    read.offset = offset;
+    read.size = size;
+    read.destination = destination;
+    read.direct = direct && _files[file].directHandle != -1;
+
+    if (read.direct)
+    {
+        read.bounceOffset = offset / DIRECT_READ_ALIGNMENT * DIRECT_READ_ALIGNMENT;
+        uint64_t end = (offset + size + DIRECT_READ_ALIGNMENT - 1) / DIRECT_READ_ALIGNMENT * DIRECT_READ_ALIGNMENT;
+        read.bounceSize = end - read.bounceOffset;
+    }
+
+    // reads from the last submit are done with, start a new batch
+    if (_submitted)
+    {
+        _reads.clear();
+        _submitted = false;
+    }
+    _reads.push_back(read);
+}
+
+uint64_t BatchFileReader::bytes_read(size_t read) const
+{
+    return _reads[read].bytesRead;
+}
+
+bool BatchFileReader::read_blocking(Read &read)
+{
+    const OpenFile &file = _files[read.file];
+    if (read.direct)
+    {
+        int64_t count = read_at(file.directHandle, read.bounceOffset, read.bounceSize, read.bounce);
+        read.failed = count < 0;
+        read.bytesRead = count < 0 ? 0 : static_cast<uint64_t>(count);
+    }
+    else
+    {
+        int64_t count = read_at(file.handle, read.offset, read.size, read.destination);
+        read.failed = count < 0;
+        read.bytesRead = count < 0 ? 0 : static_cast<uint64_t>(count);
+    }
+    return !read.failed;
+}
+
+// direct reads landed in the bounce buffer, copy out the part that was asked for
+void BatchFileReader::finish_read(Read &read)
+{
+    if (read.failed)
+    {
+        read.bytesRead = 0;
+    }
+    if (!read.direct)
+        return;
+
+    uint64_t skip = read.offset - read.bounceOffset;
+    uint64_t available = read.bytesRead > skip ? read.bytesRead - skip : 0;
+    read.bytesRead = std::min(available, read.size);
+    if (!read.failed)
+    {
+        memcpy(read.destination, read.bounce + skip, read.bytesRead);
+    }
+    free_aligned(read.bounce);
+    read.bounce = nullptr;
+}
+
+bool BatchFileReader::submit()
+{
+    _submitted = true;
+    for (auto &read : _reads)
+    {
+        read.failed = false;
+        read.bytesRead = 0;
+        if (read.direct)
+        {
+            read.bounce = allocate_aligned(read.bounceSize);
+            read.failed = read.bounce == nullptr;
+        }
+    }
+
+    bool success;
+    if (_ring)
+    {
+        success = submit_ring();
+    }
+    else
+    {
+        success = true;
+        for (auto &read : _reads)
+        {
+            if (read.failed || !read_blocking(read))
+            {
+                success = false;
+            }
+        }
+    }
+
+    for (auto &read : _reads)
+    {
+        finish_read(read);
+        success = success && !read.failed;
+    }
+    return success;
+}
+
+bool BatchFileReader::submit_ring()
+{
+#ifdef ASSETS_IO_URING
+    // every read is split into pieces of at most MAX_READ_SIZE, which go to the kernel as separate requests
+    struct Piece
+    {
+        size_t read;
+        int fd;
+        uint64_t offset;
+        uint64_t size;
+        char *destination;
+        bool done;
+    };
+
+    std::vector<Piece> pieces;
+    for (size_t i = 0; i < _reads.size(); i++)
+    {
+        Read &read = _reads[i];
+        if (read.failed)
+            continue;
+
+        int fd = static_cast<int>(read.direct ? _files[read.file].directHandle : _files[read.file].handle);
+        uint64_t offset = read.direct ? read.bounceOffset : read.offset;
+        uint64_t size = read.direct ? read.bounceSize : read.size;
+        char *destination = read.direct ? read.bounce : read.destination;
+        for (uint64_t done = 0; done < size; done += MAX_READ_SIZE)
+        {
+            pieces.push_back({i, fd, offset + done, std::min(size - done, MAX_READ_SIZE), destination + done, false});
+        }
+    }
+
+    IoUring &ring = *_ring;
+    std::vector<uint32_t> queued;
+    queued.reserve(pieces.size());
+    for (uint32_t i = 0; i < pieces.size(); i++)
+    {
+        queued.push_back(static_cast<uint32_t>(pieces.size() - 1 - i));
+    }
+
+    uint32_t inFlight = 0;
+    // handles every completion the kernel posted so far, pieces that need another go are queued again
+    auto reap = [&]()
+    {
+        unsigned head = *ring.cqHead;
+        unsigned completedTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != completedTail; head++)
+        {
+            const io_uring_cqe &cqe = ring.cqes[head & *ring.cqMask];
+            uint32_t pieceIndex = static_cast<uint32_t>(cqe.user_data);
+            Piece &piece = pieces[pieceIndex];
+            Read &read = _reads[piece.read];
+            inFlight--;
+            piece.done = true;
+
+            if (cqe.res > 0)
+            {
+                read.bytesRead += cqe.res;
+                // buffered reads can come back short before the end of the file, read the rest.
+                // direct reads only come back short at the end of the file
+                if (uint64_t(cqe.res) < piece.size && !read.direct)
+                {
+                    piece.offset += cqe.res;
+                    piece.destination += cqe.res;
+                    piece.size -= cqe.res;
+                    piece.done = false;
+                    queued.push_back(pieceIndex);
+                }
+            }
+            else if (cqe.res == -EAGAIN || cqe.res == -EINTR)
+            {
+                piece.done = false;
+                queued.push_back(pieceIndex);
+            }
+            else if (cqe.res < 0)
+            {
+                // kernels before 5.6 dont know IORING_OP_READ, read that piece the slow way
+                int64_t count = read_at(piece.fd, piece.offset, piece.size, piece.destination);
+                if (count < 0)
+                {
+                    read.failed = true;
+                }
+                else
+                {
+                    read.bytesRead += count;
+                }
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    };
+
+    while (!queued.empty() || inFlight > 0)
+    {
+        // fill the submission queue, the completion queue is twice as big so it can never overflow
+        unsigned tail = *ring.sqTail;
+        while (!queued.empty() && inFlight < ring.entries)
+        {
+            uint32_t pieceIndex = queued.back();
+            queued.pop_back();
+            Piece &piece = pieces[pieceIndex];
+
+            unsigned index = tail & *ring.sqMask;
+            io_uring_sqe &sqe = ring.sqes[index];
+            memset(&sqe, 0, sizeof(io_uring_sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = piece.fd;
+            sqe.off = piece.offset;
+            sqe.addr = (uint64_t)piece.destination;
+            sqe.len = static_cast<uint32_t>(piece.size);
+            sqe.user_data = pieceIndex;
+            ring.sqArray[index] = index;
+
+            tail++;
+            inFlight++;
+        }
+        __atomic_store_n(ring.sqTail, tail, __ATOMIC_RELEASE);
+
+        unsigned toSubmit = tail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+        int entered = static_cast<int>(syscall(__NR_io_uring_enter, ring.fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // only happens when the ring itself is broken
+            std::cout << "io_uring_enter failed, falling back to pread: " << strerror(errno) << std::endl;
+
+            // what the kernel never took off the submission queue is not in flight. Reads it did take keep writing into
+            // their destinations even after the ring is closed, and bounce buffers are freed right after this returns,
+            // so every one of them has to complete first. Yielding enters the kernel, which lets it post them
+            inFlight -= tail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+            while (inFlight > 0)
+            {
+                uint32_t before = inFlight;
+                reap();
+                if (inFlight == before)
+                {
+                    std::this_thread::yield();
+                }
+            }
+            destroy_ring(_ring);
+            _ring = nullptr;
+
+            // every piece that did not complete, or only partly, is read again with pread
+            for (Piece &piece : pieces)
+            {
+                if (piece.done)
+                    continue;
+
+                Read &read = _reads[piece.read];
+                int64_t count = read_at(piece.fd, piece.offset, piece.size, piece.destination);
+                if (count < 0)
+                {
+                    read.failed = true;
+                }
+                else
+                {
+                    read.bytesRead += count;
+                }
+            }
+            break;
+        }
+
+        reap();
+    }
+
+    bool success = true;
+    for (auto &read : _reads)
+    {
+        success = success && !read.failed;
+    }
+    return success;
+#else
+    return false;
+#endif
+}
+
+uint32_t assets::load_binaryfiles(const std::vector<std::string> &paths, std::vector<AssetFile> &files, std::vector<bool> &loaded, const BatchLoadOptions &options)
+{
+    BatchFileReader reader;
+    reader.init(options.queueDepth);
+    return load_binaryfiles(reader, paths, files, loaded, options);
+}
+
+uint32_t assets::load_binaryfiles(BatchFileReader &reader, const std::vector<std::string> &paths, std::vector<AssetFile> &files, std::vector<bool> &loaded, const BatchLoadOptions &options)
+{
+    files.assign(paths.size(), AssetFile{});
+    loaded.assign(paths.size(), false);
+
+    uint32_t loadedCount = 0;
+    for (size_t first = 0; first < paths.size(); first += MAX_BATCH_FILES)
+    {
+        size_t count = std::min(paths.size() - first, MAX_BATCH_FILES);
+
+        // first batch, the start of every file
+        std::vector<int> handles(count, -1);
+        std::vector<char> headers(count * ASSET_HEADER_PEEK_SIZE);
+        std::vector<size_t> headerReads(count, SIZE_MAX);
+        size_t readCount = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            // the blob is most of the file, small files never get a direct handle they would not use
+            handles[i] = reader.open_file(paths[first + i].c_str(), options.directReadMinSize);
+            if (handles[i] < 0)
+            {
+                std::cout << "Error when opening asset " << paths[first + i] << std::endl;
+                continue;
+            }
+            reader.add_read(handles[i], 0, ASSET_HEADER_PEEK_SIZE, headers.data() + i * ASSET_HEADER_PEEK_SIZE);
+            headerReads[i] = readCount++;
+        }
+        reader.submit();
+
+        // sizes have to be taken before the next add_read starts a new batch
+        std::vector<size_t> headerSizes(count, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (headerReads[i] != SIZE_MAX)
+            {
+                headerSizes[i] = static_cast<size_t>(reader.bytes_read(headerReads[i]));
+            }
+        }
+
+        // second batch, every section of every file that has a valid header
+        struct SectionReads
+        {
+            size_t first;
+            size_t count;
+        };
+        std::vector<SectionReads> sectionReads(count, {0, 0});
+        std::vector<uint64_t> sectionSizes;
+        readCount = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (headerReads[i] == SIZE_MAX)
+                continue;
+
+            AssetFileLayout layout;
+            if (!parse_asset_layout(headers.data() + i * ASSET_HEADER_PEEK_SIZE, headerSizes[i], layout) || !layout.fits(reader.file_size(handles[i])))
+            {
+                std::cout << "Invalid or truncated asset file: " << paths[first + i] << std::endl;
+                headerReads[i] = SIZE_MAX;
+                continue;
+            }
+
+            AssetFile &file = files[first + i];
+            memcpy(file.type, layout.type, 4);
+            file.version = layout.version;
+            file.dictionaryId = layout.dictionaryId;
+            file.binaryMetadata.resize(layout.binaryMetadataSize);
+            file.json.resize(layout.jsonSize);
+            file.binaryBlob.resize(layout.blobSize);
+
+            sectionReads[i].first = readCount;
+            auto add_section = [&](uint64_t offset, uint64_t size, char *destination, bool direct)
+            {
+                if (size == 0)
+                    return;
+                reader.add_read(handles[i], offset, size, destination, direct);
+                sectionSizes.push_back(size);
+                sectionReads[i].count++;
+                readCount++;
+            };
+            bool directBlob = options.directReadMinSize != 0 && layout.blobSize >= options.directReadMinSize;
+            add_section(layout.binaryMetadataOffset, layout.binaryMetadataSize, file.binaryMetadata.data(), false);
+            add_section(layout.jsonOffset, layout.jsonSize, file.json.data(), false);
+            add_section(layout.blobOffset, layout.blobSize, file.binaryBlob.data(), directBlob);
+        }
+        if (readCount > 0)
+        {
+            reader.submit();
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (headerReads[i] == SIZE_MAX)
+                continue;
+
+            bool complete = true;
+            for (size_t r = sectionReads[i].first; r < sectionReads[i].first + sectionReads[i].count; r++)
+            {
+                complete = complete && reader.bytes_read(r) == sectionSizes[r];
+            }
+
+            if (complete)
+            {
+                loaded[first + i] = true;
+                loadedCount++;
+            }
+            else
+            {
+                std::cout << "Error when reading asset " << paths[first + i] << std::endl;
+                files[first + i] = AssetFile{};
+            }
+        }
+
+        reader.close_files();
+    }
+
+    return loadedCount;
+}
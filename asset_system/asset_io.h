@@ -0,0 +1,99 @@
+#pragma once
+#include "asset_loader.h"
+
+namespace assets
+{
+    // O_DIRECT reads have to start, end and land on this alignment
+    constexpr uint64_t DIRECT_READ_ALIGNMENT = 4096;
+
+    // the mapped io_uring queues, only exists on linux
+    struct IoUring;
+
+    // reads ranges of many files with as many reads in flight as the queue depth allows.
+    // on linux the reads go through io_uring, everywhere else, or when the kernel refuses to set up a ring, they are done
+    // one at a time with pread. Not thread safe, every thread needs its own reader
+    class BatchFileReader
+    {
+    public:
+        BatchFileReader() = default;
+        ~BatchFileReader();
+        BatchFileReader(const BatchFileReader &) = delete;
+        BatchFileReader &operator=(const BatchFileReader &) = delete;
+
+        // queueDepth is the most reads that are submitted to the kernel at once
+        void init(uint32_t queueDepth = 64);
+        void cleanup();
+
+        // returns the index of the file to read from, -1 if it cant be opened.
+        // files of at least directMinSize bytes are also opened with O_DIRECT, for reads that should not go through
+        // the page cache. 0 never opens direct
+        int open_file(const char *path, uint64_t directMinSize = 0);
+        uint64_t file_size(int file) const;
+        // closes every open file, indices are reused after this
+        void close_files();
+
+        // queues a read, nothing is read until submit. Direct reads get widened to the alignment
+        // and go through a bounce buffer, so destination and offset can be anything
+        void add_read(int file, uint64_t offset, uint64_t size, char *destination, bool direct = false);
+        // runs every queued read and waits for them. Reads past the end of the file are short instead of failing,
+        // bytes_read tells how much each one got. Returns false if any read failed.
+        // If the ring breaks, the reads it did not finish are done with pread, and so is every later submit
+        bool submit();
+        // bytes read by the nth read of the last submit
+        uint64_t bytes_read(size_t read) const;
+
+        bool using_io_uring() const { return _ring != nullptr; }
+
+    private:
+        struct OpenFile
+        {
+            uint64_t size{0};
+            // file descriptors on posix, HANDLEs on windows
+            intptr_t handle{-1};
+            intptr_t directHandle{-1};
+        };
+
+        struct Read
+        {
+            int file;
+            uint64_t offset;
+            uint64_t size;
+            char *destination;
+            bool direct;
+
+            uint64_t bytesRead;
+            bool failed;
+            // aligned copy of the range for direct reads
+            char *bounce;
+            uint64_t bounceOffset;
+            uint64_t bounceSize;
+        };
+
+        bool read_blocking(Read &read);
+        bool submit_ring();
+        void finish_read(Read &read);
+
+        std::vector<OpenFile> _files;
+        std::vector<Read> _reads;
+        uint32_t _queueDepth{64};
+        // the reads in _reads already ran, the next add_read starts a new batch
+        bool _submitted{false};
+        // nullptr when reads fall back to pread
+        IoUring *_ring{nullptr};
+    };
+
+    struct BatchLoadOptions
+    {
+        uint32_t queueDepth{64};
+        // blobs at least this big are read with O_DIRECT, so loading a level does not evict everything else
+        // from the page cache. 0 never reads direct
+        uint64_t directReadMinSize{0};
+    };
+
+    // loads many asset files at once with two batches of reads, first every header and then every section.
+    // files and loaded get one entry per path, returns how many files loaded
+    uint32_t load_binaryfiles(const std::vector<std::string> &paths, std::vector<AssetFile> &files, std::vector<bool> &loaded, const BatchLoadOptions &options = {});
+    // same, but reads through a reader that was already set up, so callers that load often keep one ring alive.
+    // The reader has no files open when it returns
+    uint32_t load_binaryfiles(BatchFileReader &reader, const std::vector<std::string> &paths, std::vector<AssetFile> &files, std::vector<bool> &loaded, const BatchLoadOptions &options = {});
+}
@@ -1,9 +1,31 @@
 #include "asset_loader.h"
+#include <lz4.h>
+#include <lz4hc.h>
 
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace assets;
 
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
 bool assets::save_binaryfile(const char *path, const AssetFile &file)
 {
     std::ofstream outfile;
@@ -11,68 +33,413 @@ bool assets::save_binaryfile(const char *path, const AssetFile &file)
     if (!outfile.is_open())
     {
         std::cout << "Error when trying to write file: " << path << std::endl;
+        return false;
     }
-    outfile.write(file.type, 4);
-    uint32_t version = file.version;
-    // version
-    outfile.write((const char *)&version, sizeof(uint32_t));
 
-    // json lenght
-    uint32_t length = static_cast<uint32_t>(file.json.size());
-    outfile.write((const char *)&length, sizeof(uint32_t));
+    write_binaryfile(outfile, file);
 
-    // blob lenght
-    uint32_t bloblength = static_cast<uint32_t>(file.binaryBlob.size());
-    outfile.write((const char *)&bloblength, sizeof(uint32_t));
+    outfile.close();
+
+    return !outfile.fail();
+}
+
+bool assets::write_binaryfile(std::ostream &outfile, const AssetFile &file)
+{
+    AssetHeaderV2 header;
+    memcpy(header.magic, ASSET_V2_MAGIC, 4);
+    memcpy(header.type, file.type, 4);
+    header.version = file.version;
+    header.headerSize = sizeof(AssetHeaderV2);
+    header.binaryMetadataSize = file.binaryMetadata.size();
+    header.jsonSize = file.json.size();
+    header.blobSize = file.binaryBlob.size();
+    header.dictionaryId = file.dictionaryId;
+    header.reserved = 0;
+    outfile.write((const char *)&header, sizeof(AssetHeaderV2));
+
+    // binary metadata and json
+    outfile.write(file.binaryMetadata.data(), file.binaryMetadata.size());
+    outfile.write(file.json.data(), file.json.size());
+
+    // pad so the blob starts aligned
+    uint64_t metadataEnd = sizeof(AssetHeaderV2) + header.binaryMetadataSize + header.jsonSize;
+    char padding[ASSET_V2_BLOB_ALIGNMENT] = {};
+    outfile.write(padding, align_up(metadataEnd, ASSET_V2_BLOB_ALIGNMENT) - metadataEnd);
 
-    // json stream
-    outfile.write(file.json.data(), length);
     // pixel data
     outfile.write(file.binaryBlob.data(), file.binaryBlob.size());
 
-    outfile.close();
+    return !outfile.fail();
+}
+
+bool assets::parse_asset_layout(const char *header, size_t size, AssetFileLayout &layout)
+{
+    if (size >= offsetof(AssetHeaderV2, dictionaryId) && memcmp(header, ASSET_V2_MAGIC, 4) == 0)
+    {
+        AssetHeaderV2 v2 = {};
+        memcpy(&v2, header, std::min(size, sizeof(AssetHeaderV2)));
+        if (v2.headerSize < sizeof(AssetHeaderV2))
+        {
+            v2.dictionaryId = 0;
+        }
+
+        memcpy(layout.type, v2.type, 4);
+        layout.version = v2.version;
+        layout.binaryMetadataOffset = v2.headerSize;
+        layout.binaryMetadataSize = v2.binaryMetadataSize;
+        layout.jsonOffset = layout.binaryMetadataOffset + v2.binaryMetadataSize;
+        layout.jsonSize = v2.jsonSize;
+        layout.blobOffset = align_up(layout.jsonOffset + v2.jsonSize, ASSET_V2_BLOB_ALIGNMENT);
+        layout.blobSize = v2.blobSize;
+        layout.dictionaryId = v2.dictionaryId;
+        return true;
+    }
 
+    // v1 header is type, version, json length and blob length
+    constexpr size_t headerSize = 4 + sizeof(uint32_t) * 3;
+    if (size < headerSize)
+        return false;
+
+    memcpy(layout.type, header, 4);
+    memcpy(&layout.version, header + 4, sizeof(uint32_t));
+
+    uint32_t jsonlen = 0;
+    memcpy(&jsonlen, header + 8, sizeof(uint32_t));
+
+    uint32_t bloblen = 0;
+    memcpy(&bloblen, header + 12, sizeof(uint32_t));
+
+    layout.binaryMetadataOffset = headerSize;
+    layout.binaryMetadataSize = 0;
+    layout.jsonOffset = headerSize;
+    layout.jsonSize = jsonlen;
+    layout.blobOffset = headerSize + uint64_t(jsonlen);
+    layout.blobSize = bloblen;
+    layout.dictionaryId = 0;
+
+    // v1 files can carry the binary metadata block at the start of the json section
+    if (jsonlen >= sizeof(BinaryMetadataHeader) && size >= headerSize + sizeof(BinaryMetadataHeader))
+    {
+        BinaryMetadataHeader metadataHeader;
+        memcpy(&metadataHeader, header + headerSize, sizeof(BinaryMetadataHeader));
+        if (memcmp(metadataHeader.magic, BINARY_METADATA_MAGIC, 4) == 0 && metadataHeader.size <= jsonlen - sizeof(BinaryMetadataHeader))
+        {
+            uint64_t blockSize = sizeof(BinaryMetadataHeader) + metadataHeader.size;
+            layout.binaryMetadataOffset = headerSize + sizeof(BinaryMetadataHeader);
+            layout.binaryMetadataSize = metadataHeader.size;
+            layout.jsonOffset = headerSize + blockSize;
+            layout.jsonSize = jsonlen - blockSize;
+        }
+    }
     return true;
 }
 
+static bool section_fits(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool AssetFileLayout::fits(uint64_t fileSize) const
+{
+    return section_fits(binaryMetadataOffset, binaryMetadataSize, fileSize) && section_fits(jsonOffset, jsonSize, fileSize) &&
+           section_fits(blobOffset, blobSize, fileSize);
+}
+
 bool assets::load_binaryfile(const char *path, AssetFile &outputFile)
 {
-    std::ifstream infile;
-    infile.open(path, std::ios::binary);
+    AssetReader reader;
+    if (!reader.open(path))
+        return false;
+
+    const AssetFileLayout &layout = reader.layout();
+    memcpy(outputFile.type, layout.type, 4);
+    outputFile.version = layout.version;
+    outputFile.dictionaryId = layout.dictionaryId;
+
+    if (!reader.read_binary_metadata(outputFile.binaryMetadata) || !reader.read_json(outputFile.json))
+        return false;
+
+    outputFile.binaryBlob.resize(layout.blobSize);
+    return reader.read_blob(0, layout.blobSize, outputFile.binaryBlob.data());
+}
+
+bool assets::map_file(const char *path, FileMapping &mapping, MapAccess access)
+{
+#ifdef _WIN32
+    DWORD accessFlag = access == MapAccess::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+    HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, accessFlag, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
 
-    if (!infile.is_open())
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
         return false;
+    }
 
-    infile.seekg(0);
+    HANDLE mappingObject = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // the mapping object keeps the file alive, so the file handle is not needed anymore
+    CloseHandle(fileHandle);
+    if (!mappingObject)
+        return false;
 
-    infile.read(outputFile.type, 4);
+    void *mapped = MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped)
+    {
+        CloseHandle(mappingObject);
+        return false;
+    }
+    mapping.data = (const char *)mapped;
+    mapping.size = static_cast<size_t>(fileSize.QuadPart);
+    mapping.handle = mappingObject;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
 
-    infile.read((char *)&outputFile.version, sizeof(uint32_t));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    size_t mappedSize = static_cast<size_t>(st.st_size);
 
-    uint32_t jsonlen = 0;
-    infile.read((char *)&jsonlen, sizeof(uint32_t));
+    void *addr = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
 
-    uint32_t bloblen = 0;
-    infile.read((char *)&bloblen, sizeof(uint32_t));
+    // texture pages get decompressed front to back, let the kernel read ahead aggressively.
+    // read ahead on randomly accessed files only pulls in pages nobody asked for
+    madvise(addr, mappedSize, access == MapAccess::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    mapping.data = (const char *)addr;
+    mapping.size = mappedSize;
+    mapping.handle = nullptr;
+#endif
+    return true;
+}
 
-    outputFile.json.resize(jsonlen);
+void assets::unmap_file(FileMapping &mapping)
+{
+    if (mapping.data)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping.data);
+        CloseHandle((HANDLE)mapping.handle);
+#else
+        munmap((void *)mapping.data, mapping.size);
+#endif
+    }
+    mapping = {};
+}
+
+bool assets::view_binaryfile(const char *data, size_t size, MappedAssetFile &outputFile)
+{
+    AssetFileLayout layout;
+    if (!parse_asset_layout(data, std::min(size, ASSET_HEADER_PEEK_SIZE), layout))
+        return false;
 
-    infile.read(outputFile.json.data(), jsonlen);
+    // truncated file, the sections would point outside of the memory
+    if (!layout.fits(size))
+        return false;
 
-    outputFile.binaryBlob.resize(bloblen);
-    infile.read(outputFile.binaryBlob.data(), bloblen);
+    memcpy(outputFile.type, layout.type, 4);
+    outputFile.version = layout.version;
+    outputFile.binaryMetadata = std::string_view(data + layout.binaryMetadataOffset, layout.binaryMetadataSize);
+    outputFile.json = std::string_view(data + layout.jsonOffset, layout.jsonSize);
+    outputFile.binaryBlob = data + layout.blobOffset;
+    outputFile.binaryBlobSize = layout.blobSize;
+    outputFile.dictionaryId = layout.dictionaryId;
 
     return true;
 }
 
+bool assets::map_binaryfile(const char *path, MappedAssetFile &outputFile)
+{
+    if (!map_file(path, outputFile.mapping))
+        return false;
+
+    if (!view_binaryfile(outputFile.mapping.data, outputFile.mapping.size, outputFile))
+    {
+        std::cout << "Invalid or truncated asset file: " << path << std::endl;
+        unmap_binaryfile(outputFile);
+        return false;
+    }
+    return true;
+}
+
+void assets::unmap_binaryfile(MappedAssetFile &file)
+{
+    unmap_file(file.mapping);
+
+    file.json = {};
+    file.binaryMetadata = {};
+    file.binaryBlob = nullptr;
+    file.binaryBlobSize = 0;
+}
+
 assets::CompressionMode assets::parse_compression(const char *f)
 {
     if (strcmp(f, "LZ4") == 0)
     {
         return assets::CompressionMode::LZ4;
     }
+    else if (strcmp(f, "LZ4HC") == 0)
+    {
+        return assets::CompressionMode::LZ4HC;
+    }
     else
     {
         return assets::CompressionMode::None;
     }
 }
+
+const char *assets::compression_name(CompressionMode mode)
+{
+    switch (mode)
+    {
+    case CompressionMode::LZ4:
+        return "LZ4";
+    case CompressionMode::LZ4HC:
+        return "LZ4HC";
+    default:
+        return "None";
+    }
+}
+
+int assets::compress_block(const CompressionPolicy &policy, const char *source, char *destination, int sourceSize, int destinationCapacity)
+{
+    int level = policy.level != 0 ? policy.level : LZ4HC_CLEVEL_DEFAULT;
+    if (!policy.dictionary)
+    {
+        if (policy.mode == CompressionMode::LZ4HC)
+        {
+            return LZ4_compress_HC(source, destination, sourceSize, destinationCapacity, level);
+        }
+        return LZ4_compress_default(source, destination, sourceSize, destinationCapacity);
+    }
+
+    // blocks stay independent, so the stream starts from just the dictionary for every one of them.
+    // the streams are big, keep one per thread around instead of allocating per block
+    const char *dictionary = policy.dictionary->data.data();
+    int dictionarySize = static_cast<int>(policy.dictionary->data.size());
+    if (policy.mode == CompressionMode::LZ4HC)
+    {
+        thread_local std::unique_ptr<LZ4_streamHC_t, int (*)(LZ4_streamHC_t *)> stream{LZ4_createStreamHC(), LZ4_freeStreamHC};
+        LZ4_resetStreamHC_fast(stream.get(), level);
+        LZ4_loadDictHC(stream.get(), dictionary, dictionarySize);
+        return LZ4_compress_HC_continue(stream.get(), source, destination, sourceSize, destinationCapacity);
+    }
+
+    thread_local std::unique_ptr<LZ4_stream_t, int (*)(LZ4_stream_t *)> stream{LZ4_createStream(), LZ4_freeStream};
+    LZ4_loadDict(stream.get(), dictionary, dictionarySize);
+    return LZ4_compress_fast_continue(stream.get(), source, destination, sourceSize, destinationCapacity, 1);
+}
+
+bool assets::decompress_block(const CompressionDictionary *dictionary, const char *source, char *destination, int compressedSize, int originalSize)
+{
+    int decompressed;
+    if (dictionary)
+    {
+        decompressed = LZ4_decompress_safe_usingDict(source, destination, compressedSize, originalSize, dictionary->data.data(), static_cast<int>(dictionary->data.size()));
+    }
+    else
+    {
+        decompressed = LZ4_decompress_safe(source, destination, compressedSize, originalSize);
+    }
+    return decompressed == originalSize;
+}
+
+bool AssetReader::open(const char *path)
+{
+    _file.open(path, std::ios::binary);
+    if (!_file.is_open())
+        return false;
+
+    char header[ASSET_HEADER_PEEK_SIZE];
+    _file.read(header, ASSET_HEADER_PEEK_SIZE);
+    size_t headerSize = static_cast<size_t>(_file.gcount());
+    _file.clear();
+
+    _file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(_file.tellg());
+
+    if (!parse_asset_layout(header, headerSize, _layout) || !_layout.fits(fileSize))
+    {
+        std::cout << "Invalid or truncated asset file: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AssetReader::close()
+{
+    _file.close();
+    _layout = {};
+    _chunk.clear();
+    _chunk.shrink_to_fit();
+}
+
+bool AssetReader::read_range(uint64_t offset, uint64_t size, char *destination)
+{
+    _file.seekg(static_cast<std::streamoff>(offset));
+    _file.read(destination, static_cast<std::streamsize>(size));
+    if (_file.fail())
+    {
+        // a short read leaves the stream failed, which would fail every read after it too
+        std::cout << "Short read of " << size << " bytes at offset " << offset << " of an asset file" << std::endl;
+        _file.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AssetReader::read_json(std::string &json)
+{
+    json.resize(_layout.jsonSize);
+    return read_range(_layout.jsonOffset, _layout.jsonSize, json.data());
+}
+
+bool AssetReader::read_binary_metadata(std::vector<char> &metadata)
+{
+    metadata.resize(_layout.binaryMetadataSize);
+    return read_range(_layout.binaryMetadataOffset, _layout.binaryMetadataSize, metadata.data());
+}
+
+bool AssetReader::read_blob(uint64_t offset, uint64_t size, char *destination)
+{
+    if (!section_fits(offset, size, _layout.blobSize))
+        return false;
+
+    return read_range(_layout.blobOffset + offset, size, destination);
+}
+
+bool AssetReader::stream_blob(uint64_t offset, uint64_t size, size_t chunkSize, const std::function<bool(const char *data, size_t size)> &callback)
+{
+    if (!section_fits(offset, size, _layout.blobSize) || chunkSize == 0)
+        return false;
+
+    _chunk.resize(static_cast<size_t>(std::min<uint64_t>(chunkSize, size)));
+
+    _file.seekg(static_cast<std::streamoff>(_layout.blobOffset + offset));
+    while (size > 0)
+    {
+        size_t readSize = static_cast<size_t>(std::min<uint64_t>(chunkSize, size));
+        _file.read(_chunk.data(), readSize);
+        if (_file.fail())
+        {
+            _file.clear();
+            return false;
+        }
+
+        if (!callback(_chunk.data(), readSize))
+            return false;
+
+        size -= readSize;
+    }
+    return true;
+}
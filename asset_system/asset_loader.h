@@ -1,6 +1,10 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 
 namespace assets
 {
@@ -10,16 +14,181 @@ namespace assets
         uint32_t version;
         std::string json;
         std::vector<char> binaryBlob;
+        // optional fixed layout metadata, read in place instead of parsing the json.
+        // when it is present the json is only kept for debugging and can be empty
+        std::vector<char> binaryMetadata;
+        // id of the shared dictionary the blob was compressed against, 0 for none
+        uint32_t dictionaryId{0};
+    };
+
+    // the binary metadata block is stored at the start of the json section, behind this header.
+    // json text can never start with the magic, so files without a binary block load exactly as before
+    struct BinaryMetadataHeader
+    {
+        char magic[4];
+        // size of the block, not counting this header
+        uint32_t size;
+    };
+    constexpr char BINARY_METADATA_MAGIC[4] = {'B', 'M', 'E', 'T'};
+
+    // header of the v2 container, which save_binaryfile writes. Sizes are 64 bit, and the sections follow
+    // the header in order: binary metadata, json, then the blob starting at the next 16 byte boundary.
+    // v1 files start straight with the asset type and store 32 bit sizes, they are still readable
+    struct AssetHeaderV2
+    {
+        char magic[4];
+        char type[4];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t binaryMetadataSize;
+        uint64_t jsonSize;
+        uint64_t blobSize;
+        // files written before dictionaries existed have a smaller headerSize and no id
+        uint32_t dictionaryId;
+        uint32_t reserved;
+    };
+    constexpr char ASSET_V2_MAGIC[4] = {'A', 'S', 'T', '2'};
+    constexpr uint64_t ASSET_V2_BLOB_ALIGNMENT = 16;
+
+    // enough bytes from the start of a file to find all its sections, for either container version
+    constexpr size_t ASSET_HEADER_PEEK_SIZE = sizeof(AssetHeaderV2);
+
+    // where every section of an asset file lives, as absolute file offsets
+    struct AssetFileLayout
+    {
+        char type[4];
+        uint32_t version;
+        uint64_t binaryMetadataOffset;
+        uint64_t binaryMetadataSize;
+        uint64_t jsonOffset;
+        uint64_t jsonSize;
+        uint64_t blobOffset;
+        uint64_t blobSize;
+        uint32_t dictionaryId;
+
+        // every section lies inside a file of that size. Each size is checked against what is left of the file
+        // instead of adding them up, so sizes from a corrupt header cant wrap around and pass
+        bool fits(uint64_t fileSize) const;
+    };
+
+    // how a mapping is going to be read, so the os reads ahead only when it pays off
+    enum class MapAccess : uint32_t
+    {
+        // front to back, like a single asset being decompressed
+        Sequential,
+        // jumping around, like entries of an archive
+        Random
+    };
+
+    // read-only os mapping of a whole file
+    struct FileMapping
+    {
+        const char *data{nullptr};
+        size_t size{0};
+        void *handle{nullptr};
+    };
+
+    // read-only view of an asset file that is memory mapped instead of copied.
+    // json and binaryBlob point straight into the mapping, so they are only valid until unmap_binaryfile
+    struct MappedAssetFile
+    {
+        char type[4];
+        uint32_t version;
+        std::string_view json;
+        std::string_view binaryMetadata;
+        const char *binaryBlob{nullptr};
+        size_t binaryBlobSize{0};
+        uint32_t dictionaryId{0};
+
+        // empty when the view points into memory owned by someone else, like an archive
+        FileMapping mapping;
     };
 
     enum class CompressionMode : uint32_t
     {
         None,
-        LZ4
+        LZ4,
+        // compressed harder when baking, but decompressed by the same fast lz4 decoder
+        LZ4HC
+    };
+
+    // a shared dictionary that small assets of one kind get compressed against,
+    // so the content all of them repeat is stored once instead of in every file
+    struct CompressionDictionary
+    {
+        // hash of the contents, recorded in every file compressed with it. 0 means no dictionary
+        uint32_t id{0};
+        std::vector<char> data;
     };
 
+    // how the baker compresses an asset. It only changes bake time and file size, never the load path
+    struct CompressionPolicy
+    {
+        CompressionMode mode{CompressionMode::LZ4};
+        // LZ4HC level, from LZ4HC_CLEVEL_MIN to LZ4HC_CLEVEL_MAX. 0 uses the lz4hc default
+        int level{0};
+        // data that doesnt compress below this ratio of its original size is stored raw
+        float maxRatio{0.8f};
+        // when set, every block is compressed against this dictionary
+        const CompressionDictionary *dictionary{nullptr};
+    };
+
+    // true for every mode the lz4 decoder handles
+    inline bool is_lz4_compressed(CompressionMode mode)
+    {
+        return mode == CompressionMode::LZ4 || mode == CompressionMode::LZ4HC;
+    }
+
     bool save_binaryfile(const char *path, const AssetFile &file);
+    bool write_binaryfile(std::ostream &outfile, const AssetFile &file);
     bool load_binaryfile(const char *path, AssetFile &outputFile);
 
+    // finds the sections from the first bytes of a file, size can be less than ASSET_HEADER_PEEK_SIZE for tiny files
+    bool parse_asset_layout(const char *header, size_t size, AssetFileLayout &layout);
+
+    bool map_file(const char *path, FileMapping &mapping, MapAccess access = MapAccess::Sequential);
+    void unmap_file(FileMapping &mapping);
+
+    // maps the file into memory and points the view at the json and blob sections, no copies are made
+    bool map_binaryfile(const char *path, MappedAssetFile &outputFile);
+    void unmap_binaryfile(MappedAssetFile &file);
+    // points the view at an asset file that is already in memory, the view does not own the memory
+    bool view_binaryfile(const char *data, size_t size, MappedAssetFile &outputFile);
+
     assets::CompressionMode parse_compression(const char *f);
-}
\ No newline at end of file
+    const char *compression_name(CompressionMode mode);
+
+    // compresses a single lz4 block following the policy. Returns the compressed size, 0 on failure.
+    // destination needs LZ4_compressBound(sourceSize) bytes
+    int compress_block(const CompressionPolicy &policy, const char *source, char *destination, int sourceSize, int destinationCapacity);
+    // decompresses a single lz4 block, dictionary must be the one it was compressed with or nullptr
+    bool decompress_block(const CompressionDictionary *dictionary, const char *source, char *destination, int compressedSize, int originalSize);
+
+    // reads an asset file piece by piece instead of loading it whole,
+    // so huge assets can be loaded with a fixed memory budget
+    class AssetReader
+    {
+    public:
+        bool open(const char *path);
+        void close();
+
+        const AssetFileLayout &layout() const { return _layout; }
+
+        bool read_json(std::string &json);
+        bool read_binary_metadata(std::vector<char> &metadata);
+
+        // reads a range of the blob straight into destination
+        bool read_blob(uint64_t offset, uint64_t size, char *destination);
+
+        // reads a range of the blob in pieces of at most chunkSize bytes, calling the callback for each one in order.
+        // only one chunk is resident at a time, returning false from the callback stops the read
+        bool stream_blob(uint64_t offset, uint64_t size, size_t chunkSize, const std::function<bool(const char *data, size_t size)> &callback);
+
+    private:
+        bool read_range(uint64_t offset, uint64_t size, char *destination);
+
+        std::ifstream _file;
+        AssetFileLayout _layout{};
+        std::vector<char> _chunk;
+    };
+}
@@ -0,0 +1,225 @@
+#include "asset_streamer.h"
+
+#include <exception>
+#include <iostream>
+
+using namespace assets;
+
+void AssetStreamer::init(uint32_t workerCount, const BatchLoadOptions &loadOptions)
+{
+    if (workerCount == 0)
+    {
+        uint32_t cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    _stopping = false;
+    _workerCount = workerCount;
+    _loadOptions = loadOptions;
+    _decodePool.init();
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        _workers.emplace_back([this]()
+                              { worker_loop(); });
+    }
+}
+
+void AssetStreamer::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stopping = true;
+
+        while (!_queue.empty())
+        {
+            _queue.top()->status.store(LoadStatus::Cancelled, std::memory_order_release);
+            _queue.pop();
+            _pendingCount--;
+        }
+    }
+    _wakeWorkers.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+    _workers.clear();
+    _decodePool.shutdown();
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _workerCount = 0;
+    }
+    _idle.notify_all();
+}
+
+StreamHandle AssetStreamer::request(const std::string &path, LoadPriority priority, DecodeFunction decode)
+{
+    StreamHandle handle = std::make_shared<StreamedAsset>();
+    handle->path = path;
+    handle->priority = priority;
+    handle->decode = std::move(decode);
+    return queue_request(std::move(handle));
+}
+
+StreamHandle AssetStreamer::request_mapped(const std::string &path, LoadPriority priority, CheckFunction check)
+{
+    StreamHandle handle = std::make_shared<StreamedAsset>();
+    handle->path = path;
+    handle->priority = priority;
+    handle->map = true;
+    handle->check = std::move(check);
+    return queue_request(std::move(handle));
+}
+
+StreamHandle AssetStreamer::queue_request(StreamHandle handle)
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        if (_stopping || _workerCount == 0)
+        {
+            handle->status.store(LoadStatus::Cancelled, std::memory_order_release);
+            return handle;
+        }
+
+        handle->sequence = _nextSequence++;
+        _queue.push(handle);
+        _pendingCount++;
+    }
+    _wakeWorkers.notify_one();
+    return handle;
+}
+
+void AssetStreamer::wait_idle()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    _idle.wait(lock, [this]()
+               { return _pendingCount.load() == 0 || _workerCount == 0; });
+}
+
+// reads every page of the mapping in on the worker, so whoever decompresses it later does not wait on the disk
+static void fault_in(const char *data, size_t size)
+{
+    const volatile char *pages = data;
+    for (size_t offset = 0; offset < size; offset += 4096)
+    {
+        (void)pages[offset];
+    }
+}
+
+static bool map_asset(StreamedAsset &asset)
+{
+    if (!map_binaryfile(asset.path.c_str(), asset.mapped))
+    {
+        std::cout << "Error when streaming asset " << asset.path << std::endl;
+        return false;
+    }
+    fault_in(asset.mapped.mapping.data, asset.mapped.mapping.size);
+
+    if (!asset.check)
+        return true;
+    // an exception leaving the worker would terminate the process, like json parsing a malformed older file
+    try
+    {
+        return asset.check(asset.mapped);
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "Error when checking asset " << asset.path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+static bool decode_asset(StreamedAsset &asset, AssetFile &file, bool loaded)
+{
+    if (!loaded)
+    {
+        std::cout << "Error when streaming asset " << asset.path << std::endl;
+        return false;
+    }
+
+    asset.file = std::move(file);
+    if (!asset.decode)
+        return true;
+
+    bool success;
+    try
+    {
+        success = asset.decode(asset.file, asset.decoded);
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "Error when decoding asset " << asset.path << ": " << e.what() << std::endl;
+        return false;
+    }
+    if (success && !asset.decoded.empty())
+    {
+        std::vector<char>().swap(asset.file.binaryBlob);
+    }
+    return success;
+}
+
+void AssetStreamer::worker_loop()
+{
+    std::vector<StreamHandle> batch;
+    std::vector<std::string> paths;
+    std::vector<AssetFile> files;
+    std::vector<bool> loaded;
+    // one ring for the whole life of the worker, setting one up costs a few syscalls and mappings
+    BatchFileReader reader;
+    reader.init(_loadOptions.queueDepth);
+    while (true)
+    {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            _wakeWorkers.wait(lock, [this]()
+                              { return _stopping || !_queue.empty(); });
+            if (_stopping)
+                return;
+
+            // a fair share of the queue, so the reads of many assets go out together but the other workers still get some
+            size_t count = std::min<size_t>(std::max<size_t>(_queue.size() / _workerCount, 1), STREAM_BATCH_SIZE);
+            for (size_t i = 0; i < count; i++)
+            {
+                batch.push_back(_queue.top());
+                _queue.pop();
+            }
+        }
+
+        paths.clear();
+        for (auto &asset : batch)
+        {
+            asset->status.store(LoadStatus::Loading, std::memory_order_release);
+            if (!asset->map)
+            {
+                paths.push_back(asset->path);
+            }
+        }
+
+        if (!paths.empty())
+        {
+            load_binaryfiles(reader, paths, files, loaded, _loadOptions);
+        }
+
+        // decoded in priority order, the most urgent ones are ready first
+        size_t readIndex = 0;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            StreamedAsset &asset = *batch[i];
+            bool success = asset.map ? map_asset(asset) : decode_asset(asset, files[readIndex], loaded[readIndex]);
+            if (!asset.map)
+            {
+                readIndex++;
+            }
+            asset.decode = nullptr;
+            asset.check = nullptr;
+            asset.status.store(success ? LoadStatus::Ready : LoadStatus::Failed, std::memory_order_release);
+
+            {
+                std::lock_guard<std::mutex> lock{_mutex};
+                _pendingCount--;
+            }
+            _idle.notify_all();
+        }
+    }
+}
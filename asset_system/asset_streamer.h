@@ -0,0 +1,122 @@
+#pragma once
+#include "asset_loader.h"
+#include "asset_io.h"
+#include "asset_tasks.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace assets
+{
+    // higher priorities are picked up by the workers first, requests of the same priority in the order they were made
+    enum class LoadPriority : uint32_t
+    {
+        Low,
+        Normal,
+        High,
+        // needed before the next frame can be drawn
+        Critical
+    };
+
+    enum class LoadStatus : uint32_t
+    {
+        Pending,
+        Loading,
+        Ready,
+        Failed,
+        // the streamer was shut down before the request got picked up
+        Cancelled
+    };
+
+    // runs on the worker after the file is read, turning the file into whatever the engine uploads,
+    // like unpacked texture pixels. Returning false or throwing fails the request
+    using DecodeFunction = std::function<bool(const AssetFile &file, std::vector<char> &decoded)>;
+    // runs on the worker once a mapped file is faulted in, to reject files whoever asked for it could not use.
+    // Returning false or throwing fails the request
+    using CheckFunction = std::function<bool(const MappedAssetFile &file)>;
+
+    // one load request, shared between the streamer and whoever asked for it.
+    // file, decoded and mapped are written by the worker, only read them once status is Ready
+    struct StreamedAsset
+    {
+        ~StreamedAsset() { unmap_binaryfile(mapped); }
+
+        std::string path;
+        LoadPriority priority;
+        std::atomic<LoadStatus> status{LoadStatus::Pending};
+
+        AssetFile file;
+        // output of the decode function. When it is filled the compressed blob is freed, only the metadata is kept
+        std::vector<char> decoded;
+
+        // requests made with request_mapped fill mapped instead of file, it stays mapped until the handle is gone
+        bool map{false};
+        MappedAssetFile mapped;
+
+        DecodeFunction decode;
+        CheckFunction check;
+        // breaks ties between requests of the same priority
+        uint64_t sequence;
+
+        bool is_done() const { return status.load(std::memory_order_acquire) >= LoadStatus::Ready; }
+    };
+    using StreamHandle = std::shared_ptr<StreamedAsset>;
+
+    // most requests a worker takes at once. Their reads are all submitted together
+    constexpr uint32_t STREAM_BATCH_SIZE = 16;
+
+    // reads and decodes asset files on a pool of worker threads. The engine makes requests, keeps the handles
+    // and polls them every frame, uploading the ones that are done, so disk reads, decompression and gpu uploads overlap
+    class AssetStreamer
+    {
+    public:
+        // 0 workers uses one less than the core count, leaving a core for the main thread
+        void init(uint32_t workerCount = 0, const BatchLoadOptions &loadOptions = {});
+        // cancels every request that has not started, and waits for the ones being loaded
+        void shutdown();
+
+        StreamHandle request(const std::string &path, LoadPriority priority = LoadPriority::Normal, DecodeFunction decode = {});
+        // maps the file instead of reading it, and faults the mapping in on the worker. Whoever asked for it decompresses
+        // straight from the page cache, the blob never gets memory of its own
+        StreamHandle request_mapped(const std::string &path, LoadPriority priority = LoadPriority::Normal, CheckFunction check = {});
+
+        // requests that are queued or being loaded
+        uint32_t pending_count() const { return _pendingCount.load(std::memory_order_acquire); }
+        // blocks until every request made so far is done
+        void wait_idle();
+
+        // for decode functions that split one big asset over many cores, like unpack_texture.
+        // Shared by all workers, their calls take turns
+        TaskPool &decode_pool() { return _decodePool; }
+
+    private:
+        StreamHandle queue_request(StreamHandle handle);
+        void worker_loop();
+
+        struct RequestOrder
+        {
+            bool operator()(const StreamHandle &a, const StreamHandle &b) const
+            {
+                if (a->priority != b->priority)
+                    return a->priority < b->priority;
+                return a->sequence > b->sequence;
+            }
+        };
+
+        std::vector<std::thread> _workers;
+        TaskPool _decodePool;
+        uint32_t _workerCount{0};
+        BatchLoadOptions _loadOptions;
+        std::priority_queue<StreamHandle, std::vector<StreamHandle>, RequestOrder> _queue;
+        std::mutex _mutex;
+        std::condition_variable _wakeWorkers;
+        std::condition_variable _idle;
+        std::atomic<uint32_t> _pendingCount{0};
+        uint64_t _nextSequence{0};
+        bool _stopping{false};
+    };
+}
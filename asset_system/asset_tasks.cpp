@@ -0,0 +1,113 @@
+#include "asset_tasks.h"
+
+using namespace assets;
+
+TaskPool::~TaskPool()
+{
+    shutdown();
+}
+
+void TaskPool::init(uint32_t helperCount)
+{
+    if (helperCount == 0)
+    {
+        uint32_t cores = std::thread::hardware_concurrency();
+        helperCount = cores > 1 ? cores - 1 : 0;
+    }
+
+    _stopping = false;
+    for (uint32_t i = 0; i < helperCount; i++)
+    {
+        _helpers.emplace_back([this]()
+                              { helper_loop(); });
+    }
+}
+
+void TaskPool::shutdown()
+{
+    if (_helpers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stopping = true;
+    }
+    _wakeHelpers.notify_all();
+
+    for (auto &helper : _helpers)
+    {
+        helper.join();
+    }
+    _helpers.clear();
+}
+
+void TaskPool::parallel_for(uint32_t count, const std::function<void(uint32_t index)> &task)
+{
+    std::lock_guard<std::mutex> call{_callMutex};
+    if (_helpers.empty() || count <= 1)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _task = &task;
+        _count = count;
+        _next = 0;
+        _finished = 0;
+        _generation++;
+    }
+    _wakeHelpers.notify_all();
+
+    run_tasks();
+
+    // a helper can still be inside run_tasks after the last index finished, task has to outlive it
+    std::unique_lock<std::mutex> lock{_mutex};
+    _done.wait(lock, [&]()
+               { return _finished.load() == count && _busyHelpers == 0; });
+    _task = nullptr;
+}
+
+void TaskPool::run_tasks()
+{
+    uint32_t count = _count.load();
+    for (uint32_t i = _next++; i < count; i = _next++)
+    {
+        (*_task)(i);
+        if (++_finished == count)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _done.notify_all();
+        }
+    }
+}
+
+void TaskPool::helper_loop()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (true)
+    {
+        _wakeHelpers.wait(lock, [&]()
+                          { return _stopping || _generation != seen; });
+        if (_stopping)
+            return;
+
+        // a call that already finished has no task left, helpers only join one that is still running
+        seen = _generation;
+        if (!_task)
+            continue;
+        _busyHelpers++;
+        lock.unlock();
+        run_tasks();
+        lock.lock();
+        if (--_busyHelpers == 0)
+        {
+            _done.notify_all();
+        }
+    }
+}
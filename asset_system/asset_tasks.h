@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace assets
+{
+    // persistent helper threads that split one big piece of work, like the pages and blocks of a mip chain, over many cores.
+    // The thread that calls parallel_for works too. Calls from several threads are run one after another
+    class TaskPool
+    {
+    public:
+        TaskPool() = default;
+        ~TaskPool();
+        TaskPool(const TaskPool &) = delete;
+        TaskPool &operator=(const TaskPool &) = delete;
+
+        // 0 helpers uses one less than the core count, as the calling thread is the last one
+        void init(uint32_t helperCount = 0);
+        // joins the helpers, safe to call more than once. parallel_for keeps working on the calling thread alone
+        void shutdown();
+
+        // calls task with every index below count and returns once all of them are done
+        void parallel_for(uint32_t count, const std::function<void(uint32_t index)> &task);
+
+        uint32_t thread_count() const { return static_cast<uint32_t>(_helpers.size()) + 1; }
+
+    private:
+        void helper_loop();
+        // runs indices of the current call until there are none left
+        void run_tasks();
+
+        std::vector<std::thread> _helpers;
+        // only one parallel_for at a time
+        std::mutex _callMutex;
+        std::mutex _mutex;
+        std::condition_variable _wakeHelpers;
+        std::condition_variable _done;
+
+        const std::function<void(uint32_t)> *_task{nullptr};
+        std::atomic<uint32_t> _count{0};
+        std::atomic<uint32_t> _next{0};
+        std::atomic<uint32_t> _finished{0};
+        // bumped by every call, so helpers know there is new work
+        uint64_t _generation{0};
+        uint32_t _busyHelpers{0};
+        bool _stopping{false};
+    };
+}
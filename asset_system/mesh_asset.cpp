@@ -0,0 +1,783 @@
+#include "mesh_asset.h"
+#include "asset_dictionary.h"
+#include <json.hpp>
+#include <lz4.h>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <cfloat>
+
+using namespace assets;
+
+assets::VertexFormat assets::parse_vertex_format(const char *f)
+{
+    if (strcmp(f, "PNCV_F32") == 0)
+    {
+        return VertexFormat::PNCV_F32;
+    }
+    else if (strcmp(f, "P32N8C8V16") == 0)
+    {
+        return VertexFormat::P32N8C8V16;
+    }
+    else if (strcmp(f, "P16N16C8V16") == 0)
+    {
+        return VertexFormat::P16N16C8V16;
+    }
+    else if (strcmp(f, "P16N8V16") == 0)
+    {
+        return VertexFormat::P16N8V16;
+    }
+    else
+    {
+        return VertexFormat::Unknown;
+    }
+}
+
+const char *assets::vertex_format_name(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::PNCV_F32:
+        return "PNCV_F32";
+    case VertexFormat::P32N8C8V16:
+        return "P32N8C8V16";
+    case VertexFormat::P16N16C8V16:
+        return "P16N16C8V16";
+    case VertexFormat::P16N8V16:
+        return "P16N8V16";
+    default:
+        return "Unknown";
+    }
+}
+
+size_t assets::vertex_size(VertexFormat format)
+{
+    switch (format)
+    {
+    case VertexFormat::PNCV_F32:
+        return sizeof(Vertex_f32_PNCV);
+    case VertexFormat::P32N8C8V16:
+        return sizeof(Vertex_P32N8C8V16);
+    case VertexFormat::P16N16C8V16:
+        return sizeof(Vertex_P16N16C8V16);
+    case VertexFormat::P16N8V16:
+        return sizeof(Vertex_P16N8V16);
+    default:
+        return 0;
+    }
+}
+
+bool assets::is_position_quantized(VertexFormat format)
+{
+    return format == VertexFormat::P16N16C8V16 || format == VertexFormat::P16N8V16;
+}
+
+static MeshInfo parse_mesh_json(const char *jsonBegin, const char *jsonEnd)
+{
+    MeshInfo info;
+    nlohmann::json metadata = nlohmann::json::parse(jsonBegin, jsonEnd);
+
+    info.vertexBuferSize = metadata["vertex_buffer_size"];
+    info.indexBuferSize = metadata["index_buffer_size"];
+    info.indexSize = (uint8_t)metadata["index_size"];
+    info.originalFile = metadata["original_file"];
+
+    std::string compressionString = metadata["compression"];
+    info.compressionMode = parse_compression(compressionString.c_str());
+
+    std::string vertexFormat = metadata["vertex_format"];
+    info.vertexFormat = parse_vertex_format(vertexFormat.c_str());
+
+    info.blockSize = metadata.value("block_size", 0u);
+    info.vertexCompressedSize = metadata.value("vertex_compressed_size", info.vertexBuferSize);
+    info.indexCompressedSize = metadata.value("index_compressed_size", 0ull);
+    info.meshletCount = metadata.value("meshlet_count", 0u);
+    info.meshletVertexCount = metadata.value("meshlet_vertex_count", 0u);
+    info.meshletTriangleCount = metadata.value("meshlet_triangle_count", 0u);
+
+    std::vector<float> boundsData = metadata["bounds"];
+    info.bounds.origin[0] = boundsData[0];
+    info.bounds.origin[1] = boundsData[1];
+    info.bounds.origin[2] = boundsData[2];
+
+    info.bounds.radius = boundsData[3];
+
+    info.bounds.extents[0] = boundsData[4];
+    info.bounds.extents[1] = boundsData[5];
+    info.bounds.extents[2] = boundsData[6];
+
+    if (metadata.contains("lods"))
+    {
+        for (auto &lod : metadata["lods"])
+        {
+            info.lods.push_back(MeshLod{lod["index_offset"], lod["index_count"], lod.value("meshlet_offset", 0u), lod.value("meshlet_count", 0u), lod["error"]});
+        }
+    }
+
+    return info;
+}
+
+static bool read_mesh_binary(std::string_view binaryMetadata, MeshInfo &info)
+{
+    if (binaryMetadata.size() < sizeof(MeshMetadataBinary))
+        return false;
+
+    MeshMetadataBinary header;
+    memcpy(&header, binaryMetadata.data(), sizeof(MeshMetadataBinary));
+    size_t lodTableOffset = sizeof(MeshMetadataBinary) + header.originalFileLength;
+    if (lodTableOffset + size_t(header.lodCount) * sizeof(MeshLod) > binaryMetadata.size())
+        return false;
+
+    info.vertexBuferSize = header.vertexBufferSize;
+    info.indexBuferSize = header.indexBufferSize;
+    info.vertexCompressedSize = header.vertexCompressedSize;
+    info.indexCompressedSize = header.indexCompressedSize;
+    info.meshletCount = header.meshletCount;
+    info.meshletVertexCount = header.meshletVertexCount;
+    info.meshletTriangleCount = header.meshletTriangleCount;
+    info.bounds = header.bounds;
+    info.vertexFormat = VertexFormat(header.vertexFormat);
+    info.compressionMode = CompressionMode(header.compressionMode);
+    info.indexSize = static_cast<char>(header.indexSize);
+    info.blockSize = header.blockSize;
+    info.originalFile = std::string(binaryMetadata.data() + sizeof(MeshMetadataBinary), header.originalFileLength);
+    info.lods.resize(header.lodCount);
+    memcpy(info.lods.data(), binaryMetadata.data() + lodTableOffset, header.lodCount * sizeof(MeshLod));
+    return true;
+}
+
+static std::vector<char> write_mesh_binary(const MeshInfo &info)
+{
+    MeshMetadataBinary header = {};
+    header.vertexBufferSize = info.vertexBuferSize;
+    header.indexBufferSize = info.indexBuferSize;
+    header.vertexCompressedSize = info.vertexCompressedSize;
+    header.indexCompressedSize = info.indexCompressedSize;
+    header.meshletCount = info.meshletCount;
+    header.meshletVertexCount = info.meshletVertexCount;
+    header.meshletTriangleCount = info.meshletTriangleCount;
+    header.bounds = info.bounds;
+    header.vertexFormat = uint32_t(info.vertexFormat);
+    header.compressionMode = uint32_t(info.compressionMode);
+    header.indexSize = uint32_t(info.indexSize);
+    header.blockSize = info.blockSize;
+    header.originalFileLength = static_cast<uint32_t>(info.originalFile.size());
+    header.lodCount = static_cast<uint32_t>(info.lods.size());
+
+    size_t lodTableOffset = sizeof(MeshMetadataBinary) + info.originalFile.size();
+    std::vector<char> metadata(lodTableOffset + info.lods.size() * sizeof(MeshLod));
+    memcpy(metadata.data(), &header, sizeof(MeshMetadataBinary));
+    memcpy(metadata.data() + sizeof(MeshMetadataBinary), info.originalFile.data(), info.originalFile.size());
+    memcpy(metadata.data() + lodTableOffset, info.lods.data(), info.lods.size() * sizeof(MeshLod));
+    return metadata;
+}
+
+assets::MeshInfo assets::read_mesh_info(const AssetFile *file)
+{
+    MeshInfo info;
+    if (!read_mesh_binary(std::string_view(file->binaryMetadata.data(), file->binaryMetadata.size()), info))
+    {
+        info = parse_mesh_json(file->json.data(), file->json.data() + file->json.size());
+    }
+    info.dictionaryId = file->dictionaryId;
+    return info;
+}
+
+assets::MeshInfo assets::read_mesh_info(const MappedAssetFile *file)
+{
+    MeshInfo info;
+    if (!read_mesh_binary(file->binaryMetadata, info))
+    {
+        info = parse_mesh_json(file->json.data(), file->json.data() + file->json.size());
+    }
+    info.dictionaryId = file->dictionaryId;
+    return info;
+}
+
+// a stream is stored raw when its stored size matches the original size. Otherwise it is a sequence of blocks
+// of at most blockSize bytes, each one prefixed with its compressed size, and raw again if it did not shrink
+static void compress_stream(const CompressionPolicy &policy, const char *data, uint64_t size, uint32_t blockSize, std::vector<char> &output)
+{
+    size_t start = output.size();
+    if (policy.mode != CompressionMode::None)
+    {
+        std::vector<char> block_buffer;
+        uint64_t remaining = size;
+        const char *source = data;
+        while (remaining > 0)
+        {
+            uint32_t blockOriginal = static_cast<uint32_t>(std::min<uint64_t>(remaining, blockSize));
+            int compressStaging = LZ4_compressBound(blockOriginal);
+            block_buffer.resize(compressStaging);
+
+            uint32_t blockCompressed = compress_block(policy, source, block_buffer.data(), blockOriginal, compressStaging);
+            if (blockCompressed == 0 || blockCompressed >= blockOriginal)
+            {
+                blockCompressed = blockOriginal;
+                memcpy(block_buffer.data(), source, blockOriginal);
+            }
+
+            const char *sizeBytes = (const char *)&blockCompressed;
+            output.insert(output.end(), sizeBytes, sizeBytes + sizeof(uint32_t));
+            output.insert(output.end(), block_buffer.begin(), block_buffer.begin() + blockCompressed);
+
+            source += blockOriginal;
+            remaining -= blockOriginal;
+        }
+
+        uint64_t compressedSize = output.size() - start;
+        // not worth it, or exactly the original size, which would read back as raw
+        if (compressedSize < size && float(compressedSize) / float(size) <= policy.maxRatio)
+            return;
+
+        output.resize(start);
+    }
+    output.insert(output.end(), data, data + size);
+}
+
+static bool decompress_stream(const CompressionDictionary *dictionary, const char *source, uint64_t sourceSize, char *destination, uint64_t originalSize, uint32_t blockSize)
+{
+    if (sourceSize == originalSize)
+    {
+        memcpy(destination, source, originalSize);
+        return true;
+    }
+
+    const char *sourceEnd = source + sourceSize;
+    uint64_t remaining = originalSize;
+    while (remaining > 0)
+    {
+        uint32_t blockOriginal = static_cast<uint32_t>(std::min<uint64_t>(remaining, blockSize));
+        uint32_t blockCompressed;
+        if (source + sizeof(uint32_t) > sourceEnd)
+            return false;
+        memcpy(&blockCompressed, source, sizeof(uint32_t));
+        source += sizeof(uint32_t);
+
+        if (blockCompressed > blockOriginal || source + blockCompressed > sourceEnd)
+            return false;
+
+        if (blockCompressed == blockOriginal)
+        {
+            memcpy(destination, source, blockOriginal);
+        }
+        else if (!decompress_block(dictionary, source, destination, blockCompressed, blockOriginal))
+        {
+            return false;
+        }
+
+        source += blockCompressed;
+        destination += blockOriginal;
+        remaining -= blockOriginal;
+    }
+    return true;
+}
+
+size_t assets::meshlet_buffer_size(const MeshInfo &info)
+{
+    size_t triangleBytes = (size_t(info.meshletTriangleCount) * 3 + 3) & ~size_t(3);
+    return info.meshletCount * sizeof(Meshlet) + info.meshletVertexCount * sizeof(uint32_t) + triangleBytes;
+}
+
+assets::MeshletBufferView assets::read_meshlet_buffer(const MeshInfo &info, const char *meshletBuffer)
+{
+    MeshletBufferView view;
+    view.meshlets = reinterpret_cast<const Meshlet *>(meshletBuffer);
+    view.vertices = reinterpret_cast<const uint32_t *>(meshletBuffer + info.meshletCount * sizeof(Meshlet));
+    view.triangles = reinterpret_cast<const uint8_t *>(view.vertices + info.meshletVertexCount);
+    return view;
+}
+
+bool assets::unpack_mesh(MeshInfo *info, const char *sourcebuffer, size_t sourceSize, char *vertexBufer, char *indexBuffer, char *meshletBuffer)
+{
+    const CompressionDictionary *dictionary = nullptr;
+    if (info->dictionaryId != 0)
+    {
+        dictionary = find_dictionary(info->dictionaryId);
+        if (!dictionary)
+        {
+            std::cout << "Mesh " << info->originalFile << " needs dictionary " << info->dictionaryId << " which is not loaded" << std::endl;
+            return false;
+        }
+    }
+
+    // files without meshlets have the indices up to the end of the blob
+    uint64_t indexCompressedSize = info->indexCompressedSize != 0 ? info->indexCompressedSize : sourceSize - std::min<uint64_t>(info->vertexCompressedSize, sourceSize);
+    if (info->vertexCompressedSize > sourceSize || indexCompressedSize > sourceSize - info->vertexCompressedSize)
+        return false;
+
+    const char *indexSource = sourcebuffer + info->vertexCompressedSize;
+    const char *meshletSource = indexSource + indexCompressedSize;
+    uint64_t meshletCompressedSize = sourceSize - info->vertexCompressedSize - indexCompressedSize;
+    size_t meshletSize = meshlet_buffer_size(*info);
+
+    if (!is_lz4_compressed(info->compressionMode))
+    {
+        // raw data is stored as is, sizes that disagree mean a corrupt header that would read past the blob
+        if (info->vertexBuferSize != info->vertexCompressedSize || info->indexBuferSize != indexCompressedSize)
+            return false;
+        memcpy(vertexBufer, sourcebuffer, info->vertexBuferSize);
+        memcpy(indexBuffer, indexSource, info->indexBuferSize);
+        if (meshletBuffer && meshletSize <= meshletCompressedSize)
+        {
+            memcpy(meshletBuffer, meshletSource, meshletSize);
+        }
+        return !meshletBuffer || meshletSize <= meshletCompressedSize;
+    }
+
+    // files without blocks are a single lz4 block
+    uint32_t blockSize = info->blockSize != 0 ? info->blockSize : UINT32_MAX;
+    bool success = decompress_stream(dictionary, sourcebuffer, info->vertexCompressedSize, vertexBufer, info->vertexBuferSize, blockSize) &&
+                   decompress_stream(dictionary, indexSource, indexCompressedSize, indexBuffer, info->indexBuferSize, blockSize);
+    if (success && meshletBuffer)
+    {
+        success = decompress_stream(dictionary, meshletSource, meshletCompressedSize, meshletBuffer, meshletSize, blockSize);
+    }
+    return success;
+}
+
+assets::AssetFile assets::pack_mesh(MeshInfo *info, char *vertexData, char *indexData, const char *meshletData, const CompressionPolicy &policy, bool writeJson)
+{
+    AssetFile file;
+    file.type[0] = 'M';
+    file.type[1] = 'E';
+    file.type[2] = 'S';
+    file.type[3] = 'H';
+    file.version = 1;
+
+    info->blockSize = MESH_BLOCK_SIZE;
+    info->compressionMode = policy.mode;
+
+    // vertices, indices and meshlets are compressed as separate streams, so they unpack straight into their own buffers
+    compress_stream(policy, vertexData, info->vertexBuferSize, info->blockSize, file.binaryBlob);
+    info->vertexCompressedSize = file.binaryBlob.size();
+    compress_stream(policy, indexData, info->indexBuferSize, info->blockSize, file.binaryBlob);
+    info->indexCompressedSize = file.binaryBlob.size() - info->vertexCompressedSize;
+    if (meshletData)
+    {
+        compress_stream(policy, meshletData, meshlet_buffer_size(*info), info->blockSize, file.binaryBlob);
+    }
+
+    info->dictionaryId = policy.dictionary && policy.mode != CompressionMode::None ? policy.dictionary->id : 0;
+    file.dictionaryId = info->dictionaryId;
+    file.binaryMetadata = write_mesh_binary(*info);
+
+    if (!writeJson)
+    {
+        return file;
+    }
+
+    nlohmann::json metadata;
+    metadata["vertex_format"] = vertex_format_name(info->vertexFormat);
+    metadata["vertex_buffer_size"] = info->vertexBuferSize;
+    metadata["index_buffer_size"] = info->indexBuferSize;
+    metadata["index_size"] = info->indexSize;
+    metadata["original_file"] = info->originalFile;
+    metadata["compression"] = compression_name(info->compressionMode);
+    metadata["block_size"] = info->blockSize;
+    metadata["vertex_compressed_size"] = info->vertexCompressedSize;
+    metadata["index_compressed_size"] = info->indexCompressedSize;
+    metadata["meshlet_count"] = info->meshletCount;
+    metadata["meshlet_vertex_count"] = info->meshletVertexCount;
+    metadata["meshlet_triangle_count"] = info->meshletTriangleCount;
+
+    std::vector<float> boundsData;
+    boundsData.resize(7);
+
+    boundsData[0] = info->bounds.origin[0];
+    boundsData[1] = info->bounds.origin[1];
+    boundsData[2] = info->bounds.origin[2];
+
+    boundsData[3] = info->bounds.radius;
+
+    boundsData[4] = info->bounds.extents[0];
+    boundsData[5] = info->bounds.extents[1];
+    boundsData[6] = info->bounds.extents[2];
+
+    metadata["bounds"] = boundsData;
+
+    nlohmann::json lods = nlohmann::json::array();
+    for (const MeshLod &lod : info->lods)
+    {
+        lods.push_back({{"index_offset", lod.indexOffset}, {"index_count", lod.indexCount}, {"meshlet_offset", lod.meshletOffset}, {"meshlet_count", lod.meshletCount}, {"error", lod.error}});
+    }
+    metadata["lods"] = lods;
+
+    file.json = metadata.dump();
+
+    return file;
+}
+
+uint32_t assets::select_mesh_lod(const MeshInfo &info, float distance, float projectionScale, float maxScreenError)
+{
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < info.lods.size(); i++)
+    {
+        // errors only grow along the chain
+        float screenError = distance > 0 ? info.lods[i].error * projectionScale / distance : FLT_MAX;
+        if (screenError > maxScreenError)
+            break;
+        selected = i;
+    }
+    return selected;
+}
+
+assets::MeshBounds assets::calculateBounds(Vertex_f32_PNCV *vertices, size_t count)
+{
+    MeshBounds bounds = {};
+    if (count == 0)
+        return bounds;
+
+    float min[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float max[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            min[c] = std::min(min[c], vertices[i].position[c]);
+            max[c] = std::max(max[c], vertices[i].position[c]);
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        bounds.extents[c] = (max[c] - min[c]) / 2.0f;
+        bounds.origin[c] = bounds.extents[c] + min[c];
+    }
+
+    // exact radius from the center of the box, tighter than the box diagonal
+    float r2 = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        float offset[3];
+        offset[0] = vertices[i].position[0] - bounds.origin[0];
+        offset[1] = vertices[i].position[1] - bounds.origin[1];
+        offset[2] = vertices[i].position[2] - bounds.origin[2];
+
+        r2 = std::max(r2, offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+    }
+    bounds.radius = std::sqrt(r2);
+
+    return bounds;
+}
+
+assets::PositionQuantization assets::position_quantization(const MeshBounds &bounds)
+{
+    PositionQuantization quantization;
+    for (int c = 0; c < 3; c++)
+    {
+        quantization.offset[c] = bounds.origin[c] - bounds.extents[c];
+        quantization.scale[c] = bounds.extents[c] * 2.0f;
+        // flat along this axis, every position quantizes to 0
+        if (quantization.scale[c] <= 0.0f)
+        {
+            quantization.scale[c] = 1.0f;
+        }
+    }
+    return quantization;
+}
+
+uint16_t assets::float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = int32_t((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // nan and infinity
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    // too big, clamps to infinity
+    if (exponent >= 31)
+    {
+        return uint16_t(sign | 0x7c00);
+    }
+    // too small for a normal half, becomes a denormal or zero
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return uint16_t(sign);
+
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        // round to nearest even
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return uint16_t(sign | half);
+    }
+
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    // round to nearest even, a carry into the exponent is still the right value
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return uint16_t(half);
+}
+
+float assets::half_to_float(uint16_t value)
+{
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // denormal, normalize it
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3ff;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+static float sign_not_zero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+void assets::encode_octahedral(const float normal[3], float encoded[2])
+{
+    float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    if (length == 0.0f)
+    {
+        encoded[0] = 0.0f;
+        encoded[1] = 0.0f;
+        return;
+    }
+
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+    // the lower hemisphere gets folded over the diagonals
+    if (normal[2] < 0.0f)
+    {
+        encoded[0] = (1.0f - std::abs(y)) * sign_not_zero(x);
+        encoded[1] = (1.0f - std::abs(x)) * sign_not_zero(y);
+    }
+    else
+    {
+        encoded[0] = x;
+        encoded[1] = y;
+    }
+}
+
+void assets::decode_octahedral(const float encoded[2], float normal[3])
+{
+    float x = encoded[0];
+    float y = encoded[1];
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+static int8_t to_snorm8(float value)
+{
+    return int8_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+}
+
+static int16_t to_snorm16(float value)
+{
+    return int16_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint8_t to_unorm8(float value)
+{
+    return uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+static uint16_t to_unorm16(float value)
+{
+    return uint16_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+static float from_snorm(float value, float max)
+{
+    return std::max(value / max, -1.0f);
+}
+
+static void quantize_position(const float position[3], const PositionQuantization &quantization, uint16_t *output)
+{
+    for (int c = 0; c < 3; c++)
+    {
+        output[c] = to_unorm16((position[c] - quantization.offset[c]) / quantization.scale[c]);
+    }
+}
+
+std::vector<char> assets::convert_vertices(const Vertex_f32_PNCV *vertices, size_t count, VertexFormat format, const MeshBounds &bounds)
+{
+    std::vector<char> output(count * vertex_size(format));
+    PositionQuantization quantization = position_quantization(bounds);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vertex_f32_PNCV &v = vertices[i];
+        switch (format)
+        {
+        case VertexFormat::PNCV_F32:
+        {
+            memcpy(output.data() + i * sizeof(Vertex_f32_PNCV), &v, sizeof(Vertex_f32_PNCV));
+            break;
+        }
+        case VertexFormat::P32N8C8V16:
+        {
+            Vertex_P32N8C8V16 out = {};
+            for (int c = 0; c < 3; c++)
+            {
+                out.position[c] = v.position[c];
+                out.normal[c] = to_snorm8(v.normal[c]);
+                out.color[c] = to_unorm8(v.color[c]);
+            }
+            out.uv[0] = float_to_half(v.uv[0]);
+            out.uv[1] = float_to_half(v.uv[1]);
+            memcpy(output.data() + i * sizeof(out), &out, sizeof(out));
+            break;
+        }
+        case VertexFormat::P16N16C8V16:
+        {
+            Vertex_P16N16C8V16 out = {};
+            quantize_position(v.position, quantization, out.position);
+            float octahedral[2];
+            encode_octahedral(v.normal, octahedral);
+            out.normal[0] = to_snorm16(octahedral[0]);
+            out.normal[1] = to_snorm16(octahedral[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                out.color[c] = to_unorm8(v.color[c]);
+            }
+            out.uv[0] = float_to_half(v.uv[0]);
+            out.uv[1] = float_to_half(v.uv[1]);
+            memcpy(output.data() + i * sizeof(out), &out, sizeof(out));
+            break;
+        }
+        case VertexFormat::P16N8V16:
+        {
+            Vertex_P16N8V16 out = {};
+            quantize_position(v.position, quantization, out.position);
+            float octahedral[2];
+            encode_octahedral(v.normal, octahedral);
+            out.normal[0] = to_snorm8(octahedral[0]);
+            out.normal[1] = to_snorm8(octahedral[1]);
+            out.uv[0] = float_to_half(v.uv[0]);
+            out.uv[1] = float_to_half(v.uv[1]);
+            memcpy(output.data() + i * sizeof(out), &out, sizeof(out));
+            break;
+        }
+        default:
+            return {};
+        }
+    }
+    return output;
+}
+
+std::vector<Vertex_f32_PNCV> assets::decode_vertices(const char *vertices, size_t count, VertexFormat format, const MeshBounds &bounds)
+{
+    std::vector<Vertex_f32_PNCV> output(count);
+    PositionQuantization quantization = position_quantization(bounds);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Vertex_f32_PNCV &v = output[i];
+        v = {};
+        switch (format)
+        {
+        case VertexFormat::PNCV_F32:
+        {
+            memcpy(&v, vertices + i * sizeof(Vertex_f32_PNCV), sizeof(Vertex_f32_PNCV));
+            break;
+        }
+        case VertexFormat::P32N8C8V16:
+        {
+            Vertex_P32N8C8V16 in;
+            memcpy(&in, vertices + i * sizeof(in), sizeof(in));
+            for (int c = 0; c < 3; c++)
+            {
+                v.position[c] = in.position[c];
+                v.normal[c] = from_snorm(in.normal[c], 127.0f);
+                v.color[c] = in.color[c] / 255.0f;
+            }
+            float length = std::sqrt(v.normal[0] * v.normal[0] + v.normal[1] * v.normal[1] + v.normal[2] * v.normal[2]);
+            if (length > 0.0f)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    v.normal[c] /= length;
+                }
+            }
+            v.uv[0] = half_to_float(in.uv[0]);
+            v.uv[1] = half_to_float(in.uv[1]);
+            break;
+        }
+        case VertexFormat::P16N16C8V16:
+        {
+            Vertex_P16N16C8V16 in;
+            memcpy(&in, vertices + i * sizeof(in), sizeof(in));
+            float octahedral[2] = {from_snorm(in.normal[0], 32767.0f), from_snorm(in.normal[1], 32767.0f)};
+            decode_octahedral(octahedral, v.normal);
+            for (int c = 0; c < 3; c++)
+            {
+                v.position[c] = quantization.offset[c] + in.position[c] / 65535.0f * quantization.scale[c];
+                v.color[c] = in.color[c] / 255.0f;
+            }
+            v.uv[0] = half_to_float(in.uv[0]);
+            v.uv[1] = half_to_float(in.uv[1]);
+            break;
+        }
+        case VertexFormat::P16N8V16:
+        {
+            Vertex_P16N8V16 in;
+            memcpy(&in, vertices + i * sizeof(in), sizeof(in));
+            float octahedral[2] = {from_snorm(in.normal[0], 127.0f), from_snorm(in.normal[1], 127.0f)};
+            decode_octahedral(octahedral, v.normal);
+            for (int c = 0; c < 3; c++)
+            {
+                v.position[c] = quantization.offset[c] + in.position[c] / 65535.0f * quantization.scale[c];
+            }
+            v.uv[0] = half_to_float(in.uv[0]);
+            v.uv[1] = half_to_float(in.uv[1]);
+            break;
+        }
+        default:
+            return {};
+        }
+    }
+    return output;
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include "asset_loader.h"
+
+namespace assets
+{
+    // everything at 32 bits, what the baker extracts before converting to the format a mesh is stored in
+    struct Vertex_f32_PNCV
+    {
+        float position[3];
+        float normal[3];
+        float color[3];
+        float uv[2];
+    };
+
+    // 24 bytes. Normal is snorm, color unorm, uvs are half floats. The 4th normal and color bytes are unused
+    struct Vertex_P32N8C8V16
+    {
+        float position[3];
+        int8_t normal[4];
+        uint8_t color[4];
+        uint16_t uv[2];
+    };
+
+    // 20 bytes. Position is unorm relative to the mesh bounds, the 4th component is unused.
+    // Normal is octahedral encoded snorm, uvs are half floats
+    struct Vertex_P16N16C8V16
+    {
+        uint16_t position[4];
+        int16_t normal[2];
+        uint8_t color[4];
+        uint16_t uv[2];
+    };
+
+    // 12 bytes, no vertex color. Position is unorm relative to the mesh bounds, the normal is octahedral encoded
+    // snorm and sits right after it, so the position can be fetched as a 4 component format. uvs are half floats
+    struct Vertex_P16N8V16
+    {
+        uint16_t position[3];
+        int8_t normal[2];
+        uint16_t uv[2];
+    };
+
+    enum class VertexFormat : uint32_t
+    {
+        Unknown = 0,
+        // everything at 32 bits
+        PNCV_F32,
+        // position at 32 bits, normal at 8 bits, color at 8 bits, uvs at 16 bits float
+        P32N8C8V16,
+        // quantized position at 16 bits, octahedral normal at 16 bits, color at 8 bits, uvs at 16 bits float
+        P16N16C8V16,
+        // quantized position at 16 bits, octahedral normal at 8 bits, uvs at 16 bits float
+        P16N8V16
+    };
+
+    struct MeshBounds
+    {
+        float origin[3];
+        float radius;
+        float extents[3];
+    };
+
+    // pages of vertex and index data bigger than this get compressed as independent blocks
+    constexpr uint32_t MESH_BLOCK_SIZE = 256 * 1024;
+
+    // a range of the index buffer, and the meshlets built from it. Every lod indexes the same vertices
+    struct MeshLod
+    {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        uint32_t meshletOffset;
+        uint32_t meshletCount;
+        // how far the surface of this lod can be from the full detail one, in mesh units
+        float error;
+    };
+
+    // sized for mesh shaders, 124 triangles leaves room for 4 bytes of per meshlet data in a 128 primitive output
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    // a small cluster of triangles that can be culled on its own
+    struct Meshlet
+    {
+        // first entry in the meshlet vertex list, which holds indices into the vertex buffer
+        uint32_t vertexOffset;
+        // first byte in the meshlet triangle list, 3 bytes per triangle indexing into the vertices of the meshlet
+        uint32_t triangleOffset;
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+
+        // bounding sphere
+        float center[3];
+        float radius;
+
+        // every triangle faces away from a camera at position c when dot(normalize(coneApex - c), coneAxis) >= coneCutoff.
+        // the cutoff is 1 when the normals spread too much to ever cull the meshlet as a whole
+        float coneApex[3];
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    // the unpacked meshlet buffer, pointing into it
+    struct MeshletBufferView
+    {
+        const Meshlet *meshlets;
+        const uint32_t *vertices;
+        const uint8_t *triangles;
+    };
+
+    struct MeshInfo
+    {
+        uint64_t vertexBuferSize;
+        uint64_t indexBuferSize;
+        MeshBounds bounds;
+        VertexFormat vertexFormat;
+        char indexSize;
+        CompressionMode compressionMode;
+        uint32_t blockSize{0};
+        // the index data starts at this offset in the blob, right after the compressed vertices
+        uint64_t vertexCompressedSize{0};
+        // the meshlet data starts right after the compressed indices
+        uint64_t indexCompressedSize{0};
+        // meshlet buffer: every Meshlet, then the meshlet vertex list, then the triangle list padded to 4 bytes
+        uint32_t meshletCount{0};
+        uint32_t meshletVertexCount{0};
+        uint32_t meshletTriangleCount{0};
+        // shared dictionary the blob was compressed against, 0 for none. Comes from the AssetFile
+        uint32_t dictionaryId{0};
+        std::string originalFile;
+        // from full detail to the coarsest. Meshes baked without lods have none, the whole index buffer is lod 0
+        std::vector<MeshLod> lods;
+    };
+
+    // fixed layout of the binary mesh metadata, followed by the original file name and the lods
+    struct MeshMetadataBinary
+    {
+        uint64_t vertexBufferSize;
+        uint64_t indexBufferSize;
+        uint64_t vertexCompressedSize;
+        uint64_t indexCompressedSize;
+        MeshBounds bounds;
+        uint32_t vertexFormat;
+        uint32_t compressionMode;
+        uint32_t indexSize;
+        uint32_t blockSize;
+        uint32_t originalFileLength;
+        uint32_t meshletCount;
+        uint32_t meshletVertexCount;
+        uint32_t meshletTriangleCount;
+        // MeshLod table, stored after the original file name
+        uint32_t lodCount;
+    };
+
+    VertexFormat parse_vertex_format(const char *f);
+    const char *vertex_format_name(VertexFormat format);
+    // size of one vertex in bytes, 0 for Unknown
+    size_t vertex_size(VertexFormat format);
+    // true for the formats that store positions relative to the bounds
+    bool is_position_quantized(VertexFormat format);
+
+    MeshInfo read_mesh_info(const AssetFile *file);
+    MeshInfo read_mesh_info(const MappedAssetFile *file);
+
+    // size of the meshlet buffer, 0 for meshes without meshlets
+    size_t meshlet_buffer_size(const MeshInfo &info);
+    MeshletBufferView read_meshlet_buffer(const MeshInfo &info, const char *meshletBuffer);
+
+    // decompresses the vertices and indices into their own buffers, sized vertexBuferSize and indexBuferSize.
+    // the meshlets are only unpacked when meshletBuffer is set, it needs meshlet_buffer_size bytes
+    bool unpack_mesh(MeshInfo *info, const char *sourcebuffer, size_t sourceSize, char *vertexBufer, char *indexBuffer, char *meshletBuffer = nullptr);
+
+    // vertexData must already be in info->vertexFormat, see convert_vertices.
+    // meshletData is laid out as described in MeshInfo, and can be null when meshletCount is 0
+    AssetFile pack_mesh(MeshInfo *info, char *vertexData, char *indexData, const char *meshletData = nullptr, const CompressionPolicy &policy = {}, bool writeJson = false);
+
+    // coarsest lod whose error, projected at that distance, stays under maxScreenError pixels.
+    // projectionScale is the viewport height in pixels divided by 2 * tan(fovy / 2)
+    uint32_t select_mesh_lod(const MeshInfo &info, float distance, float projectionScale, float maxScreenError = 1.0f);
+
+    MeshBounds calculateBounds(Vertex_f32_PNCV *vertices, size_t count);
+
+    // quantized positions are stored as q = (position - offset) / scale, in the 0 to 1 range.
+    // the runtime gets the real position back with position = offset + q * scale, usually folded into the model matrix
+    struct PositionQuantization
+    {
+        float offset[3];
+        float scale[3];
+    };
+    PositionQuantization position_quantization(const MeshBounds &bounds);
+
+    uint16_t float_to_half(float value);
+    float half_to_float(uint16_t value);
+
+    // maps a unit vector onto the -1 to 1 square, and back
+    void encode_octahedral(const float normal[3], float encoded[2]);
+    void decode_octahedral(const float encoded[2], float normal[3]);
+
+    // converts full precision vertices into any format, quantizing positions relative to the bounds when the format needs it
+    std::vector<char> convert_vertices(const Vertex_f32_PNCV *vertices, size_t count, VertexFormat format, const MeshBounds &bounds);
+    // the opposite of convert_vertices, for tools that need to read a mesh back
+    std::vector<Vertex_f32_PNCV> decode_vertices(const char *vertices, size_t count, VertexFormat format, const MeshBounds &bounds);
+}
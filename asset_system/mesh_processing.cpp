@@ -0,0 +1,1087 @@
+#include "mesh_processing.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace assets;
+
+static uint64_t hash_bytes(const void *data, size_t size)
+{
+    // fnv-1a
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static size_t hash_table_capacity(size_t count)
+{
+    // power of 2, at most half full
+    size_t capacity = 1;
+    while (capacity < count * 2)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+size_t assets::weld_vertices(std::vector<Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &indices)
+{
+    // open addressing table of indices into the welded vertices
+    size_t capacity = hash_table_capacity(vertices.size());
+    constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<uint32_t> table(capacity, EMPTY);
+
+    std::vector<uint32_t> remap(vertices.size(), EMPTY);
+    std::vector<Vertex_f32_PNCV> welded;
+    welded.reserve(vertices.size());
+
+    for (uint32_t &index : indices)
+    {
+        uint32_t &mapped = remap[index];
+        if (mapped == EMPTY)
+        {
+            const Vertex_f32_PNCV &vertex = vertices[index];
+            size_t slot = hash_bytes(&vertex, sizeof(Vertex_f32_PNCV)) & (capacity - 1);
+            while (table[slot] != EMPTY && memcmp(&welded[table[slot]], &vertex, sizeof(Vertex_f32_PNCV)) != 0)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            if (table[slot] == EMPTY)
+            {
+                table[slot] = static_cast<uint32_t>(welded.size());
+                welded.push_back(vertex);
+            }
+            mapped = table[slot];
+        }
+        index = mapped;
+    }
+
+    vertices = std::move(welded);
+    return vertices.size();
+}
+
+// fifo cache where a vertex is a hit while less than cacheSize misses happened since it was loaded
+struct FifoCache
+{
+    std::vector<uint32_t> loadTime;
+    uint32_t time;
+    uint32_t size;
+
+    FifoCache(size_t vertexCount, uint32_t cacheSize) : loadTime(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+    // returns true on a miss
+    bool access(uint32_t vertex)
+    {
+        if (time - loadTime[vertex] > size)
+        {
+            loadTime[vertex] = time++;
+            return true;
+        }
+        return false;
+    }
+    void flush() { time += size + 1; }
+};
+
+VertexCacheStats assets::analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize)
+{
+    FifoCache cache{vertexCount, cacheSize};
+    std::vector<bool> used(vertexCount, false);
+    size_t misses = 0;
+    size_t usedCount = 0;
+    for (uint32_t index : indices)
+    {
+        misses += cache.access(index);
+        if (!used[index])
+        {
+            used[index] = true;
+            usedCount++;
+        }
+    }
+
+    VertexCacheStats stats = {};
+    size_t triangleCount = indices.size() / 3;
+    stats.acmr = triangleCount ? float(misses) / float(triangleCount) : 0.0f;
+    stats.atvr = usedCount ? float(misses) / float(usedCount) : 0.0f;
+    return stats;
+}
+
+void assets::optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<uint32_t> &clusterStarts, uint32_t cacheSize)
+{
+    size_t triangleCount = indices.size() / 3;
+    clusterStarts.clear();
+    if (triangleCount == 0)
+        return;
+
+    // triangles around every vertex, and how many of them are not emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        liveTriangles[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t fanning = indices[0];
+    size_t cursor = 0;
+    clusterStarts.push_back(0);
+
+    while (true)
+    {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[triangle * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // the candidate that stays in the cache while its remaining triangles get fanned, and has been in it the longest
+        int64_t best = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+
+            int64_t priority = 0;
+            if (int64_t(time) - cacheTime[v] + 2 * int64_t(liveTriangles[v]) <= cacheSize)
+            {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        if (best < 0)
+        {
+            // dead end, the most recent vertex with triangles left is likely still in the cache
+            while (!deadEnd.empty() && best < 0)
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0)
+                {
+                    best = v;
+                }
+            }
+        }
+        if (best < 0)
+        {
+            // nothing left nearby, carry on in input order from a cold cache
+            while (cursor < indices.size() && liveTriangles[indices[cursor]] == 0)
+            {
+                cursor++;
+            }
+            if (cursor == indices.size())
+                break;
+
+            best = indices[cursor];
+            clusterStarts.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+        fanning = static_cast<uint32_t>(best);
+    }
+
+    indices = std::move(output);
+}
+
+void assets::optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &clusterStarts, float threshold, uint32_t cacheSize)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    FifoCache cache{vertices.size(), cacheSize};
+
+    // soft boundaries, cut a cluster as soon as the part of it so far is almost as cache efficient as the whole
+    std::vector<uint32_t> starts;
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        uint32_t begin = clusterStarts[c];
+        uint32_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+        cache.flush();
+        uint32_t clusterMisses = 0;
+        for (uint32_t i = begin * 3; i < end * 3; i++)
+        {
+            clusterMisses += cache.access(indices[i]);
+        }
+        float clusterAcmr = float(clusterMisses) / float(end - begin);
+
+        cache.flush();
+        uint32_t start = begin;
+        uint32_t misses = 0;
+        starts.push_back(begin);
+        for (uint32_t t = begin; t < end; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                misses += cache.access(indices[t * 3 + k]);
+            }
+
+            if (t + 1 < end && float(misses) / float(t + 1 - start) <= clusterAcmr * threshold)
+            {
+                start = t + 1;
+                misses = 0;
+                starts.push_back(start);
+                cache.flush();
+            }
+        }
+    }
+
+    // area weighted centroid of the mesh, and of every cluster with its average normal
+    auto position = [&](uint32_t index)
+    {
+        const float *p = vertices[index].position;
+        return std::array<float, 3>{p[0], p[1], p[2]};
+    };
+
+    struct ClusterSort
+    {
+        uint32_t begin;
+        uint32_t end;
+        float sortKey;
+    };
+    std::vector<ClusterSort> clusters(starts.size());
+    std::vector<std::array<float, 3>> centroids(starts.size());
+    std::vector<std::array<float, 3>> normals(starts.size());
+
+    float meshCentroid[3] = {0, 0, 0};
+    float meshArea = 0;
+    for (size_t c = 0; c < starts.size(); c++)
+    {
+        clusters[c].begin = starts[c];
+        clusters[c].end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+
+        float centroid[3] = {0, 0, 0};
+        float normal[3] = {0, 0, 0};
+        float clusterArea = 0;
+        for (uint32_t t = clusters[c].begin; t < clusters[c].end; t++)
+        {
+            auto p0 = position(indices[t * 3 + 0]);
+            auto p1 = position(indices[t * 3 + 1]);
+            auto p2 = position(indices[t * 3 + 2]);
+
+            float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+            float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; k++)
+            {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                normal[k] += n[k];
+            }
+            clusterArea += area;
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            meshCentroid[k] += centroid[k];
+            centroids[c][k] = clusterArea > 0 ? centroid[k] / clusterArea : 0.0f;
+        }
+        meshArea += clusterArea;
+
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int k = 0; k < 3; k++)
+        {
+            normals[c][k] = length > 0 ? normal[k] / length : 0.0f;
+        }
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        meshCentroid[k] = meshArea > 0 ? meshCentroid[k] / meshArea : 0.0f;
+    }
+
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        float sortKey = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            sortKey += (centroids[c][k] - meshCentroid[k]) * normals[c][k];
+        }
+        clusters[c].sortKey = sortKey;
+    }
+
+    // stable, so clusters that face the same way keep their cache friendly order
+    std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterSort &a, const ClusterSort &b)
+                     { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const ClusterSort &cluster : clusters)
+    {
+        output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+    }
+    indices = std::move(output);
+}
+
+void assets::optimize_vertex_fetch(std::vector<Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &indices)
+{
+    constexpr uint32_t UNUSED = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    std::vector<Vertex_f32_PNCV> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t &index : indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+namespace
+{
+    // symmetric 4x4 error matrix, the squared distance to a set of planes, weighted by w
+    struct Quadric
+    {
+        float a00, a11, a22;
+        float a10, a20, a21;
+        float b0, b1, b2;
+        float c;
+        float w;
+    };
+
+    enum class VertexKind : uint8_t
+    {
+        Manifold,
+        // on the open edge of the mesh
+        Border,
+        // two copies of the vertex with different attributes, each on one side of a seam
+        Seam,
+        Locked
+    };
+
+    // which kind of vertex can collapse into which
+    const bool CAN_COLLAPSE[4][4] = {
+        {true, true, true, true},
+        {false, true, false, false},
+        {false, false, true, false},
+        {false, false, false, false},
+    };
+    // edges between these kinds show up in both directions, one of them is enough
+    const bool HAS_OPPOSITE[4][4] = {
+        {true, true, true, true},
+        {true, false, true, false},
+        {true, true, true, true},
+        {true, false, true, false},
+    };
+
+    struct Collapse
+    {
+        uint32_t v0;
+        uint32_t v1;
+        bool bidirectional;
+        float error;
+    };
+
+    constexpr uint32_t NONE = UINT32_MAX;
+    // border edges get a plane through them, perpendicular to the surface, so the border keeps its shape
+    constexpr float BORDER_EDGE_WEIGHT = 10.0f;
+}
+
+static void quadric_from_plane(Quadric &Q, float a, float b, float c, float d, float w)
+{
+    Q.a00 = a * a * w;
+    Q.a11 = b * b * w;
+    Q.a22 = c * c * w;
+    Q.a10 = a * b * w;
+    Q.a20 = a * c * w;
+    Q.a21 = b * c * w;
+    Q.b0 = a * d * w;
+    Q.b1 = b * d * w;
+    Q.b2 = c * d * w;
+    Q.c = d * d * w;
+    Q.w = w;
+}
+
+static void quadric_add(Quadric &Q, const Quadric &R)
+{
+    Q.a00 += R.a00;
+    Q.a11 += R.a11;
+    Q.a22 += R.a22;
+    Q.a10 += R.a10;
+    Q.a20 += R.a20;
+    Q.a21 += R.a21;
+    Q.b0 += R.b0;
+    Q.b1 += R.b1;
+    Q.b2 += R.b2;
+    Q.c += R.c;
+    Q.w += R.w;
+}
+
+// average squared distance from p to the planes of the quadric
+static float quadric_error(const Quadric &Q, const float *p)
+{
+    float rx = Q.b0 + Q.a10 * p[1];
+    float ry = Q.b1 + Q.a21 * p[2];
+    float rz = Q.b2 + Q.a20 * p[0];
+
+    rx = rx * 2 + Q.a00 * p[0];
+    ry = ry * 2 + Q.a11 * p[1];
+    rz = rz * 2 + Q.a22 * p[2];
+
+    float r = Q.c + rx * p[0] + ry * p[1] + rz * p[2];
+    return Q.w > 0 ? std::abs(r) / Q.w : 0.0f;
+}
+
+static void cross(const float *a, const float *b, float *result)
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float triangle_normal(const float *p0, const float *p1, const float *p2, float *normal)
+{
+    float e0[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    float e1[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    cross(e0, e1, normal);
+    return std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+}
+
+// vertices at the same position point at the first of them in remap, and form a circular list through wedge
+static void build_position_remap(const std::vector<Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &remap, std::vector<uint32_t> &wedge)
+{
+    size_t capacity = hash_table_capacity(vertices.size());
+    std::vector<uint32_t> table(capacity, NONE);
+
+    remap.resize(vertices.size());
+    wedge.resize(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        const float *position = vertices[i].position;
+        size_t slot = hash_bytes(position, sizeof(float) * 3) & (capacity - 1);
+        while (table[slot] != NONE && memcmp(vertices[table[slot]].position, position, sizeof(float) * 3) != 0)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == NONE)
+        {
+            table[slot] = i;
+        }
+
+        uint32_t r = table[slot];
+        remap[i] = r;
+        wedge[i] = i;
+        if (r != i)
+        {
+            wedge[i] = wedge[r];
+            wedge[r] = i;
+        }
+    }
+}
+
+// offsets and targets of the half edges leaving every vertex
+static void build_edge_adjacency(const std::vector<uint32_t> &indices, size_t vertexCount, std::vector<uint32_t> &offsets, std::vector<uint32_t> &targets)
+{
+    offsets.assign(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+    {
+        offsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+
+    targets.resize(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = indices[t * 3 + e];
+            uint32_t b = indices[t * 3 + (e + 1) % 3];
+            targets[fill[a]++] = b;
+        }
+    }
+}
+
+static bool has_edge(const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &targets, uint32_t a, uint32_t b)
+{
+    for (uint32_t i = offsets[a]; i < offsets[a + 1]; i++)
+    {
+        if (targets[i] == b)
+            return true;
+    }
+    return false;
+}
+
+std::vector<uint32_t> assets::simplify_mesh(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, size_t targetIndexCount, float maxError, float *resultError)
+{
+    size_t vertexCount = vertices.size();
+    std::vector<uint32_t> result = indices;
+    float resultError2 = 0;
+
+    std::vector<uint32_t> remap, wedge;
+    build_position_remap(vertices, remap, wedge);
+
+    std::vector<uint32_t> edgeOffsets, edgeTargets;
+    build_edge_adjacency(indices, vertexCount, edgeOffsets, edgeTargets);
+
+    // open edges are the ones without a twin going the other way. A vertex with exactly one open edge in and one out
+    // is on a single border or seam, loop and loopback follow it
+    std::vector<uint32_t> openIn(vertexCount, NONE);
+    std::vector<uint32_t> openOut(vertexCount, NONE);
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = indices[t * 3 + e];
+            uint32_t b = indices[t * 3 + (e + 1) % 3];
+            if (!has_edge(edgeOffsets, edgeTargets, b, a))
+            {
+                // pointing at itself marks more than one
+                openIn[b] = openIn[b] == NONE ? a : b;
+                openOut[a] = openOut[a] == NONE ? b : a;
+            }
+        }
+    }
+
+    auto single_open = [](uint32_t open, uint32_t v)
+    { return open != NONE && open != v; };
+
+    std::vector<VertexKind> kind(vertexCount, VertexKind::Locked);
+    for (uint32_t i = 0; i < vertexCount; i++)
+    {
+        if (remap[i] != i)
+            continue;
+
+        if (wedge[i] == i)
+        {
+            if (openIn[i] == NONE && openOut[i] == NONE)
+            {
+                kind[i] = VertexKind::Manifold;
+            }
+            else if (single_open(openIn[i], i) && single_open(openOut[i], i))
+            {
+                kind[i] = VertexKind::Border;
+            }
+        }
+        else if (wedge[wedge[i]] == i)
+        {
+            // a seam has one open edge in and out for each side, and the two sides run along the same positions
+            uint32_t w = wedge[i];
+            if (single_open(openIn[i], i) && single_open(openOut[i], i) && single_open(openIn[w], w) && single_open(openOut[w], w) &&
+                remap[openIn[i]] == remap[openOut[w]] && remap[openOut[i]] == remap[openIn[w]] && remap[openIn[i]] != remap[openOut[i]])
+            {
+                kind[i] = VertexKind::Seam;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < vertexCount; i++)
+    {
+        kind[i] = kind[remap[i]];
+    }
+
+    std::vector<uint32_t> loop(vertexCount, NONE);
+    std::vector<uint32_t> loopback(vertexCount, NONE);
+    for (uint32_t i = 0; i < vertexCount; i++)
+    {
+        if (kind[i] == VertexKind::Border || kind[i] == VertexKind::Seam)
+        {
+            loop[i] = openOut[i];
+            loopback[i] = openIn[i];
+        }
+    }
+
+    // quadrics of the triangle planes around every position, plus the border planes
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        uint32_t i0 = indices[t * 3 + 0];
+        uint32_t i1 = indices[t * 3 + 1];
+        uint32_t i2 = indices[t * 3 + 2];
+        const float *p0 = vertices[i0].position;
+
+        float normal[3];
+        float length = triangle_normal(p0, vertices[i1].position, vertices[i2].position, normal);
+        if (length == 0)
+            continue;
+
+        for (int k = 0; k < 3; k++)
+        {
+            normal[k] /= length;
+        }
+        float distance = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+
+        Quadric Q;
+        quadric_from_plane(Q, normal[0], normal[1], normal[2], distance, length * 0.5f);
+        quadric_add(quadrics[remap[i0]], Q);
+        quadric_add(quadrics[remap[i1]], Q);
+        quadric_add(quadrics[remap[i2]], Q);
+
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = indices[t * 3 + e];
+            uint32_t b = indices[t * 3 + (e + 1) % 3];
+            if (kind[a] != VertexKind::Border || loop[a] != b)
+                continue;
+
+            const float *pa = vertices[a].position;
+            const float *pb = vertices[b].position;
+            float edge[3] = {pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2]};
+            float edgeLength2 = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+
+            float edgeNormal[3];
+            cross(edge, normal, edgeNormal);
+            float edgeNormalLength = std::sqrt(edgeNormal[0] * edgeNormal[0] + edgeNormal[1] * edgeNormal[1] + edgeNormal[2] * edgeNormal[2]);
+            if (edgeNormalLength == 0)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                edgeNormal[k] /= edgeNormalLength;
+            }
+            float edgeDistance = -(edgeNormal[0] * pa[0] + edgeNormal[1] * pa[1] + edgeNormal[2] * pa[2]);
+
+            Quadric edgeQ;
+            quadric_from_plane(edgeQ, edgeNormal[0], edgeNormal[1], edgeNormal[2], edgeDistance, edgeLength2 * BORDER_EDGE_WEIGHT);
+            quadric_add(quadrics[remap[a]], edgeQ);
+            quadric_add(quadrics[remap[b]], edgeQ);
+        }
+    }
+
+    float maxError2 = maxError * maxError;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseOrder;
+    std::vector<uint32_t> collapseRemap(vertexCount);
+    std::vector<bool> collapseLocked(vertexCount);
+    std::vector<uint32_t> triangleOffsets, triangleList;
+
+    // every pass collapses a batch of the cheapest edges that do not touch each other, then rebuilds the index list
+    while (result.size() > targetIndexCount)
+    {
+        collapses.clear();
+        for (size_t t = 0; t < result.size() / 3; t++)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                uint32_t i0 = result[t * 3 + e];
+                uint32_t i1 = result[t * 3 + (e + 1) % 3];
+                if (remap[i0] == remap[i1])
+                    continue;
+
+                int k0 = int(kind[i0]);
+                int k1 = int(kind[i1]);
+                if (HAS_OPPOSITE[k0][k1] && remap[i1] > remap[i0])
+                    continue;
+
+                // borders and seams only collapse along themselves
+                if (k0 == k1 && (kind[i0] == VertexKind::Border || kind[i0] == VertexKind::Seam) && loop[i0] != i1)
+                    continue;
+
+                if (CAN_COLLAPSE[k0][k1] && CAN_COLLAPSE[k1][k0])
+                {
+                    collapses.push_back({i0, i1, true, 0.0f});
+                }
+                else if (CAN_COLLAPSE[k0][k1])
+                {
+                    collapses.push_back({i0, i1, false, 0.0f});
+                }
+                else if (CAN_COLLAPSE[k1][k0])
+                {
+                    collapses.push_back({i1, i0, false, 0.0f});
+                }
+            }
+        }
+        if (collapses.empty())
+            break;
+
+        for (Collapse &c : collapses)
+        {
+            float error0 = quadric_error(quadrics[remap[c.v0]], vertices[c.v1].position);
+            float error1 = c.bidirectional ? quadric_error(quadrics[remap[c.v1]], vertices[c.v0].position) : FLT_MAX;
+            if (error1 < error0)
+            {
+                std::swap(c.v0, c.v1);
+            }
+            c.error = std::min(error0, error1);
+        }
+
+        collapseOrder.resize(collapses.size());
+        for (uint32_t i = 0; i < collapses.size(); i++)
+        {
+            collapseOrder[i] = i;
+        }
+        std::sort(collapseOrder.begin(), collapseOrder.end(), [&](uint32_t a, uint32_t b)
+                  { return collapses[a].error < collapses[b].error; });
+
+        // triangles around every position, for the flip check
+        {
+            std::vector<uint32_t> positionIndices(result.size());
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                positionIndices[i] = remap[result[i]];
+            }
+            triangleOffsets.assign(vertexCount + 1, 0);
+            for (uint32_t index : positionIndices)
+            {
+                triangleOffsets[index + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++)
+            {
+                triangleOffsets[v + 1] += triangleOffsets[v];
+            }
+            triangleList.resize(positionIndices.size());
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (size_t i = 0; i < positionIndices.size(); i++)
+            {
+                triangleList[fill[positionIndices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // a manifold collapse removes 2 triangles, aim for a bit less than what is left to remove,
+        // and stop early once the errors get much worse than what the goal would need
+        size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+        size_t edgeGoal = triangleGoal / 2;
+        float errorGoal = edgeGoal < collapseOrder.size() ? 1.5f * collapses[collapseOrder[edgeGoal]].error : FLT_MAX;
+
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            collapseRemap[i] = i;
+        }
+        std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+
+        size_t triangleCollapses = 0;
+        for (uint32_t order : collapseOrder)
+        {
+            const Collapse &c = collapses[order];
+            uint32_t r0 = remap[c.v0];
+            uint32_t r1 = remap[c.v1];
+
+            if (c.error > maxError2 || c.error > errorGoal || triangleCollapses >= triangleGoal)
+                break;
+            if (collapseLocked[r0] || collapseLocked[r1])
+                continue;
+
+            // moving r0 onto r1 must not turn any of the triangles that stay around
+            bool flips = false;
+            const float *target = vertices[r1].position;
+            for (uint32_t a = triangleOffsets[r0]; a < triangleOffsets[r0 + 1] && !flips; a++)
+            {
+                uint32_t t = triangleList[a];
+                uint32_t corners[3] = {remap[result[t * 3 + 0]], remap[result[t * 3 + 1]], remap[result[t * 3 + 2]]};
+                if (corners[0] == r1 || corners[1] == r1 || corners[2] == r1)
+                    continue;
+
+                const float *before[3];
+                const float *after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = vertices[corners[k]].position;
+                    after[k] = corners[k] == r0 ? target : before[k];
+                }
+                float n0[3], n1[3];
+                triangle_normal(before[0], before[1], before[2], n0);
+                triangle_normal(after[0], after[1], after[2], n1);
+                flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0;
+            }
+            if (flips)
+                continue;
+
+            if (kind[c.v0] == VertexKind::Seam)
+            {
+                // the other side of the seam collapses into the other copy of v1
+                uint32_t s0 = wedge[c.v0];
+                uint32_t s1 = loop[c.v0] == c.v1 ? loopback[s0] : loop[s0];
+                if (s1 == NONE || remap[s1] != r1)
+                    continue;
+                collapseRemap[s0] = s1;
+            }
+            collapseRemap[c.v0] = c.v1;
+
+            quadric_add(quadrics[r1], quadrics[r0]);
+            collapseLocked[r0] = true;
+            collapseLocked[r1] = true;
+
+            triangleCollapses += kind[c.v0] == VertexKind::Border ? 1 : 2;
+            resultError2 = std::max(resultError2, c.error);
+        }
+        if (triangleCollapses == 0)
+            break;
+
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            if (loop[i] != NONE)
+            {
+                uint32_t l = loop[i];
+                uint32_t r = collapseRemap[l];
+                // the edge was collapsed towards i, the loop skips over it
+                loop[i] = i == r ? loop[l] : r;
+            }
+            if (loopback[i] != NONE)
+            {
+                uint32_t l = loopback[i];
+                uint32_t r = collapseRemap[l];
+                loopback[i] = i == r ? loopback[l] : r;
+            }
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < result.size() / 3; t++)
+        {
+            uint32_t a = collapseRemap[result[t * 3 + 0]];
+            uint32_t b = collapseRemap[result[t * 3 + 1]];
+            uint32_t c = collapseRemap[result[t * 3 + 2]];
+            if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                continue;
+
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError)
+    {
+        *resultError = std::sqrt(resultError2);
+    }
+    return result;
+}
+
+std::vector<MeshLodLevel> assets::build_lod_chain(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, uint32_t maxLods, float maxError)
+{
+    std::vector<MeshLodLevel> lods;
+    lods.push_back({indices, 0.0f});
+
+    size_t target = indices.size() / 3;
+    for (uint32_t lod = 1; lod < maxLods; lod++)
+    {
+        target /= 2;
+        if (target < MESH_LOD_MIN_TRIANGLES)
+            break;
+
+        // always from the full detail mesh, so the error is measured against the real surface
+        float error = 0;
+        std::vector<uint32_t> simplified = simplify_mesh(vertices, indices, target * 3, maxError, &error);
+        if (simplified.size() > lods.back().indices.size() * 4 / 5)
+            break;
+
+        lods.push_back({std::move(simplified), std::max(error, lods.back().error)});
+    }
+    return lods;
+}
+
+static void compute_meshlet_bounds(const std::vector<Vertex_f32_PNCV> &vertices, const MeshletBuilder &builder, Meshlet &meshlet)
+{
+    const uint32_t *meshletVertices = builder.vertices.data() + meshlet.vertexOffset;
+    const uint8_t *meshletTriangles = builder.triangles.data() + meshlet.triangleOffset;
+
+    // sphere around the center of the box
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+    {
+        const float *p = vertices[meshletVertices[i]].position;
+        for (int k = 0; k < 3; k++)
+        {
+            min[k] = std::min(min[k], p[k]);
+            max[k] = std::max(max[k], p[k]);
+        }
+    }
+    float radius2 = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        meshlet.center[k] = (min[k] + max[k]) * 0.5f;
+    }
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+    {
+        const float *p = vertices[meshletVertices[i]].position;
+        float d[3] = {p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]};
+        radius2 = std::max(radius2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    meshlet.radius = std::sqrt(radius2);
+
+    // cone around the average of the triangle normals, as wide as the normal furthest from it
+    std::vector<std::array<float, 3>> normals(meshlet.triangleCount);
+    float axis[3] = {0, 0, 0};
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+    {
+        const float *p0 = vertices[meshletVertices[meshletTriangles[t * 3 + 0]]].position;
+        const float *p1 = vertices[meshletVertices[meshletTriangles[t * 3 + 1]]].position;
+        const float *p2 = vertices[meshletVertices[meshletTriangles[t * 3 + 2]]].position;
+
+        float length = triangle_normal(p0, p1, p2, normals[t].data());
+        for (int k = 0; k < 3; k++)
+        {
+            normals[t][k] = length > 0 ? normals[t][k] / length : 0.0f;
+            axis[k] += normals[t][k];
+        }
+    }
+
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (int k = 0; k < 3; k++)
+    {
+        meshlet.coneAxis[k] = axisLength > 0 ? axis[k] / axisLength : 0.0f;
+        meshlet.coneApex[k] = meshlet.center[k];
+    }
+    meshlet.coneCutoff = 1.0f;
+
+    float minDot = 1.0f;
+    for (const auto &normal : normals)
+    {
+        minDot = std::min(minDot, normal[0] * meshlet.coneAxis[0] + normal[1] * meshlet.coneAxis[1] + normal[2] * meshlet.coneAxis[2]);
+    }
+    // normals spread past about 85 degrees from the axis, the cone would never cull anything
+    if (axisLength == 0 || minDot <= 0.1f)
+        return;
+
+    // the apex goes back along the axis until every triangle plane is in front of it
+    float maxDistance = 0;
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+    {
+        const float *p0 = vertices[meshletVertices[meshletTriangles[t * 3 + 0]]].position;
+        const float *n = normals[t].data();
+        float d[3] = {meshlet.center[0] - p0[0], meshlet.center[1] - p0[1], meshlet.center[2] - p0[2]};
+        float dn = n[0] * meshlet.coneAxis[0] + n[1] * meshlet.coneAxis[1] + n[2] * meshlet.coneAxis[2];
+        maxDistance = std::max(maxDistance, (d[0] * n[0] + d[1] * n[1] + d[2] * n[2]) / dn);
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        meshlet.coneApex[k] = meshlet.center[k] - meshlet.coneAxis[k] * maxDistance;
+    }
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void assets::build_meshlets(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, MeshletBuilder &builder, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    // local index of every vertex in the meshlet being built
+    constexpr uint8_t NOT_IN_MESHLET = 0xff;
+    std::vector<uint8_t> local(vertices.size(), NOT_IN_MESHLET);
+
+    Meshlet meshlet = {};
+    meshlet.vertexOffset = static_cast<uint32_t>(builder.vertices.size());
+    meshlet.triangleOffset = static_cast<uint32_t>(builder.triangles.size());
+
+    auto finish_meshlet = [&]()
+    {
+        if (meshlet.triangleCount == 0)
+            return;
+
+        compute_meshlet_bounds(vertices, builder, meshlet);
+        builder.meshlets.push_back(meshlet);
+
+        for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+        {
+            local[builder.vertices[meshlet.vertexOffset + i]] = NOT_IN_MESHLET;
+        }
+
+        meshlet = {};
+        meshlet.vertexOffset = static_cast<uint32_t>(builder.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(builder.triangles.size());
+    };
+
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        uint32_t a = indices[t * 3 + 0];
+        uint32_t b = indices[t * 3 + 1];
+        uint32_t c = indices[t * 3 + 2];
+
+        uint32_t newVertices = (local[a] == NOT_IN_MESHLET) + (local[b] == NOT_IN_MESHLET) + (local[c] == NOT_IN_MESHLET);
+        if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount >= maxTriangles)
+        {
+            finish_meshlet();
+        }
+
+        for (uint32_t v : {a, b, c})
+        {
+            if (local[v] == NOT_IN_MESHLET)
+            {
+                local[v] = static_cast<uint8_t>(meshlet.vertexCount++);
+                builder.vertices.push_back(v);
+            }
+            builder.triangles.push_back(local[v]);
+        }
+        meshlet.triangleCount++;
+    }
+    finish_meshlet();
+}
+
+std::vector<char> assets::MeshletBuilder::pack(MeshInfo &info) const
+{
+    info.meshletCount = static_cast<uint32_t>(meshlets.size());
+    info.meshletVertexCount = static_cast<uint32_t>(vertices.size());
+    info.meshletTriangleCount = static_cast<uint32_t>(triangles.size() / 3);
+
+    std::vector<char> buffer(meshlet_buffer_size(info), 0);
+    char *write = buffer.data();
+    memcpy(write, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+    write += meshlets.size() * sizeof(Meshlet);
+    memcpy(write, vertices.data(), vertices.size() * sizeof(uint32_t));
+    write += vertices.size() * sizeof(uint32_t);
+    memcpy(write, triangles.data(), triangles.size());
+    return buffer;
+}
+
+uint32_t assets::select_index_size(size_t vertexCount)
+{
+    return vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+std::vector<char> assets::pack_indices(const std::vector<uint32_t> &indices, uint32_t indexSize)
+{
+    std::vector<char> output(indices.size() * indexSize);
+    if (indexSize == sizeof(uint32_t))
+    {
+        memcpy(output.data(), indices.data(), output.size());
+        return output;
+    }
+
+    uint16_t *shortIndices = reinterpret_cast<uint16_t *>(output.data());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        shortIndices[i] = static_cast<uint16_t>(indices[i]);
+    }
+    return output;
+}
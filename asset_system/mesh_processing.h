@@ -0,0 +1,71 @@
+#pragma once
+#include "mesh_asset.h"
+
+// mesh transforms the baker runs on the full precision vertices before they get converted and packed
+namespace assets
+{
+    // merges vertices that are bit for bit identical, rewriting the indices to point at the one that is kept.
+    // vertices keep the order they are first referenced in. Returns the new vertex count
+    size_t weld_vertices(std::vector<Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &indices);
+
+    // post-transform cache size the optimizer targets, and the analyzer simulates as a fifo
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    struct VertexCacheStats
+    {
+        // vertex shader invocations per triangle, 0.5 is the ideal on a regular grid, 3 is no reuse at all
+        float acmr;
+        // vertex shader invocations per vertex, 1 is the ideal
+        float atvr;
+    };
+    VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // reorders the triangles for post-transform cache hits with tipsify. clusterStarts gets the first triangle
+    // of every run that starts from a cold cache, optimize_overdraw can move those around without losing hits
+    void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertexCount, std::vector<uint32_t> &clusterStarts, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // splits the clusters further where it costs little cache efficiency, up to threshold times the acmr of the
+    // cluster, then sorts them so the ones facing out of the mesh get drawn first and occlude the rest
+    void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &clusterStarts, float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // reorders the vertices in the order the indices first use them, so vertex fetches walk memory forward
+    void optimize_vertex_fetch(std::vector<Vertex_f32_PNCV> &vertices, std::vector<uint32_t> &indices);
+
+    // simplifies the triangles down to about targetIndexCount indices, or until the surface would move further than
+    // maxError, by collapsing edges with the least quadric error. Only vertices get removed, so the result indexes the
+    // same vertex list. Border and uv or normal seam vertices only collapse along their border or seam, vertices where
+    // several of them meet are locked. resultError gets how far the surface moved, in mesh units
+    std::vector<uint32_t> simplify_mesh(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, size_t targetIndexCount, float maxError, float *resultError = nullptr);
+
+    struct MeshLodLevel
+    {
+        std::vector<uint32_t> indices;
+        float error;
+    };
+
+    // lod 0 is the input, every other one is simplified from it down to half the triangles of the previous one.
+    // Stops at maxLods, under MESH_LOD_MIN_TRIANGLES, or when a lod would not be at least 20% smaller than the last within maxError
+    std::vector<MeshLodLevel> build_lod_chain(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, uint32_t maxLods, float maxError);
+    constexpr uint32_t MESH_LOD_MIN_TRIANGLES = 32;
+
+    // meshlets and the vertex and triangle lists they point into, appended to by build_meshlets
+    struct MeshletBuilder
+    {
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> vertices;
+        std::vector<uint8_t> triangles;
+
+        // in the layout of the meshlet buffer of a mesh asset, with the counts for its MeshInfo
+        std::vector<char> pack(MeshInfo &info) const;
+    };
+
+    // splits the triangles into meshlets in the order they come, so run it on cache optimized indices to get
+    // meshlets that are spatially close. Every meshlet gets its bounding sphere and normal cone
+    void build_meshlets(const std::vector<Vertex_f32_PNCV> &vertices, const std::vector<uint32_t> &indices, MeshletBuilder &builder,
+                        uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    // 2 when every index fits in 16 bits, 4 otherwise
+    uint32_t select_index_size(size_t vertexCount);
+    // index buffer with indexSize bytes per index
+    std::vector<char> pack_indices(const std::vector<uint32_t> &indices, uint32_t indexSize);
+}
@@ -0,0 +1,450 @@
+#include "obj_loader.h"
+#include "asset_loader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace assets;
+
+// below this the whole file is a single chunk parsed on the calling thread
+constexpr size_t OBJ_PARALLEL_MIN_SIZE = 1024 * 1024;
+
+// a line aligned range of the file, and what it holds
+struct ObjChunk
+{
+    const char *begin;
+    const char *end;
+
+    size_t positionCount{0};
+    size_t normalCount{0};
+    size_t texcoordCount{0};
+    size_t cornerCount{0};
+
+    // where its attributes start in the merged arrays, from the counts of the chunks before it
+    size_t positionOffset{0};
+    size_t normalOffset{0};
+    size_t texcoordOffset{0};
+    size_t cornerOffset{0};
+
+    std::string error;
+};
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && is_space(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *skip_token(const char *p, const char *end)
+{
+    while (p < end && !is_space(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static const double POWERS_OF_10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// a mantissa and a power of ten that are both exact doubles give the correctly rounded double of the decimal.
+// Rounding that to float matches rounding the decimal itself, unless the double lands exactly between two floats
+static bool fast_parse_float(uint64_t mantissa, int exponent, float &value)
+{
+    if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+        return false;
+
+    double result = exponent < 0 ? double(mantissa) / POWERS_OF_10[-exponent] : double(mantissa) * POWERS_OF_10[exponent];
+    float rounded = float(result);
+    if (double(rounded) != result)
+    {
+        float other = std::nextafter(rounded, result > double(rounded) ? INFINITY : 0.f);
+        if ((double(rounded) + double(other)) * 0.5 == result)
+            return false;
+    }
+    value = rounded;
+    return true;
+}
+
+// strtof is slow and depends on the locale. The short decimals obj exporters write take the fast path above,
+// anything else goes through from_chars. Both round exactly like strtof
+static const char *parse_float(const char *p, const char *end, float &value)
+{
+    p = skip_spaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    const char *number = p;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    // nonzero digits past the 19 that fit the mantissa were dropped
+    bool truncated = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+        {
+            truncated |= *p != '0';
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+            {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            e = std::min(e * 10 + (*p - '0'), 100000);
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    float result = 0.f;
+    if (truncated || !fast_parse_float(mantissa, exponent, result))
+    {
+        std::from_chars_result parsed = std::from_chars(number, p, result);
+        if (parsed.ec == std::errc::result_out_of_range)
+        {
+            result = exponent < 0 ? 0.f : INFINITY;
+        }
+        else if (parsed.ec != std::errc{})
+        {
+            result = 0.f;
+        }
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+static const char *parse_int(const char *p, const char *end, int64_t &value, bool &found)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    value = 0;
+    found = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        value = value * 10 + (*p - '0');
+        found = true;
+    }
+    if (negative)
+    {
+        value = -value;
+    }
+    return p;
+}
+
+// the corners of a face line, polygons with n corners become n - 2 triangles
+static size_t count_face_corners(const char *p, const char *end)
+{
+    size_t corners = 0;
+    for (p = skip_spaces(p, end); p < end && *p != '#'; p = skip_spaces(p, end))
+    {
+        p = skip_token(p, end);
+        corners++;
+    }
+    return corners >= 3 ? (corners - 2) * 3 : 0;
+}
+
+// calls onLine with the start of every line and the end without the line break
+template <typename F>
+static void for_each_line(const ObjChunk &chunk, F &&onLine)
+{
+    const char *line = chunk.begin;
+    while (line < chunk.end)
+    {
+        const char *lineEnd = (const char *)memchr(line, '\n', chunk.end - line);
+        if (!lineEnd)
+        {
+            lineEnd = chunk.end;
+        }
+        const char *p = skip_spaces(line, lineEnd);
+        if (p + 1 < lineEnd)
+        {
+            onLine(p, lineEnd);
+        }
+        line = lineEnd + 1;
+    }
+}
+
+static void count_chunk(ObjChunk &chunk)
+{
+    for_each_line(chunk, [&](const char *p, const char *end)
+                  {
+        if (p[0] == 'v')
+        {
+            if (is_space(p[1]))
+                chunk.positionCount++;
+            else if (p[1] == 'n' && p + 2 < end && is_space(p[2]))
+                chunk.normalCount++;
+            else if (p[1] == 't' && p + 2 < end && is_space(p[2]))
+                chunk.texcoordCount++;
+        }
+        else if (p[0] == 'f' && is_space(p[1]))
+        {
+            chunk.cornerCount += count_face_corners(p + 2, end);
+        } });
+}
+
+// turns an obj index, 1 based or relative to the end when negative, into an array index. -1 when out of range
+static int32_t resolve_index(int64_t index, size_t countSoFar, size_t total)
+{
+    int64_t resolved = index < 0 ? int64_t(countSoFar) + index : index - 1;
+    return resolved >= 0 && resolved < int64_t(total) ? int32_t(resolved) : -1;
+}
+
+static void parse_chunk(ObjChunk &chunk, ObjMesh &mesh)
+{
+    size_t positions = chunk.positionOffset;
+    size_t normals = chunk.normalOffset;
+    size_t texcoords = chunk.texcoordOffset;
+    ObjIndex *corners = mesh.indices.data() + chunk.cornerOffset;
+
+    // the corners of the polygon being fanned
+    std::vector<ObjIndex> polygon;
+    for_each_line(chunk, [&](const char *p, const char *end)
+                  {
+        if (!chunk.error.empty())
+            return;
+
+        if (p[0] == 'v')
+        {
+            if (is_space(p[1]))
+            {
+                float *position = mesh.positions.data() + positions++ * 3;
+                p = parse_float(p + 2, end, position[0]);
+                p = parse_float(p, end, position[1]);
+                parse_float(p, end, position[2]);
+            }
+            else if (p[1] == 'n' && p + 2 < end && is_space(p[2]))
+            {
+                float *normal = mesh.normals.data() + normals++ * 3;
+                p = parse_float(p + 3, end, normal[0]);
+                p = parse_float(p, end, normal[1]);
+                parse_float(p, end, normal[2]);
+            }
+            else if (p[1] == 't' && p + 2 < end && is_space(p[2]))
+            {
+                float *uv = mesh.texcoords.data() + texcoords++ * 2;
+                p = parse_float(p + 3, end, uv[0]);
+                parse_float(p, end, uv[1]);
+            }
+            return;
+        }
+        if (p[0] != 'f' || !is_space(p[1]))
+            return;
+
+        polygon.clear();
+        for (p = skip_spaces(p + 2, end); p < end && *p != '#'; p = skip_spaces(p, end))
+        {
+            int64_t value;
+            bool found;
+            ObjIndex corner{-1, -1, -1};
+
+            p = parse_int(p, end, value, found);
+            corner.position = found ? resolve_index(value, positions, mesh.positions.size() / 3) : -1;
+            if (p < end && *p == '/')
+            {
+                p = parse_int(p + 1, end, value, found);
+                corner.texcoord = found ? resolve_index(value, texcoords, mesh.texcoords.size() / 2) : -1;
+                if (found && corner.texcoord < 0)
+                {
+                    chunk.error = "face uv index out of range";
+                    return;
+                }
+            }
+            if (p < end && *p == '/')
+            {
+                p = parse_int(p + 1, end, value, found);
+                corner.normal = found ? resolve_index(value, normals, mesh.normals.size() / 3) : -1;
+                if (found && corner.normal < 0)
+                {
+                    chunk.error = "face normal index out of range";
+                    return;
+                }
+            }
+            if (corner.position < 0)
+            {
+                chunk.error = "face position index out of range";
+                return;
+            }
+            polygon.push_back(corner);
+            p = skip_token(p, end);
+        }
+
+        for (size_t i = 2; i < polygon.size(); i++)
+        {
+            *corners++ = polygon[0];
+            *corners++ = polygon[i - 1];
+            *corners++ = polygon[i];
+        } });
+}
+
+// runs task(i) for every i below count, on up to threadCount threads including the calling one
+template <typename F>
+static void run_parallel(size_t count, uint32_t threadCount, F &&task)
+{
+    threadCount = std::min<uint32_t>(threadCount, static_cast<uint32_t>(count));
+    if (threadCount <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            task(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (uint32_t i = 0; i < threadCount - 1; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+}
+
+bool assets::load_obj(const char *path, ObjMesh &mesh, std::string &error, uint32_t maxThreads)
+{
+    FileMapping mapping;
+    if (!map_file(path, mapping))
+    {
+        error = std::string{"Failed to open obj file "} + path;
+        return false;
+    }
+
+    std::vector<ObjChunk> chunks;
+    const char *fileEnd = mapping.data + mapping.size;
+    for (const char *begin = mapping.data; begin < fileEnd;)
+    {
+        const char *end = begin + std::min<size_t>(OBJ_CHUNK_SIZE, fileEnd - begin);
+        // move the end past the next line break, so no line is split between chunks
+        const char *lineBreak = end < fileEnd ? (const char *)memchr(end, '\n', fileEnd - end) : nullptr;
+        end = lineBreak ? lineBreak + 1 : fileEnd;
+
+        ObjChunk chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(std::move(chunk));
+        begin = end;
+    }
+
+    uint32_t threadCount = maxThreads != 0 ? maxThreads : std::thread::hardware_concurrency();
+    if (mapping.size < OBJ_PARALLEL_MIN_SIZE)
+    {
+        threadCount = 1;
+    }
+
+    run_parallel(chunks.size(), threadCount, [&](size_t i)
+                 { count_chunk(chunks[i]); });
+
+    ObjChunk totals;
+    for (auto &chunk : chunks)
+    {
+        chunk.positionOffset = totals.positionCount;
+        chunk.normalOffset = totals.normalCount;
+        chunk.texcoordOffset = totals.texcoordCount;
+        chunk.cornerOffset = totals.cornerCount;
+        totals.positionCount += chunk.positionCount;
+        totals.normalCount += chunk.normalCount;
+        totals.texcoordCount += chunk.texcoordCount;
+        totals.cornerCount += chunk.cornerCount;
+    }
+
+    // exact sizes, every chunk writes its own range
+    mesh.positions.assign(totals.positionCount * 3, 0.f);
+    mesh.normals.assign(totals.normalCount * 3, 0.f);
+    mesh.texcoords.assign(totals.texcoordCount * 2, 0.f);
+    mesh.indices.assign(totals.cornerCount, ObjIndex{-1, -1, -1});
+
+    run_parallel(chunks.size(), threadCount, [&](size_t i)
+                 { parse_chunk(chunks[i], mesh); });
+
+    unmap_file(mapping);
+
+    for (auto &chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            error = std::string{path} + ": " + chunk.error;
+            return false;
+        }
+    }
+    return true;
+}
+
+ObjVertex assets::obj_corner(const ObjMesh &mesh, size_t corner)
+{
+    const ObjIndex &index = mesh.indices[corner];
+    ObjVertex vertex{};
+    memcpy(vertex.position, mesh.positions.data() + size_t(index.position) * 3, sizeof(vertex.position));
+    if (index.normal >= 0)
+    {
+        memcpy(vertex.normal, mesh.normals.data() + size_t(index.normal) * 3, sizeof(vertex.normal));
+    }
+    if (index.texcoord >= 0)
+    {
+        memcpy(vertex.uv, mesh.texcoords.data() + size_t(index.texcoord) * 2, sizeof(vertex.uv));
+    }
+    return vertex;
+}
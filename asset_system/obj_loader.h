@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace assets
+{
+    // one corner of a face, indexing the attribute arrays of ObjMesh. -1 when the face has no normal or uv
+    struct ObjIndex
+    {
+        int32_t position;
+        int32_t normal;
+        int32_t texcoord;
+    };
+
+    // the attributes of an obj file, each indexed on its own like in the file. Polygons are fanned into triangles
+    struct ObjMesh
+    {
+        // 3 floats per position and normal, 2 per uv
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        // 3 corners per triangle
+        std::vector<ObjIndex> indices;
+    };
+
+    // a face corner with its attributes looked up, missing ones are zero
+    struct ObjVertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    // the file is split into chunks of about this size, ending at line breaks, that are parsed in parallel
+    constexpr size_t OBJ_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    // memory maps the file and parses it over maxThreads threads, 0 uses every core. Every chunk is read twice,
+    // once to count what it holds and once to parse straight into its place in the output, so nothing is copied
+    // after parsing and the file itself is never held in memory. Only v, vn, vt and f lines are read.
+    // returns false with a message in error when the file cant be mapped or a face points at a missing attribute
+    bool load_obj(const char *path, ObjMesh &mesh, std::string &error, uint32_t maxThreads = 0);
+
+    ObjVertex obj_corner(const ObjMesh &mesh, size_t corner);
+}
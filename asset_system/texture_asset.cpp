@@ -1,32 +1,74 @@
 #include "texture_asset.h"
+#include "asset_dictionary.h"
 #include <json.hpp>
 #include <lz4.h>
 #include <iostream>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
 
-assets::TextureFormat parse_format(const char *f)
+static const char *TEXTURE_FORMAT_NAMES[] = {"Unknown", "RGBA8", "BC1", "BC3", "BC4", "BC5", "BC7"};
+
+assets::TextureFormat assets::parse_texture_format(const char *f)
 {
-    if (strcmp(f, "RGBA8") == 0)
+    for (uint32_t i = 1; i < std::size(TEXTURE_FORMAT_NAMES); i++)
     {
-        return assets::TextureFormat::RGBA8;
+        if (strcmp(f, TEXTURE_FORMAT_NAMES[i]) == 0)
+        {
+            return TextureFormat(i);
+        }
     }
-    else
+    return TextureFormat::Unknown;
+}
+
+const char *assets::texture_format_name(TextureFormat format)
+{
+    uint32_t index = uint32_t(format);
+    return index < std::size(TEXTURE_FORMAT_NAMES) ? TEXTURE_FORMAT_NAMES[index] : TEXTURE_FORMAT_NAMES[0];
+}
+
+bool assets::is_block_compressed(TextureFormat format)
+{
+    return format >= TextureFormat::BC1 && format <= TextureFormat::BC7;
+}
+
+uint64_t assets::texture_page_size(TextureFormat format, uint32_t width, uint32_t height)
+{
+    uint64_t blocks = uint64_t((width + 3) / 4) * ((height + 3) / 4);
+    switch (format)
     {
-        return assets::TextureFormat::Unknown;
+    case TextureFormat::RGBA8:
+        return uint64_t(width) * height * 4;
+    case TextureFormat::BC1:
+    case TextureFormat::BC4:
+        return blocks * 8;
+    case TextureFormat::BC3:
+    case TextureFormat::BC5:
+    case TextureFormat::BC7:
+        return blocks * 16;
+    default:
+        return 0;
     }
 }
 
-assets::TextureInfo assets::read_texture_info(AssetFile *file)
+static assets::TextureInfo parse_texture_json(const char *jsonBegin, const char *jsonEnd)
 {
+    using namespace assets;
     TextureInfo info;
-    nlohmann::json texture_metadata = nlohmann::json::parse(file->json);
+    nlohmann::json texture_metadata = nlohmann::json::parse(jsonBegin, jsonEnd);
 
     std::string formatString = texture_metadata["format"];
-    info.textureFormat = parse_format(formatString.c_str());
+    info.textureFormat = parse_texture_format(formatString.c_str());
+    info.colorSpace = texture_metadata.value("color_space", std::string{}) == "sRGB" ? ColorSpace::SRGB : ColorSpace::Linear;
 
     std::string compressionString = texture_metadata["compression"];
     info.compressionMode = parse_compression(compressionString.c_str());
     info.textureSize = texture_metadata["buffer_size"];
     info.originalFile = texture_metadata["original_file"];
+    // files from before pages were split into blocks dont have the field
+    info.blockSize = texture_metadata.value("block_size", 0u);
 
     for (auto &[key, value] : texture_metadata["pages"].items())
     {
@@ -38,55 +80,409 @@ assets::TextureInfo assets::read_texture_info(AssetFile *file)
         info.pages.push_back(page);
     }
 
+    // older files dont store the offset table, rebuild it from the page sizes
+    auto offsets = texture_metadata.find("page_offsets");
+    if (offsets != texture_metadata.end() && offsets->size() == info.pages.size())
+    {
+        info.pageOffsets = offsets->get<std::vector<uint64_t>>();
+    }
+    else
+    {
+        build_page_offsets(&info);
+    }
+
     return info;
 }
 
-void assets::unpack_texture(TextureInfo *info, const char *sourcebuffer, size_t sourceSize, char *destination)
+void assets::build_page_offsets(TextureInfo *info)
+{
+    info->pageOffsets.resize(info->pages.size());
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < info->pages.size(); i++)
+    {
+        info->pageOffsets[i] = offset;
+        offset += info->pages[i].compressedSize;
+    }
+}
+
+bool assets::read_texture_metadata(std::string_view binaryMetadata, TextureMetadataView &view)
+{
+    if (binaryMetadata.size() < sizeof(TextureMetadataBinary))
+        return false;
+
+    memcpy(&view.header, binaryMetadata.data(), sizeof(TextureMetadataBinary));
+
+    size_t pageTableSize = size_t(view.header.pageCount) * sizeof(TexturePageBinary);
+    if (sizeof(TextureMetadataBinary) + pageTableSize + view.header.originalFileLength > binaryMetadata.size())
+        return false;
+
+    view.pageTable = binaryMetadata.data() + sizeof(TextureMetadataBinary);
+    view.originalFile = std::string_view(view.pageTable + pageTableSize, view.header.originalFileLength);
+    return true;
+}
+
+assets::PageInfo assets::TextureMetadataView::page(uint32_t index) const
+{
+    TexturePageBinary record;
+    memcpy(&record, pageTable + index * sizeof(TexturePageBinary), sizeof(TexturePageBinary));
+
+    PageInfo page;
+    page.width = record.width;
+    page.height = record.height;
+    page.compressedSize = record.compressedSize;
+    page.originalSize = record.originalSize;
+    return page;
+}
+
+uint64_t assets::TextureMetadataView::page_offset(uint32_t index) const
+{
+    uint64_t offset;
+    memcpy(&offset, pageTable + index * sizeof(TexturePageBinary) + offsetof(TexturePageBinary, offset), sizeof(uint64_t));
+    return offset;
+}
+
+static bool read_texture_binary(std::string_view binaryMetadata, assets::TextureInfo &info)
+{
+    using namespace assets;
+    TextureMetadataView view;
+    if (!read_texture_metadata(binaryMetadata, view))
+        return false;
+
+    info.textureSize = view.header.textureSize;
+    info.textureFormat = TextureFormat(view.header.textureFormat);
+    info.colorSpace = ColorSpace(view.header.colorSpace);
+    info.compressionMode = CompressionMode(view.header.compressionMode);
+    info.blockSize = view.header.blockSize;
+    info.originalFile = std::string(view.originalFile);
+
+    info.pages.resize(view.header.pageCount);
+    info.pageOffsets.resize(view.header.pageCount);
+    for (uint32_t i = 0; i < view.header.pageCount; i++)
+    {
+        info.pages[i] = view.page(i);
+        info.pageOffsets[i] = view.page_offset(i);
+    }
+    return true;
+}
+
+static std::vector<char> write_texture_binary(const assets::TextureInfo &info)
+{
+    using namespace assets;
+    TextureMetadataBinary header = {};
+    header.textureSize = info.textureSize;
+    header.textureFormat = uint32_t(info.textureFormat);
+    header.colorSpace = uint32_t(info.colorSpace);
+    header.compressionMode = uint32_t(info.compressionMode);
+    header.blockSize = info.blockSize;
+    header.pageCount = static_cast<uint32_t>(info.pages.size());
+    header.originalFileLength = static_cast<uint32_t>(info.originalFile.size());
+
+    std::vector<char> metadata(sizeof(TextureMetadataBinary) + info.pages.size() * sizeof(TexturePageBinary) + info.originalFile.size());
+    char *cursor = metadata.data();
+    memcpy(cursor, &header, sizeof(TextureMetadataBinary));
+    cursor += sizeof(TextureMetadataBinary);
+
+    for (size_t i = 0; i < info.pages.size(); i++)
+    {
+        TexturePageBinary record;
+        record.offset = info.pageOffsets[i];
+        record.width = info.pages[i].width;
+        record.height = info.pages[i].height;
+        record.compressedSize = info.pages[i].compressedSize;
+        record.originalSize = info.pages[i].originalSize;
+        memcpy(cursor, &record, sizeof(TexturePageBinary));
+        cursor += sizeof(TexturePageBinary);
+    }
+    memcpy(cursor, info.originalFile.data(), info.originalFile.size());
+
+    return metadata;
+}
+
+assets::TextureInfo assets::read_texture_info(const AssetFile *file)
+{
+    TextureInfo info;
+    if (!read_texture_binary(std::string_view(file->binaryMetadata.data(), file->binaryMetadata.size()), info))
+    {
+        info = parse_texture_json(file->json.data(), file->json.data() + file->json.size());
+    }
+    info.dictionaryId = file->dictionaryId;
+    return info;
+}
+
+assets::TextureInfo assets::read_texture_info(AssetReader &reader)
+{
+    TextureInfo info;
+    std::vector<char> binaryMetadata;
+    if (!reader.read_binary_metadata(binaryMetadata) || !read_texture_binary(std::string_view(binaryMetadata.data(), binaryMetadata.size()), info))
+    {
+        std::string json;
+        reader.read_json(json);
+        info = parse_texture_json(json.data(), json.data() + json.size());
+    }
+    info.dictionaryId = reader.layout().dictionaryId;
+    return info;
+}
+
+assets::TextureInfo assets::read_texture_info(const MappedAssetFile *file)
+{
+    TextureInfo info;
+    if (!read_texture_binary(file->binaryMetadata, info))
+    {
+        info = parse_texture_json(file->json.data(), file->json.data() + file->json.size());
+    }
+    info.dictionaryId = file->dictionaryId;
+    return info;
+}
+
+// a contiguous piece of work for the unpacker. Either a whole page, or one block of a split page
+struct UnpackTask
+{
+    const char *source;
+    char *destination;
+    uint32_t compressedSize;
+    uint32_t originalSize;
+};
+
+// finds the dictionary the texture was compressed against. Fails if it needs one that was never registered
+static bool resolve_dictionary(const assets::TextureInfo *info, const assets::CompressionDictionary *&dictionary)
+{
+    dictionary = nullptr;
+    if (info->dictionaryId == 0)
+        return true;
+
+    dictionary = assets::find_dictionary(info->dictionaryId);
+    if (!dictionary)
+    {
+        std::cout << "Texture " << info->originalFile << " needs dictionary " << info->dictionaryId << " which is not loaded" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool run_unpack_task(const UnpackTask &task, const assets::CompressionDictionary *dictionary)
+{
+    // blocks and pages that did not compress are stored raw, with matching sizes
+    if (task.compressedSize == task.originalSize)
+    {
+        memcpy(task.destination, task.source, task.originalSize);
+        return true;
+    }
+    return assets::decompress_block(dictionary, task.source, task.destination, task.compressedSize, task.originalSize);
+}
+
+// sourceSize is what is left of the blob from source on, and destinationSize what is left of the destination.
+// A page that claims more than either is corrupt
+static bool add_page_tasks(const assets::TextureInfo *info, const assets::PageInfo &page, const char *source, uint64_t sourceSize, char *destination, uint64_t destinationSize, std::vector<UnpackTask> &tasks)
+{
+    if (page.originalSize > destinationSize)
+        return false;
+    bool splitPage = info->blockSize != 0 && page.originalSize > info->blockSize;
+
+    if (!assets::is_lz4_compressed(info->compressionMode))
+    {
+        if (page.originalSize > sourceSize)
+            return false;
+        tasks.push_back({source, destination, page.originalSize, page.originalSize});
+        return true;
+    }
+
+    if (page.compressedSize > sourceSize)
+        return false;
+
+    if (page.compressedSize == page.originalSize || !splitPage)
+    {
+        tasks.push_back({source, destination, page.compressedSize, page.originalSize});
+        return true;
+    }
+
+    // split pages are a sequence of independent blocks, each prefixed with its compressed size
+    uint64_t available = page.compressedSize;
+    uint32_t remaining = page.originalSize;
+    while (remaining > 0)
+    {
+        uint32_t blockOriginal = std::min(remaining, info->blockSize);
+        if (available < sizeof(uint32_t))
+            return false;
+        uint32_t blockCompressed;
+        memcpy(&blockCompressed, source, sizeof(uint32_t));
+        source += sizeof(uint32_t);
+        available -= sizeof(uint32_t);
+
+        if (blockCompressed > blockOriginal || blockCompressed > available)
+            return false;
+
+        tasks.push_back({source, destination, blockCompressed, blockOriginal});
+
+        source += blockCompressed;
+        available -= blockCompressed;
+        destination += blockOriginal;
+        remaining -= blockOriginal;
+    }
+    return true;
+}
+
+bool assets::unpack_texture(TextureInfo *info, const char *sourcebuffer, size_t sourceSize, char *destination, TaskPool *pool)
 {
-    if (info->compressionMode == CompressionMode::LZ4)
+    // the destination only has room for textureSize bytes, corrupt page sizes must not write past it.
+    // Raw textures are checked too, callers read the pages back from the destination
+    uint64_t unpackedSize = 0;
+    for (auto &page : info->pages)
+    {
+        unpackedSize += page.originalSize;
+    }
+    if (unpackedSize > info->textureSize)
+        return false;
+
+    if (!is_lz4_compressed(info->compressionMode))
+    {
+        if (sourceSize < info->textureSize)
+            return false;
+        memcpy(destination, sourcebuffer, info->textureSize);
+        return true;
+    }
+
+    const CompressionDictionary *dictionary;
+    if (!resolve_dictionary(info, dictionary))
+        return false;
+
+    std::vector<UnpackTask> tasks;
+    uint64_t offset = 0;
+    uint64_t destinationLeft = info->textureSize;
+    for (auto &page : info->pages)
     {
-        for (auto &page : info->pages)
+        if (offset > sourceSize || !add_page_tasks(info, page, sourcebuffer + offset, sourceSize - offset, destination, destinationLeft, tasks))
+            return false;
+        offset += page.compressedSize;
+        destination += page.originalSize;
+        destinationLeft -= page.originalSize;
+    }
+
+    // not worth waking the pool for small textures
+    if (!pool || pool->thread_count() <= 1 || info->textureSize < PARALLEL_UNPACK_MIN_SIZE)
+    {
+        for (auto &task : tasks)
         {
-            LZ4_decompress_safe(sourcebuffer, destination, page.compressedSize, page.originalSize);
-            sourcebuffer += page.compressedSize;
-            destination += page.originalSize;
+            if (!run_unpack_task(task, dictionary))
+                return false;
         }
+        return true;
     }
-    else
+
+    // biggest tasks first, so the tail of small mips fills the gaps at the end
+    std::sort(tasks.begin(), tasks.end(), [](const UnpackTask &a, const UnpackTask &b)
+              { return a.originalSize > b.originalSize; });
+
+    std::atomic<bool> failed{false};
+    pool->parallel_for(static_cast<uint32_t>(tasks.size()), [&](uint32_t index)
+                       {
+        if (!failed.load(std::memory_order_relaxed) && !run_unpack_task(tasks[index], dictionary))
+        {
+            failed = true;
+        } });
+    return !failed;
+}
+
+bool assets::unpack_texture_page(TextureInfo *info, int pageIndex, const char *sourcebuffer, size_t sourceSize, char *destination)
+{
+    if (pageIndex < 0 || pageIndex >= int(info->pages.size()))
+        return false;
+    if (info->pageOffsets.size() != info->pages.size())
+    {
+        build_page_offsets(info);
+    }
+    uint64_t offset = info->pageOffsets[pageIndex];
+    if (offset > sourceSize)
+        return false;
+
+    const CompressionDictionary *dictionary;
+    if (!resolve_dictionary(info, dictionary))
+        return false;
+
+    std::vector<UnpackTask> tasks;
+    const PageInfo &page = info->pages[pageIndex];
+    if (!add_page_tasks(info, page, sourcebuffer + offset, sourceSize - offset, destination, page.originalSize, tasks))
+        return false;
+    for (auto &task : tasks)
     {
-        memcpy(destination, sourcebuffer, sourceSize);
+        if (!run_unpack_task(task, dictionary))
+            return false;
     }
+    return true;
 }
 
-void assets::unpack_texture_page(TextureInfo *info, int pageIndex, char *sourcebuffer, char *destination)
+bool assets::unpack_texture_page(TextureInfo *info, int pageIndex, AssetReader &reader, char *destination)
 {
-    char *source = sourcebuffer;
-    for (int i = 0; i < pageIndex; i++)
+    if (pageIndex < 0 || pageIndex >= int(info->pages.size()))
+        return false;
+    if (info->pageOffsets.size() != info->pages.size())
+    {
+        build_page_offsets(info);
+    }
+    const PageInfo &page = info->pages[pageIndex];
+    uint64_t offset = info->pageOffsets[pageIndex];
+
+    // raw pages go straight into the destination
+    if (!is_lz4_compressed(info->compressionMode) || page.compressedSize == page.originalSize)
+    {
+        return reader.read_blob(offset, page.originalSize, destination);
+    }
+
+    const CompressionDictionary *dictionary;
+    if (!resolve_dictionary(info, dictionary))
+        return false;
+
+    std::vector<char> scratch;
+    bool splitPage = info->blockSize != 0 && page.originalSize > info->blockSize;
+    if (!splitPage)
     {
-        source += info->pages[i].compressedSize;
+        scratch.resize(page.compressedSize);
+        if (!reader.read_blob(offset, page.compressedSize, scratch.data()))
+            return false;
+
+        return decompress_block(dictionary, scratch.data(), destination, page.compressedSize, page.originalSize);
     }
 
-    if (info->compressionMode == CompressionMode::LZ4)
+    // every read grabs a block together with the size prefix of the next one, so each block is a single read
+    scratch.resize(info->blockSize + sizeof(uint32_t));
+    uint32_t blockCompressed;
+    if (!reader.read_blob(offset, sizeof(uint32_t), (char *)&blockCompressed))
+        return false;
+    offset += sizeof(uint32_t);
+
+    uint32_t remaining = page.originalSize;
+    while (remaining > 0)
     {
+        uint32_t blockOriginal = std::min(remaining, info->blockSize);
+        bool lastBlock = blockOriginal == remaining;
+        if (blockCompressed > blockOriginal)
+            return false;
+
+        uint32_t readSize = blockCompressed + (lastBlock ? 0 : sizeof(uint32_t));
+        if (!reader.read_blob(offset, readSize, scratch.data()))
+            return false;
+        offset += readSize;
 
-        // size doesnt fully match, its compressed
-        if (info->pages[pageIndex].compressedSize != info->pages[pageIndex].originalSize)
+        if (blockCompressed == blockOriginal)
         {
-            LZ4_decompress_safe(source, destination, info->pages[pageIndex].compressedSize, info->pages[pageIndex].originalSize);
+            memcpy(destination, scratch.data(), blockOriginal);
         }
-        else
+        else if (!decompress_block(dictionary, scratch.data(), destination, blockCompressed, blockOriginal))
         {
-            // size matched, uncompressed page
-            memcpy(destination, source, info->pages[pageIndex].originalSize);
+            return false;
         }
+
+        if (!lastBlock)
+        {
+            memcpy(&blockCompressed, scratch.data() + blockCompressed, sizeof(uint32_t));
+        }
+        destination += blockOriginal;
+        remaining -= blockOriginal;
     }
-    else
-    {
-        memcpy(destination, source, info->pages[pageIndex].originalSize);
-    }
+    return true;
 }
 
-assets::AssetFile assets::pack_texture(TextureInfo *info, void *pixelData)
+assets::AssetFile assets::pack_texture(TextureInfo *info, void *pixelData, const CompressionPolicy &policy, bool writeJson)
 {
     // core file header
     AssetFile file;
@@ -96,44 +492,96 @@ assets::AssetFile assets::pack_texture(TextureInfo *info, void *pixelData)
     file.type[3] = 'I';
     file.version = 1;
 
+    info->blockSize = TEXTURE_BLOCK_SIZE;
+
     char *pixels = (char *)pixelData;
     std::vector<char> page_buffer;
+    std::vector<char> block_buffer;
     for (auto &p : info->pages)
     {
-        page_buffer.resize(p.originalSize);
-        // compress buffer into blob
-        // find the maximum data needed for the compression
-        int compressStaging = LZ4_compressBound(p.originalSize);
-        // make sure the blob storage has enough size for the maximum
-        page_buffer.resize(compressStaging);
-        // this is like a memcpy, except it compresses the data and returns the compressed size
-        int compressedSize = LZ4_compress_default(pixels, page_buffer.data(), p.originalSize, compressStaging);
-        float compression_rate = float(compressedSize) / float(info->textureSize);
-
-        // if the compression is more than 80% of the original size, its not worth to use it
-        if (compression_rate > 0.8)
+        page_buffer.clear();
+
+        if (policy.mode == CompressionMode::None)
         {
-            compressedSize = p.originalSize;
-            page_buffer.resize(compressedSize);
-            memcpy(page_buffer.data(), pixels, compressedSize);
+            page_buffer.assign(pixels, pixels + p.originalSize);
+        }
+        else if (p.originalSize > info->blockSize)
+        {
+            // big pages get split into independent blocks so they can be decompressed in parallel or a block at a time.
+            // each block is stored as its compressed size followed by the data
+            uint32_t remaining = p.originalSize;
+            char *blockPixels = pixels;
+            while (remaining > 0)
+            {
+                uint32_t blockOriginal = std::min(remaining, info->blockSize);
+                int compressStaging = LZ4_compressBound(blockOriginal);
+                block_buffer.resize(compressStaging);
+
+                uint32_t blockCompressed = compress_block(policy, blockPixels, block_buffer.data(), blockOriginal, compressStaging);
+                // matching sizes means a raw block, so a block that did not shrink is stored as is
+                if (blockCompressed >= blockOriginal)
+                {
+                    blockCompressed = blockOriginal;
+                    memcpy(block_buffer.data(), blockPixels, blockOriginal);
+                }
+
+                const char *sizeBytes = (const char *)&blockCompressed;
+                page_buffer.insert(page_buffer.end(), sizeBytes, sizeBytes + sizeof(uint32_t));
+                page_buffer.insert(page_buffer.end(), block_buffer.begin(), block_buffer.begin() + blockCompressed);
+
+                blockPixels += blockOriginal;
+                remaining -= blockOriginal;
+            }
         }
         else
         {
+            // compress buffer into blob
+            // find the maximum data needed for the compression
+            int compressStaging = LZ4_compressBound(p.originalSize);
+            // make sure the blob storage has enough size for the maximum
+            page_buffer.resize(compressStaging);
+            // this is like a memcpy, except it compresses the data and returns the compressed size
+            int compressedSize = compress_block(policy, pixels, page_buffer.data(), p.originalSize, compressStaging);
             // we can now resize the blob down to the final compressed size.
             page_buffer.resize(compressedSize);
         }
-        p.compressedSize = compressedSize;
+
+        float compression_rate = float(page_buffer.size()) / float(p.originalSize);
+
+        // if the compression is more than 80% of the original size, its not worth to use it.
+        // a page that ended up exactly its original size would also be read back as raw
+        if (compression_rate > policy.maxRatio || page_buffer.size() >= p.originalSize)
+        {
+            page_buffer.resize(p.originalSize);
+            memcpy(page_buffer.data(), pixels, p.originalSize);
+        }
+        p.compressedSize = static_cast<uint32_t>(page_buffer.size());
 
         file.binaryBlob.insert(file.binaryBlob.end(), page_buffer.begin(), page_buffer.end());
         // advance pixel pointer to next page
         pixels += p.originalSize;
     }
 
+    info->compressionMode = policy.mode;
+    info->dictionaryId = policy.dictionary && policy.mode != CompressionMode::None ? policy.dictionary->id : 0;
+    file.dictionaryId = info->dictionaryId;
+    build_page_offsets(info);
+    file.binaryMetadata = write_texture_binary(*info);
+
+    if (!writeJson)
+    {
+        return file;
+    }
+
     nlohmann::json texture_metadata;
-    texture_metadata["format"] = "RGBA8";
+    texture_metadata["format"] = texture_format_name(info->textureFormat);
+    texture_metadata["color_space"] = info->colorSpace == ColorSpace::SRGB ? "sRGB" : "linear";
     texture_metadata["buffer_size"] = info->textureSize;
     texture_metadata["original_file"] = info->originalFile;
-    texture_metadata["compression"] = "LZ4";
+    texture_metadata["compression"] = compression_name(info->compressionMode);
+    texture_metadata["block_size"] = info->blockSize;
+
+    texture_metadata["page_offsets"] = info->pageOffsets;
 
     std::vector<nlohmann::json> page_json;
     for (auto &p : info->pages)
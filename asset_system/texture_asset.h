@@ -0,0 +1,134 @@
+#pragma once
+#include "asset_loader.h"
+#include "asset_tasks.h"
+
+namespace assets
+{
+    enum class TextureFormat : uint32_t
+    {
+        Unknown = 0,
+        RGBA8,
+        // block compressed, every 4x4 pixel block is 8 bytes (BC1, BC4) or 16 bytes (BC3, BC5, BC7)
+        // rgb with no alpha
+        BC1,
+        // rgb with a separate alpha block
+        BC3,
+        // single channel, for masks like occlusion
+        BC4,
+        // two channels, for normal maps. z is rebuilt in the shader as sqrt(1 - x*x - y*y)
+        BC5,
+        // rgba at the quality of BC3 or better, for color with alpha and packed masks
+        BC7
+    };
+
+    // how the color channels are stored. sRGB textures are sampled through an sRGB format, so filtering happens in linear space
+    enum class ColorSpace : uint32_t
+    {
+        Linear = 0,
+        SRGB
+    };
+
+    TextureFormat parse_texture_format(const char *f);
+    const char *texture_format_name(TextureFormat format);
+    bool is_block_compressed(TextureFormat format);
+    // size in bytes of a single mip of that size. Block compressed mips are rounded up to whole 4x4 blocks
+    uint64_t texture_page_size(TextureFormat format, uint32_t width, uint32_t height);
+
+    struct PageInfo
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t compressedSize;
+        uint32_t originalSize;
+    };
+
+    // pages bigger than this get compressed as independent blocks, so a single big mip can be unpacked on many threads
+    // or streamed through a fixed size buffer
+    constexpr uint32_t TEXTURE_BLOCK_SIZE = 256 * 1024;
+    // textures smaller than this are unpacked on the calling thread, waking the pool costs more than it saves
+    constexpr uint64_t PARALLEL_UNPACK_MIN_SIZE = 1024 * 1024;
+
+    struct TextureInfo
+    {
+        uint64_t textureSize;
+        TextureFormat textureFormat;
+        ColorSpace colorSpace{ColorSpace::Linear};
+        CompressionMode compressionMode;
+        // 0 means every page is a single lz4 block
+        uint32_t blockSize{0};
+        // shared dictionary the pages were compressed against, 0 for none. Comes from the AssetFile
+        uint32_t dictionaryId{0};
+
+        std::string originalFile;
+        std::vector<PageInfo> pages;
+        // byte offset of every page inside the binary blob, for constant time access to a single page
+        std::vector<uint64_t> pageOffsets;
+    };
+
+    // fixed layout of the binary texture metadata. The header is followed by pageCount TexturePageBinary
+    // records and then the original file name, all sizes are multiples of 8 so the records stay aligned
+    struct TextureMetadataBinary
+    {
+        uint64_t textureSize;
+        uint32_t textureFormat;
+        uint32_t compressionMode;
+        uint32_t blockSize;
+        uint32_t pageCount;
+        uint32_t originalFileLength;
+        // was padding before color spaces were stored, so older files read as linear
+        uint32_t colorSpace;
+    };
+
+    struct TexturePageBinary
+    {
+        uint64_t offset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t compressedSize;
+        uint32_t originalSize;
+    };
+
+    // allocation free access to the binary metadata, pointing into the file it was read from
+    struct TextureMetadataView
+    {
+        TextureMetadataBinary header;
+        const char *pageTable;
+        std::string_view originalFile;
+
+        PageInfo page(uint32_t index) const;
+        uint64_t page_offset(uint32_t index) const;
+    };
+
+    // returns false if the block is not valid texture metadata
+    bool read_texture_metadata(std::string_view binaryMetadata, TextureMetadataView &view);
+
+    // convert the metadata of a file into the TextureInfo struct.
+    // the binary metadata is used when the file has it, the json is only parsed for older files
+    TextureInfo read_texture_info(const AssetFile *file);
+    TextureInfo read_texture_info(const MappedAssetFile *file);
+    // only reads the metadata sections, the blob stays on disk for unpack_texture_page to stream
+    TextureInfo read_texture_info(AssetReader &reader);
+    // fills pageOffsets from the compressed sizes of the pages
+    void build_page_offsets(TextureInfo *info);
+    // work with a texture info alongside the binary blob of pixel data,
+    // and will decompress the texture into the destination buffer.
+    // destination needs textureSize bytes. Returns false when the pages add up to more than that,
+    // or a page or block does not fit in sourceSize or fails to decompress.
+    // With a pool the pages and blocks are unpacked in parallel on it, the calling thread helps
+    bool unpack_texture(TextureInfo *info, const char *sourcebuffer, size_t sourceSize, char *destination, TaskPool *pool = nullptr);
+    // sourcebuffer can be the blob of a MappedAssetFile, which decompresses straight from the page cache
+    bool unpack_texture_page(TextureInfo *info, int pageIndex, const char *sourcebuffer, size_t sourceSize, char *destination);
+    // reads the page through the reader instead of from a resident blob. Split pages are read one block at a time,
+    // so no more than blockSize bytes of compressed data are held in memory
+    bool unpack_texture_page(TextureInfo *info, int pageIndex, AssetReader &reader, char *destination);
+    // writes the binary metadata, the json copy of it is only written when requested, for debugging.
+    // the policy picks between lz4 and lz4hc, both load with the same decoder
+    AssetFile pack_texture(TextureInfo *info, void *pixelData, const CompressionPolicy &policy = {}, bool writeJson = false);
+}
+
+//  example of how to load the data
+//  AllocatedBuffer stagingBuffer = engine.create_buffer(textureInfo.textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+//  void* data;
+//  vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
+//  assets::unpack_texture(&textureInfo, file.binaryBlob.data(), file.binaryBlob.size(), (char*)data);
+//  vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
\ No newline at end of file
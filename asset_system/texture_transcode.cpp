@@ -0,0 +1,563 @@
+#include "texture_transcode.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// the palettes and the bc7 interpolation work on all four channels at once with sse2, which every x64 cpu has
+#ifndef TRANSCODE_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSCODE_SSE2 1
+#else
+#define TRANSCODE_SSE2 0
+#endif
+#endif
+
+#if TRANSCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace assets;
+
+static inline uint32_t pack_rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static void expand_565(uint16_t color, uint32_t rgb[3])
+{
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 has no alpha in our format, the 3 color mode decodes its 4th entry as opaque black.
+// the color block of BC3 is always in 4 color mode
+static void decode_bc1_block(const uint8_t *block, uint32_t *pixels, bool fourColorOnly)
+{
+    uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+    uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+    uint32_t e0[3], e1[3];
+    expand_565(c0, e0);
+    expand_565(c1, e1);
+    bool fourColor = c0 > c1 || fourColorOnly;
+
+    uint32_t palette[4];
+    palette[0] = pack_rgba(e0[0], e0[1], e0[2], 255);
+    palette[1] = pack_rgba(e1[0], e1[1], e1[2], 255);
+#if TRANSCODE_SSE2
+    // lanes 0 to 3 make color 2 and lanes 4 to 7 color 3, mixing the endpoints in opposite order
+    __m128i a = _mm_setr_epi16(short(e0[0]), short(e0[1]), short(e0[2]), 255, short(e1[0]), short(e1[1]), short(e1[2]), 255);
+    __m128i b = _mm_setr_epi16(short(e1[0]), short(e1[1]), short(e1[2]), 255, short(e0[0]), short(e0[1]), short(e0[2]), 255);
+    __m128i mixed;
+    if (fourColor)
+    {
+        // (2a + b) / 3. For sums up to 765 the high half of the product with 21846 is the exact quotient
+        mixed = _mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(a, a), b), _mm_set1_epi16(21846));
+    }
+    else
+    {
+        mixed = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+    }
+    uint32_t colors[4];
+    _mm_storeu_si128((__m128i *)colors, _mm_packus_epi16(mixed, mixed));
+    palette[2] = colors[0];
+    palette[3] = colors[1];
+#else
+    if (fourColor)
+    {
+        palette[2] = pack_rgba((2 * e0[0] + e1[0]) / 3, (2 * e0[1] + e1[1]) / 3, (2 * e0[2] + e1[2]) / 3, 255);
+        palette[3] = pack_rgba((e0[0] + 2 * e1[0]) / 3, (e0[1] + 2 * e1[1]) / 3, (e0[2] + 2 * e1[2]) / 3, 255);
+    }
+    else
+    {
+        palette[2] = pack_rgba((e0[0] + e1[0]) / 2, (e0[1] + e1[1]) / 2, (e0[2] + e1[2]) / 2, 255);
+    }
+#endif
+    if (!fourColor)
+    {
+        palette[3] = pack_rgba(0, 0, 0, 255);
+    }
+
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        pixels[i] = palette[(indices >> (i * 2)) & 3];
+    }
+}
+
+// single channel block, shared by BC4, BC5 and the alpha of BC3
+static void decode_bc4_block(const uint8_t *block, uint8_t *values)
+{
+    uint32_t r0 = block[0];
+    uint32_t r1 = block[1];
+    uint8_t palette[8];
+#if TRANSCODE_SSE2
+    // every lane is one palette entry, ((n - i) * r0 + i * r1) / n with the division done as a multiply high
+    __m128i v0 = _mm_set1_epi16(short(r0));
+    __m128i v1 = _mm_set1_epi16(short(r1));
+    __m128i mixed;
+    if (r0 > r1)
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(v0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)), _mm_mullo_epi16(v1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+        mixed = _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+    }
+    else
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(v0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)), _mm_mullo_epi16(v1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+        mixed = _mm_mulhi_epu16(sum, _mm_set1_epi16(13108));
+    }
+    _mm_storel_epi64((__m128i *)palette, _mm_packus_epi16(mixed, mixed));
+#else
+    palette[0] = uint8_t(r0);
+    palette[1] = uint8_t(r1);
+    if (r0 > r1)
+    {
+        for (uint32_t i = 1; i < 7; i++)
+        {
+            palette[i + 1] = uint8_t(((7 - i) * r0 + i * r1) / 7);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 1; i < 5; i++)
+        {
+            palette[i + 1] = uint8_t(((5 - i) * r0 + i * r1) / 5);
+        }
+    }
+#endif
+    if (r0 <= r1)
+    {
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        indices |= uint64_t(block[2 + i]) << (i * 8);
+    }
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        values[i] = palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+struct Bc7Mode
+{
+    uint8_t subsets;
+    uint8_t partitionBits;
+    uint8_t rotationBits;
+    uint8_t indexSelectionBits;
+    uint8_t colorBits;
+    uint8_t alphaBits;
+    // one p bit per endpoint, or one shared by both endpoints of a subset
+    uint8_t endpointPBits;
+    uint8_t sharedPBits;
+    uint8_t indexBits;
+    uint8_t secondaryIndexBits;
+};
+
+static const Bc7Mode BC7_MODES[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+    {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+    {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+    {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+    {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}};
+
+// bit n is the subset of pixel n
+static const uint16_t BC7_PARTITIONS2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+
+static const uint8_t BC7_PARTITIONS3[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1}, {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2}, {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+    {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2}, {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2}, {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+    {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2}, {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0}, {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0}, {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+    {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2}, {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+    {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1}, {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2}, {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0}, {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+    {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0}, {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1}, {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1}, {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1}, {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1}, {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2}, {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+    {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2}, {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2}, {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+    {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+    {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1}, {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0}};
+
+// pixel whose index is stored with one bit less, for the second subset of 2 subset partitions
+static const uint8_t BC7_ANCHORS2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+
+// same for the second and third subsets of 3 subset partitions
+static const uint8_t BC7_ANCHORS3[2][64] = {
+    {3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+     3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+     8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+     3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3},
+    {15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+     15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+     15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+     15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8}};
+
+static const uint8_t BC7_WEIGHTS2[4] = {0, 21, 43, 64};
+static const uint8_t BC7_WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint8_t BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static const uint8_t *bc7_weights(uint32_t indexBits)
+{
+    return indexBits == 2 ? BC7_WEIGHTS2 : indexBits == 3 ? BC7_WEIGHTS3
+                                                          : BC7_WEIGHTS4;
+}
+
+// reads the 128 bits of a block from the lowest bit up
+struct BlockBits
+{
+    uint64_t low;
+    uint64_t high;
+    uint32_t position;
+
+    uint32_t read(uint32_t count)
+    {
+        uint64_t value;
+        if (position >= 64)
+            value = high >> (position - 64);
+        else if (position + count <= 64)
+            value = low >> position;
+        else
+            value = (low >> position) | (high << (64 - position));
+        position += count;
+        return uint32_t(value & ((1u << count) - 1));
+    }
+};
+
+static void decode_bc7_block(const uint8_t *block, uint32_t *pixels)
+{
+    uint32_t mode = 0;
+    while (mode < 8 && !(block[0] & (1 << mode)))
+    {
+        mode++;
+    }
+    // reserved mode, decodes to transparent black
+    if (mode == 8)
+    {
+        memset(pixels, 0, 16 * sizeof(uint32_t));
+        return;
+    }
+    const Bc7Mode &m = BC7_MODES[mode];
+
+    BlockBits bits;
+    memcpy(&bits.low, block, 8);
+    memcpy(&bits.high, block + 8, 8);
+    bits.position = mode + 1;
+
+    uint32_t partition = bits.read(m.partitionBits);
+    uint32_t rotation = bits.read(m.rotationBits);
+    uint32_t indexSelection = bits.read(m.indexSelectionBits);
+
+    // two endpoints per subset, every channel of every endpoint comes before the next channel
+    uint32_t endpoints[6][4];
+    uint32_t endpointCount = m.subsets * 2u;
+    for (uint32_t c = 0; c < 3; c++)
+    {
+        for (uint32_t e = 0; e < endpointCount; e++)
+        {
+            endpoints[e][c] = bits.read(m.colorBits);
+        }
+    }
+    for (uint32_t e = 0; e < endpointCount; e++)
+    {
+        endpoints[e][3] = m.alphaBits ? bits.read(m.alphaBits) : 255;
+    }
+
+    uint32_t colorPrecision = m.colorBits;
+    uint32_t alphaPrecision = m.alphaBits;
+    if (m.endpointPBits || m.sharedPBits)
+    {
+        uint32_t pbits[6];
+        for (uint32_t e = 0; e < endpointCount; e++)
+        {
+            pbits[e] = m.endpointPBits ? bits.read(1) : (e % 2 == 0 ? bits.read(1) : pbits[e - 1]);
+        }
+        for (uint32_t e = 0; e < endpointCount; e++)
+        {
+            for (uint32_t c = 0; c < (m.alphaBits ? 4u : 3u); c++)
+            {
+                endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+            }
+        }
+        colorPrecision++;
+        alphaPrecision += m.alphaBits ? 1 : 0;
+    }
+
+    // widen to 8 bits by repeating the top bits
+    for (uint32_t e = 0; e < endpointCount; e++)
+    {
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            endpoints[e][c] = (endpoints[e][c] << (8 - colorPrecision)) | (endpoints[e][c] >> (2 * colorPrecision - 8));
+        }
+        if (m.alphaBits)
+        {
+            endpoints[e][3] = (endpoints[e][3] << (8 - alphaPrecision)) | (endpoints[e][3] >> (2 * alphaPrecision - 8));
+        }
+    }
+
+    uint8_t subsets[16];
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        if (m.subsets == 1)
+            subsets[i] = 0;
+        else if (m.subsets == 2)
+            subsets[i] = (BC7_PARTITIONS2[partition] >> i) & 1;
+        else
+            subsets[i] = BC7_PARTITIONS3[partition][i];
+    }
+    auto is_anchor = [&](uint32_t i)
+    {
+        if (i == 0)
+            return true;
+        if (m.subsets == 2)
+            return i == BC7_ANCHORS2[partition];
+        if (m.subsets == 3)
+            return i == BC7_ANCHORS3[0][partition] || i == BC7_ANCHORS3[1][partition];
+        return false;
+    };
+
+    uint8_t indices[16];
+    uint8_t secondaryIndices[16];
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        indices[i] = uint8_t(bits.read(m.indexBits - (is_anchor(i) ? 1 : 0)));
+    }
+    for (uint32_t i = 0; m.secondaryIndexBits && i < 16; i++)
+    {
+        secondaryIndices[i] = uint8_t(bits.read(m.secondaryIndexBits - (i == 0 ? 1 : 0)));
+    }
+
+    // color and alpha take their weights from different index sets in modes 4 and 5, the index selection bit swaps them
+    const uint8_t *colorIndices = indices;
+    const uint8_t *alphaIndices = m.secondaryIndexBits ? secondaryIndices : indices;
+    const uint8_t *colorWeights = bc7_weights(m.indexBits);
+    const uint8_t *alphaWeights = bc7_weights(m.secondaryIndexBits ? m.secondaryIndexBits : m.indexBits);
+    if (indexSelection)
+    {
+        std::swap(colorIndices, alphaIndices);
+        std::swap(colorWeights, alphaWeights);
+    }
+
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        const uint32_t *e0 = endpoints[subsets[i] * 2];
+        const uint32_t *e1 = endpoints[subsets[i] * 2 + 1];
+        uint32_t colorWeight = colorWeights[colorIndices[i]];
+        uint32_t alphaWeight = alphaWeights[alphaIndices[i]];
+
+        uint32_t rgba[4];
+#if TRANSCODE_SSE2
+        // ((64 - w) * e0 + w * e1 + 32) >> 6 on the four channels at once
+        __m128i v0 = _mm_setr_epi16(short(e0[0]), short(e0[1]), short(e0[2]), short(e0[3]), 0, 0, 0, 0);
+        __m128i v1 = _mm_setr_epi16(short(e1[0]), short(e1[1]), short(e1[2]), short(e1[3]), 0, 0, 0, 0);
+        __m128i w1 = _mm_setr_epi16(short(colorWeight), short(colorWeight), short(colorWeight), short(alphaWeight), 0, 0, 0, 0);
+        __m128i w0 = _mm_sub_epi16(_mm_set1_epi16(64), w1);
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(v0, w0), _mm_mullo_epi16(v1, w1)), _mm_set1_epi16(32));
+        __m128i mixed = _mm_srli_epi16(sum, 6);
+        uint32_t packed = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(mixed, mixed)));
+        rgba[0] = packed & 0xFF;
+        rgba[1] = (packed >> 8) & 0xFF;
+        rgba[2] = (packed >> 16) & 0xFF;
+        rgba[3] = packed >> 24;
+#else
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            uint32_t w = c < 3 ? colorWeight : alphaWeight;
+            rgba[c] = ((64 - w) * e0[c] + w * e1[c] + 32) >> 6;
+        }
+#endif
+        // rotation 1 to 3 swaps alpha with red, green or blue
+        if (rotation != 0)
+        {
+            std::swap(rgba[3], rgba[rotation - 1]);
+        }
+        pixels[i] = pack_rgba(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+}
+
+static uint32_t block_bytes(TextureFormat format)
+{
+    return format == TextureFormat::BC1 || format == TextureFormat::BC4 ? 8 : 16;
+}
+
+static void decode_block(TextureFormat format, const uint8_t *block, uint32_t *pixels)
+{
+    uint8_t red[16];
+    uint8_t green[16];
+    switch (format)
+    {
+    case TextureFormat::BC1:
+        decode_bc1_block(block, pixels, false);
+        break;
+    case TextureFormat::BC3:
+        decode_bc1_block(block + 8, pixels, true);
+        decode_bc4_block(block, red);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            pixels[i] = (pixels[i] & 0x00FFFFFF) | (uint32_t(red[i]) << 24);
+        }
+        break;
+    // sampled as (r, 0, 0, 1) and (r, g, 0, 1), the same as the gpu would return
+    case TextureFormat::BC4:
+        decode_bc4_block(block, red);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            pixels[i] = pack_rgba(red[i], 0, 0, 255);
+        }
+        break;
+    case TextureFormat::BC5:
+        decode_bc4_block(block, red);
+        decode_bc4_block(block + 8, green);
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            pixels[i] = pack_rgba(red[i], green[i], 0, 255);
+        }
+        break;
+    case TextureFormat::BC7:
+        decode_bc7_block(block, pixels);
+        break;
+    default:
+        memset(pixels, 0, 16 * sizeof(uint32_t));
+        break;
+    }
+}
+
+// decodes every block of one page. Runs on the calling thread, the streamer already decodes a texture per worker
+static void transcode_page(TextureFormat format, const uint8_t *source, uint32_t width, uint32_t height, uint8_t *destination)
+{
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+    uint32_t blockSize = block_bytes(format);
+    uint32_t pixels[16];
+    const uint8_t *block = source;
+    for (uint32_t by = 0; by < blocksHigh; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksWide; bx++, block += blockSize)
+        {
+            decode_block(format, block, pixels);
+
+            // blocks on the right and bottom edges of pages that are not a multiple of 4 are cut
+            uint32_t columns = std::min(4u, width - bx * 4);
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+            {
+                uint8_t *row = destination + (size_t(by * 4 + y) * width + bx * 4) * 4;
+                memcpy(row, &pixels[y * 4], columns * 4);
+            }
+        }
+    }
+}
+
+bool assets::transcode_page_rgba8(TextureFormat format, const char *source, size_t sourceSize, uint32_t width, uint32_t height, char *destination)
+{
+    // a page smaller than its blocks would be read past its end
+    uint64_t pageSize = texture_page_size(format, width, height);
+    if (sourceSize < pageSize)
+        return false;
+
+    if (format == TextureFormat::RGBA8)
+    {
+        memcpy(destination, source, pageSize);
+        return true;
+    }
+    if (!is_block_compressed(format))
+        return false;
+
+    transcode_page(format, (const uint8_t *)source, width, height, (uint8_t *)destination);
+    return true;
+}
+
+bool assets::transcode_texture_rgba8(const TextureInfo &info, const char *pixels, size_t sourceSize, char *destination, TaskPool *pool)
+{
+    std::vector<uint64_t> sourceOffsets(info.pages.size());
+    std::vector<uint64_t> destinationOffsets(info.pages.size());
+    uint64_t sourceOffset = 0;
+    uint64_t destinationOffset = 0;
+    for (size_t i = 0; i < info.pages.size(); i++)
+    {
+        const PageInfo &page = info.pages[i];
+        if (page.originalSize > sourceSize - sourceOffset)
+            return false;
+        sourceOffsets[i] = sourceOffset;
+        destinationOffsets[i] = destinationOffset;
+        sourceOffset += page.originalSize;
+        destinationOffset += texture_page_size(TextureFormat::RGBA8, page.width, page.height);
+    }
+
+    std::atomic<bool> failed{false};
+    auto transcode = [&](uint32_t i)
+    {
+        const PageInfo &page = info.pages[i];
+        if (!transcode_page_rgba8(info.textureFormat, pixels + sourceOffsets[i], page.originalSize, page.width, page.height, destination + destinationOffsets[i]))
+        {
+            failed = true;
+        }
+    };
+    uint32_t pageCount = static_cast<uint32_t>(info.pages.size());
+    if (pool)
+    {
+        pool->parallel_for(pageCount, transcode);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < pageCount; i++)
+        {
+            transcode(i);
+        }
+    }
+    return !failed;
+}
+
+TextureInfo assets::transcoded_texture_info(const TextureInfo &info)
+{
+    TextureInfo transcoded = info;
+    transcoded.textureFormat = TextureFormat::RGBA8;
+    transcoded.compressionMode = CompressionMode::None;
+    transcoded.blockSize = 0;
+    transcoded.dictionaryId = 0;
+    transcoded.textureSize = 0;
+    for (auto &page : transcoded.pages)
+    {
+        page.originalSize = static_cast<uint32_t>(texture_page_size(TextureFormat::RGBA8, page.width, page.height));
+        page.compressedSize = page.originalSize;
+        transcoded.textureSize += page.originalSize;
+    }
+    build_page_offsets(&transcoded);
+    return transcoded;
+}
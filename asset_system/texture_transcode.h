@@ -0,0 +1,16 @@
+#pragma once
+#include "texture_asset.h"
+
+namespace assets
+{
+    // decodes one page of a block compressed texture into width * height rgba8 pixels. RGBA8 pages are copied as is.
+    // returns false when sourceSize is smaller than the blocks of the page. Runs on the calling thread
+    bool transcode_page_rgba8(TextureFormat format, const char *source, size_t sourceSize, uint32_t width, uint32_t height, char *destination);
+
+    // same as transcode_page_rgba8 for every page of unpacked pixels, packed one after another the way unpack_texture writes them.
+    // With a pool the pages are transcoded in parallel on it
+    bool transcode_texture_rgba8(const TextureInfo &info, const char *pixels, size_t sourceSize, char *destination, TaskPool *pool = nullptr);
+
+    // the uncompressed rgba8 texture that transcoding info results in, with the same pages and color space
+    TextureInfo transcoded_texture_info(const TextureInfo &info);
+}
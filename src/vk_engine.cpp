@@ -15,8 +15,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 
 #include "vk_textures.h"
+#include "asset_dictionary.h"
 
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
@@ -63,14 +65,22 @@ void VulkanEngine::init()
 
 	init_sync_structures();
 
+	init_staging_ring();
+
 	init_descriptors();
 
 	init_pipelines();
 
+	_assetStreamer.init();
+
+	// texture files get mapped and read in on the workers while the meshes load
 	load_images();
 
 	load_meshes();
 
+	// the scene needs every texture bound before the first frame
+	finish_streaming();
+
 	init_scene();
 
 	init_imgui();
@@ -82,8 +92,12 @@ void VulkanEngine::cleanup()
 	if (_isInitialized)
 	{
 
+		// workers could still be writing into requests
+		_assetStreamer.shutdown();
+
 		// make sure the gpu has stopped doing its things
 		vkDeviceWaitIdle(_device);
+		wait_upload_batch();
 
 		_mainDeletionQueue.flush();
 
@@ -231,6 +245,8 @@ void VulkanEngine::run()
 		// imgui commands
 		ImGui::ShowDemoWindow();
 
+		update_streaming();
+
 		draw();
 	}
 }
@@ -273,6 +289,12 @@ void VulkanEngine::init_vulkan()
 											 .select()
 											 .value();
 
+	// block compressed textures are optional, the builder enables whatever is set in the features of the physical device
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+	_supportsBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+	physicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
 	// create the final vulkan device
 
 	vkb::DeviceBuilder deviceBuilder{physicalDevice};
@@ -502,6 +524,16 @@ void VulkanEngine::init_commands()
 	VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_uploadContext._commandPool, 1);
 
 	VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_uploadContext._commandBuffer));
+
+	// the streamed uploads get a pool of their own, it is reset whenever a batch finished
+	VK_CHECK(vkCreateCommandPool(_device, &uploadCommandPoolInfo, nullptr, &_uploadBatch._commandPool));
+
+	_mainDeletionQueue.push_function([=]()
+									 { vkDestroyCommandPool(_device, _uploadBatch._commandPool, nullptr); });
+
+	VkCommandBufferAllocateInfo batchAllocInfo = vkinit::command_buffer_allocate_info(_uploadBatch._commandPool, 1);
+
+	VK_CHECK(vkAllocateCommandBuffers(_device, &batchAllocInfo, &_uploadBatch._commandBuffer));
 }
 
 void VulkanEngine::init_sync_structures()
@@ -538,6 +570,10 @@ void VulkanEngine::init_sync_structures()
 	VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_uploadContext._uploadFence));
 	_mainDeletionQueue.push_function([=]()
 									 { vkDestroyFence(_device, _uploadContext._uploadFence, nullptr); });
+
+	VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_uploadBatch._fence));
+	_mainDeletionQueue.push_function([=]()
+									 { vkDestroyFence(_device, _uploadBatch._fence, nullptr); });
 }
 
 void VulkanEngine::init_pipelines()
@@ -663,6 +699,33 @@ void VulkanEngine::init_pipelines()
 	VkPipeline texPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
 	create_material(texPipeline, texturedPipeLayout, "texturedmesh");
 
+	// the colored mesh pipeline again for every baked vertex format, they only differ in how the vertices are read.
+	// Quantized positions get scaled back by the model matrix, see Mesh::_dequantization
+	pipelineBuilder._shaderStages.clear();
+	pipelineBuilder._shaderStages.push_back(
+		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertShader));
+
+	pipelineBuilder._shaderStages.push_back(
+		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, colorMeshShader));
+
+	pipelineBuilder._pipelineLayout = meshPipLayout;
+
+	std::vector<VkPipeline> formatPipelines;
+	for (assets::VertexFormat format : {assets::VertexFormat::P32N8C8V16, assets::VertexFormat::P16N16C8V16, assets::VertexFormat::P16N8V16})
+	{
+		VertexInputDescription formatDescription = get_vertex_description(format);
+
+		pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = formatDescription.attributes.data();
+		pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = formatDescription.attributes.size();
+
+		pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = formatDescription.bindings.data();
+		pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = formatDescription.bindings.size();
+
+		VkPipeline formatPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
+		create_material(formatPipeline, meshPipLayout, mesh_material_name("defaultmesh", format));
+		formatPipelines.push_back(formatPipeline);
+	}
+
 	vkDestroyShaderModule(_device, meshVertShader, nullptr);
 	vkDestroyShaderModule(_device, colorMeshShader, nullptr);
 	vkDestroyShaderModule(_device, texturedMeshShader, nullptr);
@@ -671,6 +734,10 @@ void VulkanEngine::init_pipelines()
 									 {
 		vkDestroyPipeline(_device, meshPipeline, nullptr);
 		vkDestroyPipeline(_device, texPipeline, nullptr);
+		for (VkPipeline formatPipeline : formatPipelines)
+		{
+			vkDestroyPipeline(_device, formatPipeline, nullptr);
+		}
 
 		vkDestroyPipelineLayout(_device, meshPipLayout, nullptr);
 		vkDestroyPipelineLayout(_device, texturedPipeLayout, nullptr); });
@@ -796,9 +863,20 @@ void VulkanEngine::load_meshes()
 	triMesh._vertices[2].color = {0.f, 1.f, 0.0f}; // pure green
 	// we dont care about the vertex normals
 
+	// meshes baked with --dictionaries cant be decoded without it
+	const char *meshDictionary = "../../assets_export/meshes.dict";
+	if (std::filesystem::exists(meshDictionary))
+	{
+		assets::load_dictionary(meshDictionary);
+	}
+
 	// load the monkey
 	Mesh monkeyMesh{};
-	monkeyMesh.load_from_obj("../../assets/monkey_smooth.obj");
+	// the baked monkey has quantized vertices, the obj is only used when the baker has not been run
+	if (!monkeyMesh.load_from_meshasset("../../assets_export/monkey_smooth.mesh"))
+	{
+		monkeyMesh.load_from_obj("../../assets/monkey_smooth.obj");
+	}
 
 	Mesh lostEmpire{};
 	lostEmpire.load_from_obj("../../assets/lost_empire.obj");
@@ -814,22 +892,126 @@ void VulkanEngine::load_meshes()
 
 void VulkanEngine::load_images()
 {
-	Texture lostEmpire;
+	// textures baked with --dictionaries cant be decoded without it
+	const char *textureDictionary = "../../assets_export/textures.dict";
+	if (std::filesystem::exists(textureDictionary))
+	{
+		assets::load_dictionary(textureDictionary);
+	}
+
+	stream_texture("empire_diffuse", "../../assets_export/lost_empire-RGBA.tx", "../../assets/lost_empire-RGBA.png", assets::LoadPriority::High);
+}
 
-	vkutil::load_image_from_file(*this, "../../assets/lost_empire-RGBA.png", lostEmpire.image);
+void VulkanEngine::add_texture(const std::string &name, const AllocatedImage &image, VkFormat format, uint32_t mipLevels)
+{
+	Texture texture;
+	texture.image = image;
 
-	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(VK_FORMAT_R8G8B8A8_SRGB, lostEmpire.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCreateImageView(_device, &imageinfo, nullptr, &lostEmpire.imageView);
+	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(format, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	imageinfo.subresourceRange.levelCount = mipLevels;
+	vkCreateImageView(_device, &imageinfo, nullptr, &texture.imageView);
 
 	_mainDeletionQueue.push_function([=]()
-									 { vkDestroyImageView(_device, lostEmpire.imageView, nullptr); });
+									 { vkDestroyImageView(_device, texture.imageView, nullptr); });
+
+	_loadedTextures[name] = texture;
+}
 
-	_loadedTextures["empire_diffuse"] = lostEmpire;
+void VulkanEngine::stream_texture(const std::string &name, const std::string &assetFile, const std::string &fallbackFile, assets::LoadPriority priority)
+{
+	// the worker maps the file and faults it in, update_streaming unpacks it from there straight into the staging ring.
+	// Files the engine could not upload are rejected on the worker, parsing old json metadata can throw
+	auto check = [](const assets::MappedAssetFile &file)
+	{
+		assets::TextureInfo info = assets::read_texture_info(&file);
+		if (vkutil::texture_vk_format(info) == VK_FORMAT_UNDEFINED)
+			return false;
+		return info.dictionaryId == 0 || assets::find_dictionary(info.dictionaryId) != nullptr;
+	};
+
+	PendingTexture pending;
+	pending.name = name;
+	pending.fallbackFile = fallbackFile;
+	pending.handle = _assetStreamer.request_mapped(assetFile, priority, check);
+	_pendingTextures.push_back(std::move(pending));
+}
+
+void VulkanEngine::update_streaming()
+{
+	VkCommandBuffer cmd = VK_NULL_HANDLE;
+	for (size_t i = 0; i < _pendingTextures.size();)
+	{
+		PendingTexture &pending = _pendingTextures[i];
+		if (!pending.handle->is_done())
+		{
+			i++;
+			continue;
+		}
+
+		AllocatedImage image;
+		bool uploaded = false;
+		if (pending.handle->status == assets::LoadStatus::Ready)
+		{
+			const assets::MappedAssetFile &file = pending.handle->mapped;
+			// the worker already parsed it once, so this does not throw
+			assets::TextureInfo info = assets::read_texture_info(&file);
+			assets::TextureInfo uploadInfo = vkutil::upload_texture_info(*this, info);
+
+			// the copies of last frame are still running, the textures stay pending until they are done
+			if (cmd == VK_NULL_HANDLE)
+			{
+				cmd = begin_upload_batch();
+				if (cmd == VK_NULL_HANDLE)
+					break;
+			}
+			// the ring is full for this frame, unless the texture would not even fit into an empty one
+			if (uploadInfo.textureSize > stage_available() && _stagingRing.head != 0)
+				break;
+
+			// the pages are unpacked on the decode pool, so one big texture is spread over every core
+			uploaded = vkutil::upload_texture(*this, cmd, info, file.binaryBlob, file.binaryBlobSize, &_assetStreamer.decode_pool(), image);
+			if (uploaded)
+			{
+				add_texture(pending.name, image, vkutil::texture_vk_format(uploadInfo), static_cast<uint32_t>(uploadInfo.pages.size()));
+			}
+			else
+			{
+				std::cout << "Error when unpacking texture " << pending.handle->path << std::endl;
+			}
+		}
+		if (!uploaded && !pending.fallbackFile.empty() && vkutil::load_image_from_file(*this, pending.fallbackFile.c_str(), image))
+		{
+			add_texture(pending.name, image, VK_FORMAT_R8G8B8A8_SRGB, 1);
+		}
+
+		// order of the pending list does not matter, swap the finished one out. Dropping the handle unmaps the file
+		_pendingTextures[i] = std::move(_pendingTextures.back());
+		_pendingTextures.pop_back();
+	}
+
+	submit_upload_batch();
+}
+
+void VulkanEngine::finish_streaming()
+{
+	_assetStreamer.wait_idle();
+	// every pass starts with an empty ring, so it uploads at least one texture
+	while (!_pendingTextures.empty())
+	{
+		wait_upload_batch();
+		update_streaming();
+	}
+	wait_upload_batch();
 }
 
 void VulkanEngine::upload_mesh(Mesh &mesh)
 {
-	const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
+	// baked meshes keep their vertices in the format they were stored in
+	const char *vertexData = mesh._packedVertices.empty() ? reinterpret_cast<const char *>(mesh._vertices.data()) : mesh._packedVertices.data();
+	const size_t vertexSize = mesh._packedVertices.empty() ? mesh._vertices.size() * sizeof(Vertex) : mesh._packedVertices.size();
+	const size_t indexSize = mesh._indices.size() * sizeof(uint32_t);
+	// the indices are staged right after the vertices
+	const size_t bufferSize = vertexSize + indexSize;
 	// allocate vertex buffer
 	VkBufferCreateInfo stagingBufferInfo = {};
 	stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -855,7 +1037,11 @@ void VulkanEngine::upload_mesh(Mesh &mesh)
 	void *data;
 	vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
 
-	memcpy(data, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex));
+	memcpy(data, vertexData, vertexSize);
+	if (indexSize > 0)
+	{
+		memcpy((char *)data + vertexSize, mesh._indices.data(), indexSize);
+	}
 
 	vmaUnmapMemory(_allocator, stagingBuffer._allocation);
 
@@ -864,7 +1050,7 @@ void VulkanEngine::upload_mesh(Mesh &mesh)
 	vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	vertexBufferInfo.pNext = nullptr;
 	// this is the total size, in bytes, of the buffer we are allocating
-	vertexBufferInfo.size = bufferSize;
+	vertexBufferInfo.size = vertexSize;
 	// this buffer is going to be used as a Vertex Buffer
 	vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
@@ -880,13 +1066,36 @@ void VulkanEngine::upload_mesh(Mesh &mesh)
 	_mainDeletionQueue.push_function([=]()
 									 { vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation); });
 
+	if (indexSize > 0)
+	{
+		VkBufferCreateInfo indexBufferInfo = vertexBufferInfo;
+		indexBufferInfo.size = indexSize;
+		indexBufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+		VK_CHECK(vmaCreateBuffer(_allocator, &indexBufferInfo, &vmaallocInfo,
+								 &mesh._indexBuffer._buffer,
+								 &mesh._indexBuffer._allocation,
+								 nullptr));
+		_mainDeletionQueue.push_function([=]()
+										 { vmaDestroyBuffer(_allocator, mesh._indexBuffer._buffer, mesh._indexBuffer._allocation); });
+	}
+
 	immediate_submit([=](VkCommandBuffer cmd)
 					 {
 		VkBufferCopy copy;
 		copy.dstOffset = 0;
 		copy.srcOffset = 0;
-		copy.size = bufferSize;
-		vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, & copy); });
+		copy.size = vertexSize;
+		vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, & copy);
+
+		if (indexSize > 0)
+		{
+			VkBufferCopy indexCopy;
+			indexCopy.dstOffset = 0;
+			indexCopy.srcOffset = vertexSize;
+			indexCopy.size = indexSize;
+			vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._indexBuffer._buffer, 1, &indexCopy);
+		} });
 
 	vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
 }
@@ -914,6 +1123,15 @@ Material *VulkanEngine::get_material(const std::string &name)
 	}
 }
 
+std::string VulkanEngine::mesh_material_name(const std::string &material, assets::VertexFormat format)
+{
+	if (format == assets::VertexFormat::PNCV_F32)
+	{
+		return material;
+	}
+	return material + "_" + assets::vertex_format_name(format);
+}
+
 Mesh *VulkanEngine::get_mesh(const std::string &name)
 {
 	auto it = _meshes.find(name);
@@ -1012,10 +1230,21 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject *first, int co
 			// bind the mesh vertex buffer with offset 0
 			VkDeviceSize offset = 0;
 			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
+			if (!object.mesh->_indices.empty())
+			{
+				vkCmdBindIndexBuffer(cmd, object.mesh->_indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT32);
+			}
 			lastMesh = object.mesh;
 		}
 		// we can now draw
-		vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+		if (object.mesh->_indices.empty())
+		{
+			vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+		}
+		else
+		{
+			vkCmdDrawIndexed(cmd, object.mesh->_indices.size(), 1, 0, 0, i);
+		}
 	}
 }
 
@@ -1023,8 +1252,8 @@ void VulkanEngine::init_scene()
 {
 	RenderObject monkey;
 	monkey.mesh = get_mesh("monkey");
-	monkey.material = get_material("defaultmesh");
-	monkey.transformMatrix = glm::mat4{1.0f};
+	monkey.material = get_material(mesh_material_name("defaultmesh", monkey.mesh->_vertexFormat));
+	monkey.transformMatrix = glm::mat4{1.0f} * monkey.mesh->_dequantization;
 
 	_renderables.push_back(monkey);
 
@@ -1117,6 +1346,139 @@ size_t VulkanEngine::pad_uniform_buffer_size(size_t originalSize)
 	return alignedSize;
 }
 
+bool VulkanEngine::can_sample_format(VkFormat format) const
+{
+	// the block compressed formats can be listed as supported even when the feature was not enabled
+	if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !_supportsBC)
+		return false;
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(_chosenGPU, format, &properties);
+	VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & needed) == needed;
+}
+
+void VulkanEngine::init_staging_ring()
+{
+	_stagingRing.buffer = create_buffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	_stagingRing.size = STAGING_RING_SIZE;
+	_stagingRing.head = 0;
+
+	// mapped once for the lifetime of the engine, uploads decompress straight into it
+	void *data;
+	vmaMapMemory(_allocator, _stagingRing.buffer._allocation, &data);
+	_stagingRing.mapped = (char *)data;
+
+	_mainDeletionQueue.push_function([=]()
+									 {
+		vmaUnmapMemory(_allocator, _stagingRing.buffer._allocation);
+		vmaDestroyBuffer(_allocator, _stagingRing.buffer._buffer, _stagingRing.buffer._allocation); });
+}
+
+char *VulkanEngine::stage_allocate(VkDeviceSize size, VkDeviceSize &offset)
+{
+	// copies out of a buffer need their offset aligned to the texel size, 16 covers every format
+	VkDeviceSize start = (_stagingRing.head + 15) / 16 * 16;
+	if (start + size > _stagingRing.size)
+	{
+		return nullptr;
+	}
+
+	offset = start;
+	_stagingRing.head = start + size;
+	return _stagingRing.mapped + start;
+}
+
+VkDeviceSize VulkanEngine::stage_available() const
+{
+	VkDeviceSize start = (_stagingRing.head + 15) / 16 * 16;
+	return start < _stagingRing.size ? _stagingRing.size - start : 0;
+}
+
+char *VulkanEngine::stage_allocate_dedicated(VkDeviceSize size, VkBuffer &buffer)
+{
+	AllocatedBuffer dedicated = create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	_uploadBatch._dedicatedBuffers.push_back(dedicated);
+
+	// stays mapped until the batch is reclaimed
+	void *data;
+	vmaMapMemory(_allocator, dedicated._allocation, &data);
+	buffer = dedicated._buffer;
+	return (char *)data;
+}
+
+void VulkanEngine::stage_reset()
+{
+	_stagingRing.head = 0;
+}
+
+VkCommandBuffer VulkanEngine::begin_upload_batch(bool wait)
+{
+	if (_uploadBatch._recording)
+	{
+		return _uploadBatch._commandBuffer;
+	}
+
+	if (_uploadBatch._inFlight)
+	{
+		if (wait)
+		{
+			VK_CHECK(vkWaitForFences(_device, 1, &_uploadBatch._fence, true, 9999999999));
+		}
+		else if (vkGetFenceStatus(_device, _uploadBatch._fence) != VK_SUCCESS)
+		{
+			return VK_NULL_HANDLE;
+		}
+		reclaim_upload_batch();
+	}
+
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(_uploadBatch._commandBuffer, &cmdBeginInfo));
+	_uploadBatch._recording = true;
+	return _uploadBatch._commandBuffer;
+}
+
+void VulkanEngine::submit_upload_batch()
+{
+	if (!_uploadBatch._recording)
+		return;
+
+	VK_CHECK(vkEndCommandBuffer(_uploadBatch._commandBuffer));
+
+	// same queue as the frames, so the draws submitted after it are ordered behind the copies
+	VkSubmitInfo submit = vkinit::submit_info(&_uploadBatch._commandBuffer);
+	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, _uploadBatch._fence));
+
+	_uploadBatch._recording = false;
+	_uploadBatch._inFlight = true;
+}
+
+void VulkanEngine::wait_upload_batch()
+{
+	submit_upload_batch();
+	if (_uploadBatch._inFlight)
+	{
+		VK_CHECK(vkWaitForFences(_device, 1, &_uploadBatch._fence, true, 9999999999));
+		reclaim_upload_batch();
+	}
+}
+
+void VulkanEngine::reclaim_upload_batch()
+{
+	VK_CHECK(vkResetFences(_device, 1, &_uploadBatch._fence));
+	VK_CHECK(vkResetCommandPool(_device, _uploadBatch._commandPool, 0));
+
+	for (AllocatedBuffer &buffer : _uploadBatch._dedicatedBuffers)
+	{
+		vmaUnmapMemory(_allocator, buffer._allocation);
+		vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+	}
+	_uploadBatch._dedicatedBuffers.clear();
+
+	stage_reset();
+	_uploadBatch._inFlight = false;
+}
+
 void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function)
 {
 	VkCommandBuffer cmd = _uploadContext._commandBuffer;
@@ -10,6 +10,8 @@
 #include <vk_mesh.h>
 #include <unordered_map>
 
+#include <asset_streamer.h>
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 
@@ -69,6 +71,15 @@ struct Texture
 	VkImageView imageView;
 };
 
+// a texture whose file is being streamed in. It gets uploaded and added to _loadedTextures once the handle is done
+struct PendingTexture
+{
+	std::string name;
+	// loaded straight from the image file if the streamed asset is missing or fails to decode
+	std::string fallbackFile;
+	assets::StreamHandle handle;
+};
+
 struct RenderObject
 {
 	Mesh *mesh;
@@ -95,12 +106,38 @@ struct FrameData
 	VkDescriptorSet objectDescriptor;
 };
 
+// persistently mapped staging memory that uploads get written into. Space is handed out front to back,
+// and all of it is reclaimed at once after the upload batch that copies out of it has finished
+struct StagingRing
+{
+	AllocatedBuffer buffer;
+	char *mapped{nullptr};
+	VkDeviceSize size{0};
+	VkDeviceSize head{0};
+};
+
+// big enough for a 4k rgba8 mip, bigger pages get a staging buffer of their own
+constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+
 struct UploadContext
 {
 	VkFence _uploadFence;
 	VkCommandPool _commandPool;
 	VkCommandBuffer _commandBuffer;
 };
+
+// the texture uploads of a frame are recorded into one command buffer and submitted together.
+// Its fence is polled instead of waited on, the staging ring is only reset once it has signaled
+struct UploadBatch
+{
+	VkFence _fence;
+	VkCommandPool _commandPool;
+	VkCommandBuffer _commandBuffer;
+	bool _recording{false};
+	bool _inFlight{false};
+	// staging buffers of pages that were bigger than the whole ring, destroyed with the batch
+	std::vector<AllocatedBuffer> _dedicatedBuffers;
+};
 struct GPUCameraData
 {
 	glm::mat4 view;
@@ -141,6 +178,9 @@ public:
 	VkDevice _device;
 
 	VkPhysicalDeviceProperties _gpuProperties;
+	// BC1 to BC7 textures can be sampled. Enabled whenever the gpu has it, desktop gpus all do, software renderers
+	// like lavapipe dont and get their textures transcoded to RGBA8 instead
+	bool _supportsBC{false};
 
 	FrameData _frames[FRAME_OVERLAP];
 
@@ -178,6 +218,8 @@ public:
 	AllocatedBuffer _sceneParameterBuffer;
 
 	UploadContext _uploadContext;
+	UploadBatch _uploadBatch;
+	StagingRing _stagingRing;
 	// initializes everything in the engine
 	void init();
 
@@ -199,6 +241,10 @@ public:
 	std::unordered_map<std::string, Material> _materials;
 	std::unordered_map<std::string, Mesh> _meshes;
 	std::unordered_map<std::string, Texture> _loadedTextures;
+
+	// loads and decodes asset files on worker threads while the main thread keeps going
+	assets::AssetStreamer _assetStreamer;
+	std::vector<PendingTexture> _pendingTextures;
 	// functions
 
 	// create material and add it to the map
@@ -207,6 +253,9 @@ public:
 	// returns nullptr if it cant be found
 	Material *get_material(const std::string &name);
 
+	// the variant of a material built for meshes stored in that vertex format
+	static std::string mesh_material_name(const std::string &material, assets::VertexFormat format);
+
 	// returns nullptr if it cant be found
 	Mesh *get_mesh(const std::string &name);
 
@@ -217,8 +266,38 @@ public:
 
 	size_t pad_uniform_buffer_size(size_t originalSize);
 
+	// true when images of that format can be sampled and copied into. Safe to call from the streaming workers
+	bool can_sample_format(VkFormat format) const;
+
 	void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
 
+	// returns nullptr when the ring has no room left, what is staged has to be copied out before it gets reused
+	char *stage_allocate(VkDeviceSize size, VkDeviceSize &offset);
+	// room left in the ring for pages staged by the open batch
+	VkDeviceSize stage_available() const;
+	// staging memory for a page bigger than the whole ring, it lives until the upload batch finished
+	char *stage_allocate_dedicated(VkDeviceSize size, VkBuffer &buffer);
+	// only call once every copy out of the ring has finished
+	void stage_reset();
+
+	// the command buffer uploads of this frame get recorded into. Returns VK_NULL_HANDLE while the last batch is still
+	// running on the gpu, unless wait is set, the ring it staged from cant be reused yet
+	VkCommandBuffer begin_upload_batch(bool wait = false);
+	// submits what was recorded, without waiting on it. Later submits to the graphics queue see the copies
+	void submit_upload_batch();
+	// submits what was recorded and blocks until the gpu is done with it
+	void wait_upload_batch();
+
+	// queues a baked texture on the streamer, it shows up in _loadedTextures under name once update_streaming uploads it
+	void stream_texture(const std::string &name, const std::string &assetFile, const std::string &fallbackFile, assets::LoadPriority priority = assets::LoadPriority::Normal);
+
+	// unpacks every streamed texture the workers finished reading into the staging ring, on the decode pool, and uploads it.
+	// Called once per frame, never blocks on the workers
+	void update_streaming();
+
+	// waits for everything that was requested and uploads it
+	void finish_streaming();
+
 private:
 	void init_vulkan();
 
@@ -232,6 +311,8 @@ private:
 
 	void init_sync_structures();
 
+	void init_staging_ring();
+
 	void init_pipelines();
 
 	void init_scene();
@@ -248,4 +329,9 @@ private:
 	void load_images();
 
 	void upload_mesh(Mesh &mesh);
+
+	void add_texture(const std::string &name, const AllocatedImage &image, VkFormat format, uint32_t mipLevels);
+
+	// frees the ring and the dedicated buffers of a batch the gpu is done with
+	void reclaim_upload_batch();
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "vk_mesh.h"
-#include <tiny_obj_loader.h>
+#include <obj_loader.h>
 #include <iostream>
+#include <unordered_map>
+#include <glm/gtx/transform.hpp>
 
 VertexInputDescription Vertex::get_vertex_description()
 {
@@ -49,85 +51,208 @@ VertexInputDescription Vertex::get_vertex_description()
     return description;
 }
 
+static VkVertexInputAttributeDescription vertex_attribute(uint32_t location, VkFormat format, uint32_t offset)
+{
+    VkVertexInputAttributeDescription attribute = {};
+    attribute.binding = 0;
+    attribute.location = location;
+    attribute.format = format;
+    attribute.offset = offset;
+    return attribute;
+}
+
+VertexInputDescription get_vertex_description(assets::VertexFormat format)
+{
+    using namespace assets;
+
+    if (format == VertexFormat::PNCV_F32)
+    {
+        // same layout as the engine vertex
+        return Vertex::get_vertex_description();
+    }
+
+    VertexInputDescription description;
+
+    VkVertexInputBindingDescription mainBinding = {};
+    mainBinding.binding = 0;
+    mainBinding.stride = static_cast<uint32_t>(vertex_size(format));
+    mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    description.bindings.push_back(mainBinding);
+
+    switch (format)
+    {
+    case VertexFormat::P32N8C8V16:
+        description.attributes.push_back(vertex_attribute(0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex_P32N8C8V16, position)));
+        description.attributes.push_back(vertex_attribute(1, VK_FORMAT_R8G8B8A8_SNORM, offsetof(Vertex_P32N8C8V16, normal)));
+        description.attributes.push_back(vertex_attribute(2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Vertex_P32N8C8V16, color)));
+        description.attributes.push_back(vertex_attribute(3, VK_FORMAT_R16G16_SFLOAT, offsetof(Vertex_P32N8C8V16, uv)));
+        break;
+    case VertexFormat::P16N16C8V16:
+        description.attributes.push_back(vertex_attribute(0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(Vertex_P16N16C8V16, position)));
+        description.attributes.push_back(vertex_attribute(1, VK_FORMAT_R16G16_SNORM, offsetof(Vertex_P16N16C8V16, normal)));
+        description.attributes.push_back(vertex_attribute(2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Vertex_P16N16C8V16, color)));
+        description.attributes.push_back(vertex_attribute(3, VK_FORMAT_R16G16_SFLOAT, offsetof(Vertex_P16N16C8V16, uv)));
+        break;
+    case VertexFormat::P16N8V16:
+        // 3 component 16 bit formats are rarely supported for vertex input, the position is read as 4 components
+        // and the 4th one, which is the normal, gets dropped by the vec3 input
+        description.attributes.push_back(vertex_attribute(0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(Vertex_P16N8V16, position)));
+        description.attributes.push_back(vertex_attribute(1, VK_FORMAT_R8G8_SNORM, offsetof(Vertex_P16N8V16, normal)));
+        // there is no color, we are using the normal as the color. This is just for display purposes
+        description.attributes.push_back(vertex_attribute(2, VK_FORMAT_R8G8_SNORM, offsetof(Vertex_P16N8V16, normal)));
+        description.attributes.push_back(vertex_attribute(3, VK_FORMAT_R16G16_SFLOAT, offsetof(Vertex_P16N8V16, uv)));
+        break;
+    default:
+        break;
+    }
+    return description;
+}
+
+glm::mat4 get_dequantization_matrix(assets::VertexFormat format, const assets::MeshBounds &bounds)
+{
+    if (!assets::is_position_quantized(format))
+    {
+        return glm::mat4{1.f};
+    }
+
+    assets::PositionQuantization quantization = assets::position_quantization(bounds);
+    glm::vec3 offset{quantization.offset[0], quantization.offset[1], quantization.offset[2]};
+    glm::vec3 scale{quantization.scale[0], quantization.scale[1], quantization.scale[2]};
+    return glm::translate(offset) * glm::scale(scale);
+}
+
+// corners that index the same position, normal and uv in the file are the same vertex
+struct ObjIndexHash
+{
+    size_t operator()(const assets::ObjIndex &index) const
+    {
+        uint64_t h = uint32_t(index.position);
+        h = h * 0x9E3779B97F4A7C15ull ^ uint32_t(index.normal);
+        h = h * 0x9E3779B97F4A7C15ull ^ uint32_t(index.texcoord);
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+};
+
+struct ObjIndexEqual
+{
+    bool operator()(const assets::ObjIndex &a, const assets::ObjIndex &b) const
+    {
+        return a.position == b.position && a.normal == b.normal && a.texcoord == b.texcoord;
+    }
+};
+
 bool Mesh::load_from_obj(const char *filename)
 {
-    // attrib will contain the vertex arrays of the file
-    tinyobj::attrib_t attrib;
-    // shapes contains the info for each separate object in the file
-    std::vector<tinyobj::shape_t> shapes;
-    // materials contains the information about the material of each shape, but we won't use it.
-    std::vector<tinyobj::material_t> materials;
-
-    // error and warning output from the load function
-    std::string warn;
+    // obj contains the vertex arrays of the file and the corners of every triangle
+    assets::ObjMesh obj;
     std::string err;
 
     // load the OBJ file
-    tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, nullptr);
-    // make sure to output the warnings to the console, in case there are issues with the file
-    if (!warn.empty())
-    {
-        std::cout << "WARN: " << warn << std::endl;
-    }
     // if we have any error, print it to the console, and break the mesh loading.
     // This happens if the file can't be found or is malformed
-    if (!err.empty())
+    if (!assets::load_obj(filename, obj, err))
     {
         std::cerr << err << std::endl;
         return false;
     }
 
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++)
+    // a corner shared by the triangles around it becomes a single vertex, and the triangles index it
+    std::unordered_map<assets::ObjIndex, uint32_t, ObjIndexHash, ObjIndexEqual> uniqueCorners;
+    uniqueCorners.reserve(obj.indices.size() / 4);
+    _vertices.clear();
+    _indices.resize(obj.indices.size());
+
+    for (size_t i = 0; i < obj.indices.size(); i++)
+    {
+        auto [it, inserted] = uniqueCorners.try_emplace(obj.indices[i], static_cast<uint32_t>(_vertices.size()));
+        _indices[i] = it->second;
+        if (!inserted)
+            continue;
+
+        assets::ObjVertex corner = assets::obj_corner(obj, i);
+
+        // copy it into our vertex
+        Vertex new_vert;
+        new_vert.position = glm::vec3(corner.position[0], corner.position[1], corner.position[2]);
+        new_vert.normal = glm::vec3(corner.normal[0], corner.normal[1], corner.normal[2]);
+
+        new_vert.uv.x = corner.uv[0];
+        new_vert.uv.y = 1 - corner.uv[1];
+
+        // we are setting the vertex color as the vertex normal. This is just for display purposes
+        new_vert.color = new_vert.normal;
+        _vertices.push_back(new_vert);
+    }
+
+    return true;
+}
+
+bool Mesh::load_from_meshasset(const char *filename)
+{
+    assets::AssetFile file;
+    if (!assets::load_binaryfile(filename, file))
+    {
+        std::cout << "Error when loading mesh " << filename << std::endl;
+        return false;
+    }
+
+    assets::MeshInfo info = assets::read_mesh_info(&file);
+    size_t vertexSize = assets::vertex_size(info.vertexFormat);
+    if (vertexSize == 0 || info.vertexBuferSize % vertexSize != 0 || (info.indexSize != 2 && info.indexSize != 4))
     {
-        // Loop over faces(polygon)
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
+        std::cout << "Mesh " << filename << " has an unknown vertex format or index size" << std::endl;
+        return false;
+    }
+
+    std::vector<char> vertexBuffer(info.vertexBuferSize);
+    std::vector<char> indexBuffer(info.indexBuferSize);
+    if (!assets::unpack_mesh(&info, file.binaryBlob.data(), file.binaryBlob.size(), vertexBuffer.data(), indexBuffer.data()))
+    {
+        std::cout << "Error when unpacking mesh " << filename << std::endl;
+        return false;
+    }
+
+    // every lod shares the index buffer, only the full detail one gets drawn
+    size_t indexCount = info.indexBuferSize / info.indexSize;
+    size_t firstIndex = 0;
+    if (!info.lods.empty())
+    {
+        const assets::MeshLod &lod = info.lods[0];
+        if (lod.indexOffset > indexCount || lod.indexCount > indexCount - lod.indexOffset)
         {
+            std::cout << "Mesh " << filename << " has a lod outside of its index buffer" << std::endl;
+            return false;
+        }
+        firstIndex = lod.indexOffset;
+        indexCount = lod.indexCount;
+    }
 
-            // hardcode loading to triangles
-            int fv = 3;
-
-            // Loop over vertices in the face.
-            for (size_t v = 0; v < fv; v++)
-            {
-                // access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-                // vertex position
-                tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-                tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-                tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-                // vertex normal
-                tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-                tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-                tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
-
-                // vertex uv
-                tinyobj::real_t ux = attrib.texcoords[2 * idx.texcoord_index + 0];
-                tinyobj::real_t uy = attrib.texcoords[2 * idx.texcoord_index + 1];
-
-                // copy it into our vertex
-                Vertex new_vert;
-                new_vert.position.x = vx;
-                new_vert.position.y = vy;
-                new_vert.position.z = vz;
-
-                new_vert.normal.x = nx;
-                new_vert.normal.y = ny;
-                new_vert.normal.z = nz;
-
-                new_vert.uv.x = ux;
-                new_vert.uv.y = 1 - uy;
-
-                // we are setting the vertex color as the vertex normal. This is just for display purposes
-                new_vert.color = new_vert.normal;
-
-                _vertices.push_back(new_vert);
-            }
-            index_offset += fv;
+    // 16 bit indices are widened, every mesh is drawn with 32 bit ones
+    size_t vertexCount = info.vertexBuferSize / vertexSize;
+    _indices.resize(indexCount);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        if (info.indexSize == 2)
+        {
+            _indices[i] = reinterpret_cast<const uint16_t *>(indexBuffer.data())[firstIndex + i];
+        }
+        else
+        {
+            _indices[i] = reinterpret_cast<const uint32_t *>(indexBuffer.data())[firstIndex + i];
+        }
+
+        if (_indices[i] >= vertexCount)
+        {
+            std::cout << "Mesh " << filename << " indexes past its vertices" << std::endl;
+            _indices.clear();
+            return false;
         }
     }
 
+    _vertices.clear();
+    _packedVertices = std::move(vertexBuffer);
+    _vertexFormat = info.vertexFormat;
+    _dequantization = get_dequantization_matrix(info.vertexFormat, info.bounds);
     return true;
-}
\ No newline at end of file
+}
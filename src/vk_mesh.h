@@ -4,6 +4,9 @@
 #include <vector>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <mesh_asset.h>
 
 struct VertexInputDescription
 {
@@ -23,9 +26,32 @@ struct Vertex
     static VertexInputDescription get_vertex_description();
 };
 
+// vertex input for meshes baked in one of the asset vertex formats, at the same locations as Vertex.
+// Quantized formats give the shader positions in the 0 to 1 range of the bounds, and octahedral normals
+// in xy that get decoded with
+//     vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//     float t = max(-n.z, 0.0);
+//     n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+//     n = normalize(n);
+VertexInputDescription get_vertex_description(assets::VertexFormat format);
+
+// turns quantized positions back into mesh space, multiply the model matrix by it.
+// identity for the formats with full precision positions
+glm::mat4 get_dequantization_matrix(assets::VertexFormat format, const assets::MeshBounds &bounds);
+
 struct Mesh
 {
     std::vector<Vertex> _vertices;
+    // empty for meshes drawn straight from the vertices, like the hardcoded triangle
+    std::vector<uint32_t> _indices;
+    // vertices of a baked mesh, uploaded as they are stored in place of _vertices
+    std::vector<char> _packedVertices;
+    assets::VertexFormat _vertexFormat{assets::VertexFormat::PNCV_F32};
+    // multiply the model matrix of anything drawing this mesh by it, see get_dequantization_matrix
+    glm::mat4 _dequantization{1.f};
     AllocatedBuffer _vertexBuffer;
+    AllocatedBuffer _indexBuffer;
     bool load_from_obj(const char *filename);
+    // loads the full detail lod of a mesh asset, keeping the vertices in the format they were baked in
+    bool load_from_meshasset(const char *filename);
 };
\ No newline at end of file
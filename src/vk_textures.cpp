@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "texture_asset.h"
+#include "texture_transcode.h"
 #include "asset_loader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -103,8 +104,10 @@ bool vkutil::load_image_from_file(VulkanEngine &engine, const char *file, Alloca
                                 vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, 
                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable); });
 
+    // captures the allocator alone, capturing engine by copy would copy the whole engine
+    VmaAllocator allocator = engine._allocator;
     engine._mainDeletionQueue.push_function([=]()
-                                            { vmaDestroyImage(engine._allocator, newImage._image, newImage._allocation); });
+                                            { vmaDestroyImage(allocator, newImage._image, newImage._allocation); });
 
     vmaDestroyBuffer(engine._allocator, stagingBuffer._buffer, stagingBuffer._allocation);
 
@@ -115,56 +118,168 @@ bool vkutil::load_image_from_file(VulkanEngine &engine, const char *file, Alloca
     return true;
 }
 
-bool vkutil::load_image_from_asset(VulkanEngine &engine, const char *filename, AllocatedImage &outImage)
+static VkBufferImageCopy page_copy_region(const assets::PageInfo &page, uint32_t mipLevel, VkDeviceSize bufferOffset)
 {
-    assets::AssetFile file;
-    bool loaded = assets::load_binaryfile(filename, file);
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = bufferOffset;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = mipLevel;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageExtent = {page.width, page.height, 1};
+    return copyRegion;
+}
+
+static void record_page_copies(VkCommandBuffer cmd, VkImage image, uint32_t mipLevels, VkBuffer buffer, const std::vector<VkBufferImageCopy> &copies)
+{
+    VkImageSubresourceRange range;
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = mipLevels;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier imageBarrier_toTransfer = {};
+    imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+    imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toTransfer.image = image;
+    imageBarrier_toTransfer.subresourceRange = range;
+
+    imageBarrier_toTransfer.srcAccessMask = 0;
+    imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
 
-    if (!loaded)
+    vkCmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+    VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+}
+
+// creates the image and records the copies of every page into cmd, each page becomes the next mip level.
+// The pages are staged one after another in buffer, starting at offset
+static void record_texture_upload(VulkanEngine &engine, VkCommandBuffer cmd, const assets::TextureInfo &info, VkFormat format, VkBuffer buffer, VkDeviceSize offset, AllocatedImage &outImage)
+{
+    std::vector<VkBufferImageCopy> copies;
+    for (uint32_t i = 0; i < info.pages.size(); i++)
     {
-        std::cout << "Error when loading texture " << filename << std::endl;
-        return false;
+        copies.push_back(page_copy_region(info.pages[i], i, offset));
+        offset += info.pages[i].originalSize;
     }
 
-    assets::TextureInfo textureInfo = assets::read_texture_info(&file);
+    VkExtent3D imageExtent;
+    imageExtent.width = info.pages[0].width;
+    imageExtent.height = info.pages[0].height;
+    imageExtent.depth = 1;
+
+    VkImageCreateInfo dimg_info = vkinit::image_create_info(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+    dimg_info.mipLevels = static_cast<uint32_t>(info.pages.size());
+
+    VmaAllocationCreateInfo dimg_allocinfo = {};
+    dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    AllocatedImage newImage;
+    vmaCreateImage(engine._allocator, &dimg_info, &dimg_allocinfo, &newImage._image, &newImage._allocation, nullptr);
+
+    record_page_copies(cmd, newImage._image, dimg_info.mipLevels, buffer, copies);
 
-    VkDeviceSize imageSize = textureInfo.textureSize;
-    VkFormat image_format;
-    switch (textureInfo.textureFormat)
+    // captures the allocator alone, capturing engine by copy would copy the whole engine
+    VmaAllocator allocator = engine._allocator;
+    engine._mainDeletionQueue.push_function([=]()
+                                            { vmaDestroyImage(allocator, newImage._image, newImage._allocation); });
+
+    outImage = newImage;
+}
+
+VkFormat vkutil::texture_vk_format(const assets::TextureInfo &info)
+{
+    bool srgb = info.colorSpace == assets::ColorSpace::SRGB;
+    switch (info.textureFormat)
     {
     case assets::TextureFormat::RGBA8:
-        image_format = VK_FORMAT_R8G8B8A8_UNORM;
-        break;
+        return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    case assets::TextureFormat::BC1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case assets::TextureFormat::BC3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case assets::TextureFormat::BC4:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+    case assets::TextureFormat::BC5:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case assets::TextureFormat::BC7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
     default:
-        return false;
+        return VK_FORMAT_UNDEFINED;
     }
+}
 
-    AllocatedBufferUntyped stagingBuffer = engine.create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_UNKNOWN, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+bool vkutil::needs_transcode(const VulkanEngine &engine, const assets::TextureInfo &info)
+{
+    return assets::is_block_compressed(info.textureFormat) && !engine.can_sample_format(texture_vk_format(info));
+}
 
-    std::vector<MipmapInfo> mips;
+assets::TextureInfo vkutil::upload_texture_info(const VulkanEngine &engine, const assets::TextureInfo &info)
+{
+    return needs_transcode(engine, info) ? assets::transcoded_texture_info(info) : info;
+}
 
-    void *data;
-    vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
-    size_t offset = 0;
-    {
+bool vkutil::upload_texture(VulkanEngine &engine, VkCommandBuffer cmd, assets::TextureInfo &info, const char *blob, size_t blobSize, assets::TaskPool *pool, AllocatedImage &outImage)
+{
+    if (info.pages.empty() || texture_vk_format(info) == VK_FORMAT_UNDEFINED)
+        return false;
 
-        for (int i = 0; i < textureInfo.pages.size(); i++)
-        {
-            ZoneScopedNC("Unpack Texture", tracy::Color::Magenta);
-            MipmapInfo mip;
-            mip.dataOffset = offset;
-            mip.dataSize = textureInfo.pages[i].originalSize;
-            mips.push_back(mip);
-            assets::unpack_texture_page(&textureInfo, i, file.binaryBlob.data(), (char *)data + offset);
-
-            offset += mip.dataSize;
-        }
+    bool transcode = needs_transcode(engine, info);
+    assets::TextureInfo uploadInfo = transcode ? assets::transcoded_texture_info(info) : info;
+
+    // pages are staged one after another, so every page has to be exactly the size of its mip for the copies to line up.
+    // The sizes are multiples of the texel block size, which keeps every copy offset aligned
+    uint64_t stagedSize = 0;
+    for (const assets::PageInfo &page : uploadInfo.pages)
+    {
+        if (page.originalSize != assets::texture_page_size(uploadInfo.textureFormat, page.width, page.height))
+            return false;
+        stagedSize += page.originalSize;
     }
-    vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
+    if (stagedSize > uploadInfo.textureSize)
+        return false;
 
-    outImage = upload_image_mipmapped(textureInfo.pages[0].width, textureInfo.pages[0].height, image_format, engine, stagingBuffer, mips);
+    // the whole texture is staged in one piece, from the ring or from a buffer of its own when it is bigger than the ring
+    VkBuffer buffer = engine._stagingRing.buffer._buffer;
+    VkDeviceSize offset = 0;
+    char *staged = engine.stage_allocate(uploadInfo.textureSize, offset);
+    if (!staged)
+    {
+        staged = engine.stage_allocate_dedicated(uploadInfo.textureSize, buffer);
+        offset = 0;
+    }
 
-    vmaDestroyBuffer(engine._allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+    // the staged memory stays claimed until the batch finishes, there is nothing to give back on failure
+    bool unpacked;
+    if (!transcode)
+    {
+        unpacked = assets::unpack_texture(&info, blob, blobSize, staged, pool);
+    }
+    else
+    {
+        // only the block compressed pixels, a quarter of the rgba8 ones or less, go through memory of their own
+        std::vector<char> compressed(info.textureSize);
+        unpacked = assets::unpack_texture(&info, blob, blobSize, compressed.data(), pool) &&
+                   assets::transcode_texture_rgba8(info, compressed.data(), compressed.size(), staged, pool);
+    }
+    if (!unpacked)
+        return false;
 
+    record_texture_upload(engine, cmd, uploadInfo, texture_vk_format(uploadInfo), buffer, offset, outImage);
     return true;
-}
\ No newline at end of file
+}
@@ -2,9 +2,20 @@
 
 #include "vk_types.h"
 #include "vk_engine.h"
+#include "texture_asset.h"
 
 namespace vkutil
 {
     bool load_image_from_file(VulkanEngine &engine, const char *file, AllocatedImage &outImage);
-    bool load_image_from_asset(VulkanEngine &engine, const char *file, AllocatedImage &outImage);
+    // the format a baked texture gets uploaded as, VK_FORMAT_UNDEFINED for formats the engine does not know
+    VkFormat texture_vk_format(const assets::TextureInfo &info);
+    // the gpu cant sample the format of the texture, it has to be transcoded to RGBA8 before the upload
+    bool needs_transcode(const VulkanEngine &engine, const assets::TextureInfo &info);
+    // the texture as upload_texture stages it, transcoded to RGBA8 when the gpu cant sample its format.
+    // Its textureSize is the staging memory the upload takes
+    assets::TextureInfo upload_texture_info(const VulkanEngine &engine, const assets::TextureInfo &info);
+    // unpacks the blob of a baked texture straight into staging memory and records the copies into cmd, the batch
+    // from VulkanEngine::begin_upload_batch. Every page becomes a mip level. The pages and blocks are unpacked in parallel
+    // on the pool, the blob can be a MappedAssetFile, so the compressed data is only ever in the page cache
+    bool upload_texture(VulkanEngine &engine, VkCommandBuffer cmd, assets::TextureInfo &info, const char *blob, size_t blobSize, assets::TaskPool *pool, AllocatedImage &outImage);
 }
\ No newline at end of file